@@ -1,11 +1,22 @@
 #include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 #include <GL/gl.h>
 #include <GL/glu.h>
+#include "zzxoto/gl_trace.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "zzxoto/helper.h"
+#include "zzxoto/camera.h"
+#include "zzxoto/camera_path.h"
+#include "zzxoto/constexpr_matrix.h"
+#include "zzxoto/shader_cache.h"
+#include "zzxoto/headless.h"
+#include "zzxoto/frame_benchmark.h"
 #include "math.h"
 
 #define internal static
@@ -18,8 +29,9 @@ typedef unsigned int uint;
 
 global const int windowH = 640;
 global const int windowW = 640;
-global const float ZNEAR = .1f;
-global const float ZFAR = 100.0f;
+global ZZXOTO_CONSTEXPR_VALUE float ZNEAR = .1f;
+global ZZXOTO_CONSTEXPR_VALUE float ZFAR = 100.0f;
+global ZZXOTO_CONSTEXPR_VALUE ConstMat4 CAMERA_TO_CLIP = constPerspective(45.0f, ZNEAR, ZFAR);
 
 global const char *vertexShaderSource = R"FOO(
   #version 330 core
@@ -73,111 +85,23 @@ typedef struct ProgramData
   GLuint surfaceColor;
 } ProgramData;
 
-typedef struct Camera
-{
-  glm::vec3 cameraSphericalRelPos;
-  glm::vec3 cameraTargetPos;
-} Camera;
-
 ProgramData programData;
-Camera camera;
-
-internal glm::vec3 resolveCameraPosition_sphericalToEuclidean(const Camera &camera)
-{
-  float theta = glm::radians(camera.cameraSphericalRelPos.x);
-  float phi = glm::radians(camera.cameraSphericalRelPos.y);
-  float r = camera.cameraSphericalRelPos.z;
-  
-  float cosTheta = cosf(theta);
-  float sinTheta = sinf(theta);
-  float sinPhi   = sinf(phi);
-  float cosPhi   = cosf(phi);
-  
-  glm::vec3 cameraRelPos_euclidean = glm::vec3(r * sinPhi * cosTheta, r * cosPhi, r * sinPhi * sinTheta);
-  return cameraRelPos_euclidean + camera.cameraTargetPos;
-}
-
-internal glm::mat4 calcLookAtMatrix(const Camera &camera)
-{
-  const glm::vec3 upPt = glm::vec3(.0f, 1.0f, .0f);
-  const glm::vec3 &lookPt = camera.cameraTargetPos;
-  const glm::vec3 &cameraPt = resolveCameraPosition_sphericalToEuclidean(camera);
-  
-  glm::vec3 lookDir = glm::normalize(lookPt - cameraPt);
-  glm::vec3 upDir = glm::normalize(upPt);
-  
-  glm::vec3 rightDir = glm::normalize(glm::cross(lookDir, upDir));
-  glm::vec3 perpUpDir = glm::cross(rightDir, lookDir);
-  
-  glm::mat4 rotMat(1.0f);
-  rotMat[0] = glm::vec4(rightDir, 0.0f);
-  rotMat[1] = glm::vec4(perpUpDir, 0.0f);
-  rotMat[2] = glm::vec4(-lookDir, 0.0f);
-  
-  rotMat = glm::transpose(rotMat);
-  
-  glm::mat4 transMat(1.0f);
-  transMat[3] = glm::vec4(-cameraPt, 1.0f);
-  
-  return rotMat * transMat;
-}
+CachedCamera camera;
 
-internal GLuint createShaderProgram(const char *vertexShaderSource, const char *fragmentShaderSource)
-{
-  uint vertexShader, fragmentShader, program;
-  
-  vertexShader = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-  glCompileShader(vertexShader);
-  
-  {
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-      glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-      cout << infoLog << endl;
-    }
-  }
-  
-  fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-  glCompileShader(fragmentShader);
-  
-  {
-    int success;
-    char infoLog[512];
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-      glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-      cout << infoLog << endl;
-    }
-  }
-  
-  program = glCreateProgram();
-  glAttachShader(program, vertexShader);
-  glAttachShader(program, fragmentShader);
-  glLinkProgram(program);
-  {
-    int success;
-    char infoLog[512];
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-      glGetProgramInfoLog(program, 512, NULL, infoLog);
-      cout << infoLog << endl;
-    }
-  }
-  
-  return program;
-}
+//--camera-path playback: one precomputed view matrix per frame
+global std::vector<glm::mat4> g_pathMatrices;
+global int g_pathFrame;
+global FrameBenchmark g_frameBenchmark;
 
 internal ProgramData loadProgram(const char *vertexShaderSource, const char *fragmentShaderSource)
 {
+  ShaderCache shaderCache;
+  int program = shaderCache.Add(vertexShaderSource, fragmentShaderSource);
+  shaderCache.Finish();
+  shaderCache.PrintStats("shader programs");
+  
   ProgramData p;
-  p.program = createShaderProgram(vertexShaderSource, fragmentShaderSource);
+  p.program = shaderCache.Program(program);
   p.modelToWorldMatrixUnif = glGetUniformLocation(p.program, "modelToWorldMatrix");
   p.worldToCameraMatrixUnif = glGetUniformLocation(p.program, "worldToCameraMatrix");
   p.cameraToClipMatrixUnif = glGetUniformLocation(p.program, "cameraToClipMatrix");
@@ -215,26 +139,69 @@ internal void initFloor(void)
 
 internal void init(void)
 {
-  camera.cameraSphericalRelPos = glm::vec3(90.0f, 45.0f, 50.0f);
-  camera.cameraTargetPos = glm::vec3(.0f, .0f, .0f);
+  Camera state;
+  state.cameraSphericalRelPos = glm::vec3(90.0f, 45.0f, 50.0f);
+  state.cameraTargetPos = glm::vec3(.0f, .0f, .0f);
+  camera.Set(state);
   programData = loadProgram(vertexShaderSource, fragmentShaderSource);
   initFloor();
 }
 
+//a fly-through around the floor, frameCount view matrices up front
+internal void initCameraPath(int frameCount)
+{
+  const float keys[][6] =
+  {
+    //theta, phi, radius, target
+    {90.0f, 45.0f, 50.0f, .0f, .0f, .0f},
+    {150.0f, 60.0f, 30.0f, 10.0f, .0f, -10.0f},
+    {240.0f, 75.0f, 15.0f, .0f, 2.0f, -20.0f},
+    {330.0f, 30.0f, 40.0f, -15.0f, .0f, .0f},
+    {420.0f, 10.0f, 70.0f, .0f, .0f, 10.0f},
+    {450.0f, 45.0f, 50.0f, .0f, .0f, .0f},
+  };
+  
+  CameraPath path;
+  for (int k = 0; k < (int) (sizeof(keys) / sizeof(keys[0])); k++)
+  {
+    Camera key;
+    key.cameraSphericalRelPos = glm::vec3(keys[k][0], keys[k][1], keys[k][2]);
+    key.cameraTargetPos = glm::vec3(keys[k][3], keys[k][4], keys[k][5]);
+    path.AddKey(key);
+  }
+  
+  g_pathMatrices.resize(frameCount);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  path.EvaluateViewMatrices(frameCount, &g_pathMatrices[0]);
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  cout << "camera path: " << frameCount << " view matrices in " << ms << " ms" << endl;
+  g_pathFrame = 0;
+}
+
 internal void display(void)
 {
+  g_frameBenchmark.BeginFrame();
   glClearColor(.1f, .2f, .2f, 1.0f);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   
-  //set camera transformation
-  glm::mat4 cameraMatrix = calcLookAtMatrix(camera);
+  //set camera transformation, the next frame of the path when playing one back
+  glm::mat4 cameraMatrix;
+  if (g_pathMatrices.empty())
+  {
+    cameraMatrix = camera.ViewMatrix();
+  }
+  else
+  {
+    cameraMatrix = g_pathMatrices[glm::min(g_pathFrame++, (int) g_pathMatrices.size() - 1)];
+  }
+  g_frameBenchmark.EndPhase(phase_update);
   glUseProgram(programData.program);
   glUniformMatrix4fv(programData.worldToCameraMatrixUnif, 1, GL_FALSE, glm::value_ptr(cameraMatrix));
   glUseProgram(0);
   
   //draw floor
   {
-    MatrixStack modelMatrix;
+    FixedMatrixStack<4> modelMatrix;
     modelMatrix.Scale(glm::vec3(50.0f, 0.0f, 50.0f));
     
     glUseProgram(programData.program);
@@ -248,12 +215,20 @@ internal void display(void)
     glBindVertexArray(0);  
   }
   
+  g_frameBenchmark.EndPhase(phase_display);
   glutSwapBuffers();
+  g_frameBenchmark.EndPhase(phase_swap);
+  GL_TRACE_END_FRAME();
+  if (g_frameBenchmark.EndFrame())
+  {
+    glutLeaveMainLoop();
+  }
   glutPostRedisplay();
 }
 
 internal void keyboard(unsigned char key, int x, int y)
 {
+  Camera state = camera.State();
   switch(key)
   {
     case 27: 
@@ -263,66 +238,64 @@ internal void keyboard(unsigned char key, int x, int y)
     }
     case 'w': 
     {
-      camera.cameraTargetPos.z -= 4.0f; 
+      state.cameraTargetPos.z -= 4.0f; 
       break;
     }
     case 's': 
     {
-      camera.cameraTargetPos.z += 4.0f; 
+      state.cameraTargetPos.z += 4.0f; 
       break;
     }
     case 'd': 
     {
-      camera.cameraTargetPos.x += 4.0f; 
+      state.cameraTargetPos.x += 4.0f; 
       break;
     }
     case 'a': 
     {
-      camera.cameraTargetPos.x -= 4.0f; 
+      state.cameraTargetPos.x -= 4.0f; 
       break;
     }
     case 'e': 
     {
-      camera.cameraTargetPos.y -= 4.0f; 
+      state.cameraTargetPos.y -= 4.0f; 
       break;
     }
     case 'q': 
     {
-      camera.cameraTargetPos.y += 4.0f; 
+      state.cameraTargetPos.y += 4.0f; 
       break;
     }
     case 'j':
     {
-      camera.cameraSphericalRelPos.x -= 3.0f;
+      state.cameraSphericalRelPos.x -= 3.0f;
       break;
     }
     case 'l':
     {
-      camera.cameraSphericalRelPos.x += 3.0f;
+      state.cameraSphericalRelPos.x += 3.0f;
       break;
     }
     case 'i':
     {
-      camera.cameraSphericalRelPos.y -= 1.0f;
+      state.cameraSphericalRelPos.y -= 1.0f;
       break;
     }
     case 'k':
     {
-      camera.cameraSphericalRelPos.y += 1.0f;
+      state.cameraSphericalRelPos.y += 1.0f;
       break;
     }
   }
   
-  camera.cameraSphericalRelPos.y = glm::clamp(camera.cameraSphericalRelPos.y, 1.0f, 80.0f);
+  state.cameraSphericalRelPos.y = glm::clamp(state.cameraSphericalRelPos.y, 1.0f, 80.0f);
+  camera.Set(state);
 }
 
 internal void reshape(int w, int h)
 {
-  MatrixStack mat;
-  mat.Perspective(45.0f, ZNEAR, ZFAR);
-  
   glUseProgram(programData.program);
-  glUniformMatrix4fv(programData.cameraToClipMatrixUnif, 1, GL_FALSE, glm::value_ptr(mat.Top()));
+  glUniformMatrix4fv(programData.cameraToClipMatrixUnif, 1, GL_FALSE, CAMERA_TO_CLIP.m);
   glUseProgram(0);
   
   glViewport(0, 0, (GLsizei) w, (GLsizei) h);
@@ -334,6 +307,22 @@ int main(int argc, char **argv)
   //glut init
   glutInit(&argc, argv);
   
+  //--camera-path N plays a fly-through in N frames, one frame per display,
+  //then prints frame times and leaves; headless, pass --frames N or more
+  int pathFrames = 0;
+  const char *benchmarkJsonPath = "build/camera_control_benchmark.json";
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--camera-path") == 0 && i + 1 < argc)
+    {
+      pathFrames = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--benchmark-json") == 0 && i + 1 < argc)
+    {
+      benchmarkJsonPath = argv[++i];
+    }
+  }
+  
   //init context
   glutInitContextVersion(3, 3);
   glutInitContextProfile(GLUT_CORE_PROFILE);
@@ -354,8 +343,14 @@ int main(int argc, char **argv)
   {
     cout << "OpenGL 3.3 not supported" << endl;
   }
+  GL_TRACE_INSTALL(60);
   
   init();
+  if (pathFrames > 0)
+  {
+    initCameraPath(pathFrames);
+    g_frameBenchmark.Start("camera_control", pathFrames, benchmarkJsonPath);
+  }
   glEnable(GL_CULL_FACE);
   glCullFace(GL_BACK);
   glFrontFace(GL_CCW);
@@ -364,6 +359,8 @@ int main(int argc, char **argv)
   glutKeyboardFunc(keyboard);
   glutReshapeFunc(reshape);
   glutMainLoop();
+  cout << "view matrix: " << camera.ViewRecomputes() << " recomputes for " << camera.ViewRequests() << " requests"
+       << endl;
   
   return 0;
 }
\ No newline at end of file
@@ -5,20 +5,31 @@
 #include <GL/freeglut.h>
 #include <GL/gl.h>
 #include <GL/glu.h>
+#include <zzxoto/gl_trace.h>
 #include <stb/stb_image.h>
 #include <stdio.h>
 #include <zzxoto/helper.h>
+#include <zzxoto/constexpr_matrix.h>
 #include <zzxoto/gl_helper.h>
+#include <zzxoto/bvh.h>
+#include <zzxoto/program_reflection.h>
+#include <zzxoto/headless.h>
+#include <zzxoto/frame_benchmark.h>
+#include <zzxoto/game_loop.h>
+#include <zzxoto/profiler.h>
 
 typedef unsigned char uchar;
 
+//uniform indices into `reflection`; its setters skip unchanged values, so
+//the per piece sampler and color only reach GL when they differ
 typedef struct ProgramData
 {
   GLuint program;
-  GLuint worldToClipMatrix;
-  GLuint sampler;
-  GLuint transparentPixel;
-  GLuint color;
+  ProgramReflection reflection;
+  int worldToClipMatrix;
+  int sampler;
+  int transparentPixel;
+  int color;
 } ProgramData;
 ProgramData g_chessPieceProgramData, g_chessBoardProgramData;
 
@@ -147,16 +158,16 @@ static GLuint getChessPieceTextureId(const ChessPiece &chessPiece)
 
 static void init();
 static void keyboard(uchar key, int x, int y);
-static void runGameLoop(int val);
+static void mouse(int button, int state, int x, int y);
+static void runGameLoop();
 static void exitGameLoop();
 static void update();
 static void display();
 static void reshape(int w, int h);
 
 static int g_windowH = 600, g_windowW = 600;
-static const int FPS = 60;
-static const int DELAYMS = 1000 / FPS;
-static bool g_gameLoopContinues = true;
+static FixedStepLoop g_gameLoop(1.0 / 60);
+static FrameBenchmark g_frameBenchmark;
 static const GLuint g_textureUnit = 3;
 static GLuint g_VBO, g_VAO, g_EBO;
 static glm::mat4 g_worldToClipMatrix(1);
@@ -164,6 +175,15 @@ static glm::mat4 g_worldToClipMatrix(1);
 static glm::vec3 g_transparentPixel(0.f, 187.0f/255.0f, 0.f); 
 static glm::vec3 g_colorChessBlack(.1f, .1f, .1f);  
 static glm::vec3 g_colorChessWhite(.7f,.7f, .7f);
+static glm::vec3 g_colorChessSelected(.9f, .6f, .1f);
+
+//mouse picking: a ray straight down into the board, in board space where a
+//tile is 1x1. Pieces (object i < CHESSPIECE_COUNT) sit on top of the 64
+//squares (object CHESSPIECE_COUNT + y * 8 + x), so a ray hits a piece first.
+static const int PICK_OBJECT_COUNT = CHESSPIECE_COUNT + 64;
+static Bvh g_pickBvh;
+static int g_selectedPiece = -1;
+static int g_viewportX = 0, g_viewportY = 0;  //top left of the board, in window coords
 
 const char *vertexShader = R"FOO(
 #version 330 core
@@ -241,6 +261,7 @@ void main()
 
 static void update()
 {
+  PROFILE_FUNCTION();
   //1. board
   {
     GLfloat left = 0; 
@@ -306,6 +327,10 @@ static void update()
         chessPieceRenderData.color = isBlack(chessPiece)
           ? g_colorChessBlack
           : g_colorChessWhite;
+        if (i == g_selectedPiece)
+        {
+          chessPieceRenderData.color = g_colorChessSelected;
+        }
         chessPieceRenderData.shouldRender = true;
         chessPieceRenderData.programData = &g_chessPieceProgramData;
       }
@@ -324,28 +349,30 @@ static void reshape(int w, int h)
   g_windowH = s;
   g_windowW = s;
   
-  MatrixStack mat;
-  mat.Translate(-1.0f, 1.0f, 0.0f);
-  mat.Scale(glm::vec3(2.0f / g_windowW, -2.0f / g_windowH, 1.0f));  
-  
-  g_worldToClipMatrix = mat.Top();
+  //pixels to clip space: top left origin, y down
+  g_worldToClipMatrix = toMat4(constOrthographic(0, (float) g_windowW, (float) g_windowH, 0, 1, -1));
   
   glUseProgram(g_chessPieceProgramData.program);
-  glUniformMatrix4fv(g_chessPieceProgramData.worldToClipMatrix, 1, GL_FALSE, glm::value_ptr(g_worldToClipMatrix));
+  g_chessPieceProgramData.reflection.Set(g_chessPieceProgramData.worldToClipMatrix, g_worldToClipMatrix);
   glUseProgram(0);
   
   glUseProgram(g_chessBoardProgramData.program);
-  glUniformMatrix4fv(g_chessBoardProgramData.worldToClipMatrix, 1, GL_FALSE, glm::value_ptr(g_worldToClipMatrix));
+  g_chessBoardProgramData.reflection.Set(g_chessBoardProgramData.worldToClipMatrix, g_worldToClipMatrix);
   glUseProgram(0);
   
   int x0 = (w - s) / 2;
   int y0 = (h - s) / 2;
   
   glViewport(x0, y0, (GLsizei) g_windowW, (GLsizei) g_windowH);
+  
+  //glViewport counts from the bottom, mouse coordinates from the top
+  g_viewportX = x0;
+  g_viewportY = h - y0 - s;
 }
 
 void display()
 {
+  PROFILE_FUNCTION();
   glClearColor(.1f, .2f, .2f, 1.0f);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   
@@ -364,17 +391,14 @@ void display()
       
       //bind texture
       glActiveTexture(GL_TEXTURE0 + g_textureUnit);
-      glUniform1i(renderData.programData->sampler, g_textureUnit); 
+      renderData.programData->reflection.Set(renderData.programData->sampler, (GLint) g_textureUnit);
       glBindTexture(GL_TEXTURE_2D, renderData.textureId);
       
       //copy vertices
       glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLfloat) * 16, renderData.vertices);
       
       //copy color
-      glUniform3f(renderData.programData->color, 
-                  renderData.color.x, 
-                  renderData.color.y,
-                  renderData.color.z);
+      renderData.programData->reflection.Set(renderData.programData->color, renderData.color);
       
       //render
       glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);    
@@ -385,28 +409,150 @@ void display()
   glBindBuffer(GL_ARRAY_BUFFER, 0);
   glUseProgram(0);
   
+  g_frameBenchmark.EndPhase(phase_display);
   glutSwapBuffers();
+  g_frameBenchmark.EndPhase(phase_swap);
+  GL_TRACE_END_FRAME();
+  if (g_frameBenchmark.EndFrame())
+  {
+    exitGameLoop();
+  }
 }
 
-void runGameLoop(int val)
+//idle func: update at a fixed 60 Hz, render as often as the swap allows.
+//Nothing on the board moves on its own, so there is nothing to interpolate
+void runGameLoop()
 {
-  update();
-  display();
-  
-  if (g_gameLoopContinues)
+  g_frameBenchmark.BeginFrame();
+  int steps = g_gameLoop.Advance();
+  for (int i = 0; i < steps; i++)
   {
-    glutTimerFunc(DELAYMS, runGameLoop, val);
+    update();
   }
+  g_frameBenchmark.EndPhase(phase_update);
+  glutPostRedisplay();
 }
 
 static void exitGameLoop()
 {
+  glutIdleFunc(NULL);
   glutLeaveMainLoop();
-  g_gameLoopContinues = false;
+}
+
+static Aabb getChessPieceBounds(const ChessPiece &chessPiece)
+{
+  Aabb result = makeEmptyAabb();
+  if (chessPiece.active)
+  {
+    result = makeAabb(glm::vec3(chessPiece.x + .05f, chessPiece.y + .05f, 1.0f),
+                      glm::vec3(chessPiece.x + .95f, chessPiece.y + .95f, 2.0f));
+  }
+  
+  return result;
+}
+
+static void initPicking()
+{
+  Aabb bounds[PICK_OBJECT_COUNT];
+  for (int i = 0; i < CHESSPIECE_COUNT; i++)
+  {
+    bounds[i] = getChessPieceBounds(g_chessState.chessPieces[i]);
+  }
+  for (int square = 0; square < 64; square++)
+  {
+    float x = (float) (square % 8);
+    float y = (float) (square / 8);
+    bounds[CHESSPIECE_COUNT + square] = makeAabb(glm::vec3(x, y, 0.0f), glm::vec3(x + 1.0f, y + 1.0f, 1.0f));
+  }
+  
+  g_pickBvh.Build(bounds, PICK_OBJECT_COUNT);
+}
+
+static int findChessPiece(int x, int y)
+{
+  int result = -1;
+  for (int i = 0; i < CHESSPIECE_COUNT; i++)
+  {
+    const ChessPiece &chessPiece = g_chessState.chessPieces[i];
+    if (chessPiece.active && chessPiece.x == x && chessPiece.y == y)
+    {
+      result = i;
+    }
+  }
+  
+  return result;
+}
+
+//moves a piece, capturing whatever stands on the target square, and refits
+//the picking hierarchy for the pieces involved
+static void moveChessPiece(int piece, int x, int y)
+{
+  int captured = findChessPiece(x, y);
+  if (captured >= 0)
+  {
+    g_chessState.chessPieces[captured].active = false;
+    g_pickBvh.Update(captured, getChessPieceBounds(g_chessState.chessPieces[captured]));
+  }
+  
+  g_chessState.chessPieces[piece].x = x;
+  g_chessState.chessPieces[piece].y = y;
+  g_pickBvh.Update(piece, getChessPieceBounds(g_chessState.chessPieces[piece]));
+}
+
+//left click a piece to select it, then a square or an opposing piece to move
+//it there
+static void mouse(int button, int state, int x, int y)
+{
+  if (button != GLUT_LEFT_BUTTON || state != GLUT_DOWN)
+  {
+    return;
+  }
+  
+  float tileSize = g_windowW / 8.f;
+  glm::vec3 origin((x - g_viewportX) / tileSize, (y - g_viewportY) / tileSize, 10.0f);
+  RayHit hit = g_pickBvh.Raycast(origin, glm::vec3(0.0f, 0.0f, -1.0f));
+  if (hit.object < 0)
+  {
+    g_selectedPiece = -1;
+    return;
+  }
+  
+  int pickedPiece = hit.object < CHESSPIECE_COUNT ? hit.object : -1;
+  int squareX, squareY;
+  if (pickedPiece >= 0)
+  {
+    squareX = g_chessState.chessPieces[pickedPiece].x;
+    squareY = g_chessState.chessPieces[pickedPiece].y;
+  }
+  else
+  {
+    squareX = (hit.object - CHESSPIECE_COUNT) % 8;
+    squareY = (hit.object - CHESSPIECE_COUNT) / 8;
+  }
+  
+  if (g_selectedPiece < 0)
+  {
+    g_selectedPiece = pickedPiece;
+  }
+  else if (pickedPiece == g_selectedPiece)
+  {
+    g_selectedPiece = -1;
+  }
+  else if (pickedPiece >= 0
+           && isBlack(g_chessState.chessPieces[pickedPiece]) == isBlack(g_chessState.chessPieces[g_selectedPiece]))
+  {
+    g_selectedPiece = pickedPiece;
+  }
+  else
+  {
+    moveChessPiece(g_selectedPiece, squareX, squareY);
+    g_selectedPiece = -1;
+  }
 }
 
 static bool loadTexture(const char *filepath, Texture *tx)
 {
+  PROFILE_FUNCTION();
   bool result = false;
   
   uchar *pixelData = stbi_load(filepath, &tx->w, &tx->h, 0, 3);
@@ -446,21 +592,20 @@ static bool loadTexture(const char *filepath, Texture *tx)
 static void initProgram(const char *vShader, const char *fShader, ProgramData *p)
 {
   p->program = createShaderProgram(vShader, fShader);
-  p->worldToClipMatrix = glGetUniformLocation(p->program, "worldToClipMatrix");
-  p->sampler = glGetUniformLocation(p->program, "myTexture");
-  p->transparentPixel = glGetUniformLocation(p->program, "transparentPixel");
-  p->color = glGetUniformLocation(p->program, "pieceColor");
+  p->reflection.Reflect(p->program);
+  p->worldToClipMatrix = p->reflection.FindUniform("worldToClipMatrix");
+  p->sampler = p->reflection.FindUniform("myTexture");
+  p->transparentPixel = p->reflection.FindUniform("transparentPixel");
+  p->color = p->reflection.FindUniform("pieceColor");
   
   glUseProgram(p->program);
-  glUniform3f(p->transparentPixel, 
-                g_transparentPixel.x, 
-                g_transparentPixel.y,
-                g_transparentPixel.z);
+  p->reflection.Set(p->transparentPixel, g_transparentPixel);
   glUseProgram(0);
 }
 
 static void init()
 {
+  PROFILE_FUNCTION();
   //1. init program
   initProgram(vertexShader, chessBoardFragmentShader, &g_chessBoardProgramData);
   initProgram(vertexShader, chessPieceFragmentShader, &g_chessPieceProgramData);
@@ -524,6 +669,8 @@ static void init()
     g_chessState.chessPieces[i++].unit = cu_w_rook;
   }
   
+  initPicking();
+  
   //4. vbo, ebo, vao
   {
     glGenBuffers(1, &g_VBO);
@@ -545,23 +692,23 @@ static void init()
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_EBO);
     
     {
-      ProgramData p = g_chessBoardProgramData;
-      GLuint positionAttribLocation = glGetAttribLocation(p.program, "aPos");
+      const ProgramData &p = g_chessBoardProgramData;
+      GLuint positionAttribLocation = p.reflection.AttributeLocation("aPos");
       glVertexAttribPointer(positionAttribLocation, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat)* 4, (void *) 0);
       glEnableVertexAttribArray(positionAttribLocation);
     
-      GLuint textureCoordAttribLocation = glGetAttribLocation(p.program, "textureCoord");
+      GLuint textureCoordAttribLocation = p.reflection.AttributeLocation("textureCoord");
       glVertexAttribPointer(textureCoordAttribLocation, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 4, (void *) (sizeof(GLfloat) * 2));
       glEnableVertexAttribArray(textureCoordAttribLocation);
     }
     
     {
-      ProgramData p = g_chessPieceProgramData;
-      GLuint positionAttribLocation = glGetAttribLocation(p.program, "aPos");
+      const ProgramData &p = g_chessPieceProgramData;
+      GLuint positionAttribLocation = p.reflection.AttributeLocation("aPos");
       glVertexAttribPointer(positionAttribLocation, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat)* 4, (void *) 0);
       glEnableVertexAttribArray(positionAttribLocation);
-      
-      GLuint textureCoordAttribLocation = glGetAttribLocation(p.program, "textureCoord");
+    
+      GLuint textureCoordAttribLocation = p.reflection.AttributeLocation("textureCoord");
       glVertexAttribPointer(textureCoordAttribLocation, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 4, (void *) (sizeof(GLfloat) * 2));
       glEnableVertexAttribArray(textureCoordAttribLocation);
     }
@@ -581,6 +728,12 @@ static void keyboard(uchar key, int x, int y)
       exitGameLoop();
       break;
     }
+    case 'r':
+    {
+      printf("%.1f updates/s, %.1f frames/s, %.3f s dropped\n", g_gameLoop.UpdateRate(), g_gameLoop.RenderRate(),
+             g_gameLoop.DroppedSeconds());
+      break;
+    }
   }
 }
 
@@ -589,6 +742,20 @@ int main(int argc, char **argv)
   //init glut
   glutInit(&argc, argv);
   
+  int benchmarkFrames = 0;
+  const char *benchmarkJsonPath = "build/chess_benchmark.json";
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc)
+    {
+      benchmarkFrames = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--benchmark-json") == 0 && i + 1 < argc)
+    {
+      benchmarkJsonPath = argv[++i];
+    }
+  }
+  
   //init context
   glutInitContextVersion(3, 3);
   glutInitContextProfile(GLUT_CORE_PROFILE);
@@ -612,6 +779,7 @@ int main(int argc, char **argv)
     printf("OpenGL 3.1 not supported\n");
     return 1;
   }
+  GL_TRACE_INSTALL(60);
   
   glDisable(GL_CULL_FACE);
   glEnable(GL_BLEND);
@@ -621,11 +789,18 @@ int main(int argc, char **argv)
   
   glutReshapeFunc(reshape);
   glutKeyboardFunc(keyboard);
+  glutMouseFunc(mouse);
   glutDisplayFunc(display);
   
-  runGameLoop(0);
+  if (benchmarkFrames > 0)
+  {
+    g_frameBenchmark.Start("chess", benchmarkFrames, benchmarkJsonPath);
+  }
+  update();
+  glutIdleFunc(runGameLoop);
   
   glutMainLoop();
+  PROFILE_WRITE_TRACE("build/chess_trace.json");
   
   return 0;
 } 
\ No newline at end of file
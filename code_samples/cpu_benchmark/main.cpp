@@ -0,0 +1,1314 @@
+//CPU side benchmarks of the shared headers. Nothing here touches GL, so it
+//runs without a GPU or a window:
+//
+//  build.bat cpu_benchmark && build\main [benchmark...]
+//  g++ -O2 -std=c++11 -pthread -Ishared/include cpu_benchmark/main.cpp -o cpu_benchmark
+//
+//Without arguments every benchmark runs (culling, bvh, lights, profiler,
+//matrix, stack, affine, transform, quaternion, trig, camera_path, math).
+//Timings are the median over a number of runs so a single hiccup doesn't
+//skew them. The exit status is 1 if a check failed (stack: FixedMatrixStack
+//allocating).
+//
+//math times single operations of helper.h, glm and the SIMD kernels with
+//micro_benchmark.h (warmup, median, MAD, cycles/op); with --json <path> its
+//results are also written there as JSON.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include "zzxoto/helper.h"
+#include "zzxoto/frustum_culling.h"
+#include "zzxoto/bvh.h"
+#include "zzxoto/light_clusters.h"
+#include "zzxoto/affine.h"
+#include "zzxoto/transform_kernels.h"
+#include "zzxoto/quaternion_batch.h"
+#include "zzxoto/fast_trig.h"
+#include "zzxoto/camera.h"
+#include "zzxoto/camera_path.h"
+#include "zzxoto/micro_benchmark.h"
+
+//the profiler benchmark measures the recording cost, so it is always on here
+#define ZZXOTO_PROFILE
+#include "zzxoto/profiler.h"
+
+#define internal static
+#define global static
+
+//VS2013 (build.bat) has no noexcept
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define NOEXCEPT throw()
+#else
+#define NOEXCEPT noexcept
+#endif
+
+//every heap allocation of the program goes through here, so a benchmark can
+//count the allocations a piece of code makes
+global std::atomic<long> g_allocationCount(0);
+
+//set by the benchmarks that also check something; main exits with 1
+global bool g_checkFailed = false;
+
+void *operator new(size_t size)
+{
+  g_allocationCount++;
+  void *memory = malloc(size > 0 ? size : 1);
+  if (memory == NULL)
+  {
+    throw std::bad_alloc();
+  }
+  
+  return memory;
+}
+
+//not inlined, or GCC flags the free() as not matching the operator new
+#ifdef __GNUC__
+__attribute__((noinline))
+#endif
+void operator delete(void *memory) NOEXCEPT
+{
+  free(memory);
+}
+
+//the sized form C++14 calls when it knows the size, so it can't bypass the
+//one above
+#ifdef __GNUC__
+__attribute__((noinline))
+#endif
+void operator delete(void *memory, size_t) NOEXCEPT
+{
+  free(memory);
+}
+
+typedef void (*BenchmarkFunc)(void);
+
+typedef struct Benchmark
+{
+  const char *name;
+  BenchmarkFunc run;
+} Benchmark;
+
+typedef std::chrono::steady_clock Clock;
+
+internal double elapsedMs(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+internal double median(std::vector<double> samples)
+{
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+//xorshift, so every run sees the same data
+internal float randomFloat(unsigned *state, float lo, float hi)
+{
+  unsigned x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  
+  return lo + (hi - lo) * (x >> 8) * (1.0f / 16777216.0f);
+}
+
+//the view of the samples: 45 degree reversed depth perspective, orbiting camera
+internal glm::mat4 benchmarkWorldToClipMatrix(void)
+{
+  MatrixStack cameraToClip;
+  cameraToClip.Perspective(45.0f, .1f, 100.0f);
+  
+  glm::mat4 worldToCamera = glm::lookAt(glm::vec3(.0f, 20.0f, 60.0f), glm::vec3(.0f), glm::vec3(.0f, 1.0f, .0f));
+  
+  return cameraToClip.Top() * worldToCamera;
+}
+
+internal void benchmarkCulling(void)
+{
+  const int boundsCount = 1 << 20;
+  const int runs = 21;
+  
+  std::vector<float> x(boundsCount), y(boundsCount), z(boundsCount), radius(boundsCount);
+  std::vector<float> extentX(boundsCount), extentY(boundsCount), extentZ(boundsCount);
+  unsigned seed = 1;
+  for (int i = 0; i < boundsCount; i++)
+  {
+    x[i] = randomFloat(&seed, -150.0f, 150.0f);
+    y[i] = randomFloat(&seed, -20.0f, 40.0f);
+    z[i] = randomFloat(&seed, -150.0f, 150.0f);
+    extentX[i] = randomFloat(&seed, .25f, 2.0f);
+    extentY[i] = randomFloat(&seed, .25f, 2.0f);
+    extentZ[i] = randomFloat(&seed, .25f, 2.0f);
+    radius[i] = sqrtf(extentX[i] * extentX[i] + extentY[i] * extentY[i] + extentZ[i] * extentZ[i]);
+  }
+  
+  FrustumPlanes planes = extractFrustumPlanes(benchmarkWorldToClipMatrix());
+  std::vector<unsigned> visible(boundsCount);
+  
+  enum {sphereScalar, sphereSimd, aabbScalar, aabbSimd, methodCount};
+  const char *names[methodCount] = {"spheres, scalar", "spheres, simd", "aabbs, scalar", "aabbs, simd"};
+  
+  for (int method = 0; method < methodCount; method++)
+  {
+    std::vector<double> ms;
+    int visibleCount = 0;
+    for (int run = 0; run < runs; run++)
+    {
+      Clock::time_point start = Clock::now();
+      switch (method)
+      {
+        case sphereScalar:
+        {
+          visibleCount = cullSpheresScalar(planes, &x[0], &y[0], &z[0], &radius[0], 0, boundsCount, &visible[0]);
+          break;
+        }
+        case sphereSimd:
+        {
+          visibleCount = cullSpheres(planes, &x[0], &y[0], &z[0], &radius[0], boundsCount, &visible[0]);
+          break;
+        }
+        case aabbScalar:
+        {
+          visibleCount = cullAABBsScalar(planes, &x[0], &y[0], &z[0], &extentX[0], &extentY[0], &extentZ[0],
+                                         0, boundsCount, &visible[0]);
+          break;
+        }
+        case aabbSimd:
+        {
+          visibleCount = cullAABBs(planes, &x[0], &y[0], &z[0], &extentX[0], &extentY[0], &extentZ[0],
+                                   boundsCount, &visible[0]);
+          break;
+        }
+      }
+      ms.push_back(elapsedMs(start));
+    }
+    
+    double frameMs = median(ms);
+    printf("culling %-16s %d bounds: %7.3f ms/frame, %6.1f Mbounds/s, %d visible\n",
+           names[method], boundsCount, frameMs, boundsCount / frameMs / 1000.0, visibleCount);
+  }
+
+#if defined(__AVX__)
+  printf("culling: simd path is AVX, 8 bounds per iteration\n");
+#else
+  printf("culling: simd path is SSE, 4 bounds per iteration\n");
+#endif
+}
+
+//a static level: 1M boxes, flat SIMD culling against the hierarchy, plus
+//picking rays and refitting after objects move
+internal void benchmarkBvh(void)
+{
+  const int objectCount = 1 << 20;
+  const int rayCount = 100000;
+  const int movedCount = 10000;
+  const int runs = 11;
+  
+  std::vector<Aabb> bounds(objectCount);
+  std::vector<float> centerX(objectCount), centerY(objectCount), centerZ(objectCount);
+  std::vector<float> extentX(objectCount), extentY(objectCount), extentZ(objectCount);
+  unsigned seed = 7;
+  for (int i = 0; i < objectCount; i++)
+  {
+    glm::vec3 center(randomFloat(&seed, -300.0f, 300.0f), randomFloat(&seed, -20.0f, 40.0f), randomFloat(&seed, -300.0f, 300.0f));
+    glm::vec3 extent(randomFloat(&seed, .25f, 2.0f), randomFloat(&seed, .25f, 2.0f), randomFloat(&seed, .25f, 2.0f));
+    bounds[i] = makeAabb(center - extent, center + extent);
+    centerX[i] = center.x;
+    centerY[i] = center.y;
+    centerZ[i] = center.z;
+    extentX[i] = extent.x;
+    extentY[i] = extent.y;
+    extentZ[i] = extent.z;
+  }
+  
+  Bvh bvh;
+  Clock::time_point start = Clock::now();
+  bvh.Build(&bounds[0], objectCount);
+  printf("bvh build, %d objects: %.1f ms, %d nodes\n", objectCount, elapsedMs(start), bvh.NodeCount());
+  
+  FrustumPlanes planes = extractFrustumPlanes(benchmarkWorldToClipMatrix());
+  std::vector<unsigned> visible(objectCount);
+  
+  for (int method = 0; method < 2; method++)
+  {
+    std::vector<double> ms;
+    int visibleCount = 0;
+    for (int run = 0; run < runs; run++)
+    {
+      start = Clock::now();
+      visibleCount = method == 0
+        ? cullAABBs(planes, &centerX[0], &centerY[0], &centerZ[0], &extentX[0], &extentY[0], &extentZ[0],
+                    objectCount, &visible[0])
+        : bvh.CullFrustum(planes, &visible[0]);
+      ms.push_back(elapsedMs(start));
+    }
+    printf("bvh culling, %s: %7.3f ms/frame, %d visible\n", method == 0 ? "flat simd" : "hierarchy", median(ms), visibleCount);
+  }
+  
+  //rays from above into the level, like picking from a top down camera
+  std::vector<glm::vec3> origins(rayCount), directions(rayCount);
+  for (int i = 0; i < rayCount; i++)
+  {
+    origins[i] = glm::vec3(randomFloat(&seed, -300.0f, 300.0f), 100.0f, randomFloat(&seed, -300.0f, 300.0f));
+    directions[i] = glm::normalize(glm::vec3(randomFloat(&seed, -.2f, .2f), -1.0f, randomFloat(&seed, -.2f, .2f)));
+  }
+  
+  int hits = 0;
+  start = Clock::now();
+  for (int i = 0; i < rayCount; i++)
+  {
+    hits += bvh.Raycast(origins[i], directions[i]).object >= 0;
+  }
+  double rayMs = elapsedMs(start);
+  printf("bvh raycast: %d rays in %.1f ms, %.2f us/ray, %d hits\n", rayCount, rayMs, rayMs * 1000.0 / rayCount, hits);
+  
+  start = Clock::now();
+  for (int i = 0; i < movedCount; i++)
+  {
+    int object = (int) (randomFloat(&seed, 0, 1.0f) * (objectCount - 1));
+    glm::vec3 offset(randomFloat(&seed, -1.0f, 1.0f), .0f, randomFloat(&seed, -1.0f, 1.0f));
+    bvh.Update(object, makeAabb(bounds[object].min + offset, bounds[object].max + offset));
+  }
+  double updateMs = elapsedMs(start);
+  
+  start = Clock::now();
+  bvh.Refit(&bounds[0]);
+  printf("bvh refit: %d single object updates %.2f ms, full refit %.1f ms\n", movedCount, updateMs, elapsedMs(start));
+}
+
+//1k point lights spread in front of the camera, binned into the default
+//16x16x24 cluster grid
+internal void benchmarkLightClusters(void)
+{
+  const int lightCount = 1000;
+  const int runs = 51;
+  
+  std::vector<glm::vec4> lights_cameraSpace(lightCount);
+  unsigned seed = 3;
+  for (int i = 0; i < lightCount; i++)
+  {
+    float depth = randomFloat(&seed, 1.0f, 90.0f);
+    lights_cameraSpace[i] = glm::vec4(randomFloat(&seed, -.5f, .5f) * depth, randomFloat(&seed, -.5f, .5f) * depth,
+                                      -depth, randomFloat(&seed, 2.0f, 5.0f));
+  }
+  
+  MatrixStack cameraToClip;
+  cameraToClip.Perspective(45.0f, .1f, 100.0f);
+  
+  LightClusters clusters;
+  clusters.SetProjection(cameraToClip.Top()[0][0], cameraToClip.Top()[1][1], .1f, 100.0f);
+  
+  ThreadPool pool;
+  ThreadPool *pools[2] = {NULL, &pool};
+  for (int run = 0; run < 2; run++)
+  {
+    std::vector<double> ms;
+    for (int i = 0; i < runs; i++)
+    {
+      Clock::time_point start = Clock::now();
+      clusters.Bin(&lights_cameraSpace[0], lightCount, pools[run]);
+      ms.push_back(elapsedMs(start));
+    }
+    printf("light binning, %d lights, %d threads: %.3f ms/frame, %d indices in %d clusters\n",
+           lightCount, run == 0 ? 1 : pool.ThreadCount(), median(ms), clusters.LightIndexCount(), clusters.ClusterCount());
+  }
+}
+
+//cost of one PROFILE_SCOPE: a loop of empty scopes against the same loop
+//without them
+internal void benchmarkProfiler(void)
+{
+  const int scopeCount = 1 << 20;
+  const int runs = 11;
+  volatile int sink;
+  
+  std::vector<double> ms[2];
+  for (int i = 0; i < runs; i++)
+  {
+    Clock::time_point start = Clock::now();
+    for (int s = 0; s < scopeCount; s++)
+    {
+      sink = s;
+    }
+    ms[0].push_back(elapsedMs(start));
+    
+    start = Clock::now();
+    for (int s = 0; s < scopeCount; s++)
+    {
+      PROFILE_SCOPE("benchmark scope");
+      sink = s;
+    }
+    ms[1].push_back(elapsedMs(start));
+  }
+  
+  (void) sink;
+  
+  printf("profiler: %.1f ns/scope\n", (median(ms[1]) - median(ms[0])) * 1e6 / scopeCount);
+}
+
+//MatrixStack's kernels: the glm path it used to take (an identity matrix with
+//a few entries set, then a full glm multiply) against the in place scalar and
+//SIMD kernels of matrix_simd.h
+enum {matrixMultiply, matrixTranslate, matrixScale, matrixRotateZ, MATRIX_OP_COUNT};
+enum {matrixGlm, matrixScalar, matrixSimd, MATRIX_METHOD_COUNT};
+
+typedef void (*MatrixLoopFunc)(glm::mat4 &m, const glm::mat4 &rotation, float c, float s, int count);
+
+template <int Op, int Method>
+internal void matrixLoop(glm::mat4 &m, const glm::mat4 &rotation, float c, float s, int count)
+{
+  float *p = glm::value_ptr(m);
+  for (int i = 0; i < count; i++)
+  {
+    //alternating so the chain stays bounded
+    float scale = (i & 1) ? 1.001f : 1.0f / 1.001f;
+    if (Op == matrixMultiply)
+    {
+      if (Method == matrixGlm) m = m * rotation;
+      if (Method == matrixScalar) mat4MultiplyScalar(p, glm::value_ptr(rotation), p);
+      if (Method == matrixSimd) mat4MultiplySimd(p, glm::value_ptr(rotation), p);
+    }
+    else if (Op == matrixTranslate)
+    {
+      if (Method == matrixGlm)
+      {
+        glm::mat4 translate(1);
+        translate[3] = glm::vec4(.001f, scale, -.001f, 1.0f);
+        m = m * translate;
+      }
+      if (Method == matrixScalar) mat4TranslateScalar(p, .001f, scale, -.001f);
+      if (Method == matrixSimd) mat4TranslateSimd(p, .001f, scale, -.001f);
+    }
+    else if (Op == matrixScale)
+    {
+      if (Method == matrixGlm)
+      {
+        glm::mat4 scaleMatrix(1);
+        scaleMatrix[0][0] = scaleMatrix[1][1] = scaleMatrix[2][2] = scale;
+        m = m * scaleMatrix;
+      }
+      if (Method == matrixScalar) mat4ScaleScalar(p, scale, scale, scale);
+      if (Method == matrixSimd) mat4ScaleSimd(p, scale, scale, scale);
+    }
+    else
+    {
+      if (Method == matrixGlm)
+      {
+        glm::mat4 rotationZ(1);
+        rotationZ[0][0] = c;
+        rotationZ[0][1] = s;
+        rotationZ[1][0] = -s;
+        rotationZ[1][1] = c;
+        m = m * rotationZ;
+      }
+      if (Method == matrixScalar) mat4RotateZScalar(p, c, s);
+      if (Method == matrixSimd) mat4RotateZSimd(p, c, s);
+    }
+  }
+}
+
+#define MATRIX_LOOPS(op) {matrixLoop<op, matrixGlm>, matrixLoop<op, matrixScalar>, matrixLoop<op, matrixSimd>}
+
+internal void benchmarkMatrix(void)
+{
+  const int opCount = 1 << 20;
+  const int runs = 11;
+  
+  MatrixLoopFunc loops[MATRIX_OP_COUNT][MATRIX_METHOD_COUNT] =
+  {
+    MATRIX_LOOPS(matrixMultiply),
+    MATRIX_LOOPS(matrixTranslate),
+    MATRIX_LOOPS(matrixScale),
+    MATRIX_LOOPS(matrixRotateZ)
+  };
+  const char *opNames[MATRIX_OP_COUNT] = {"multiply", "translate", "scale", "rotateZ"};
+  
+  glm::mat4 rotation = glm::rotate(glm::mat4(1), 10.0f, glm::vec3(.267f, .535f, .802f));
+  float c = cosf(toRadians(10.0f));
+  float s = sinf(toRadians(10.0f));
+  
+  printf("matrix, ns/op       %9s %9s %9s\n", "glm", "scalar", "simd");
+  for (int op = 0; op < MATRIX_OP_COUNT; op++)
+  {
+    double ns[MATRIX_METHOD_COUNT];
+    glm::mat4 results[MATRIX_METHOD_COUNT];
+    for (int method = 0; method < MATRIX_METHOD_COUNT; method++)
+    {
+      std::vector<double> ms;
+      for (int run = 0; run < runs; run++)
+      {
+        results[method] = glm::mat4(1);
+        Clock::time_point start = Clock::now();
+        loops[op][method](results[method], rotation, c, s, opCount);
+        ms.push_back(elapsedMs(start));
+      }
+      ns[method] = median(ms) * 1e6 / opCount;
+    }
+    
+    //the kernels must agree with glm
+    float maxError = 0;
+    for (int method = 1; method < MATRIX_METHOD_COUNT; method++)
+    {
+      for (int i = 0; i < 16; i++)
+      {
+        float error = fabsf(glm::value_ptr(results[method])[i] - glm::value_ptr(results[matrixGlm])[i]);
+        maxError = error > maxError ? error : maxError;
+      }
+    }
+    printf("matrix %-12s %9.2f %9.2f %9.2f   max difference to glm %g\n",
+           opNames[op], ns[matrixGlm], ns[matrixScalar], ns[matrixSimd], maxError);
+  }
+
+#if defined(__AVX__)
+  printf("matrix: simd multiply is AVX, 2 columns per register\n");
+#else
+  printf("matrix: simd multiply is SSE, 1 column per register\n");
+#endif
+}
+
+//a frame's worth of hierarchical transforms: every object pushes a parent and
+//a child matrix, the way display() would draw a small scene graph
+template <typename Stack>
+internal glm::mat4 stackFrame(int objectCount)
+{
+  glm::mat4 sum(0);
+  Stack stack;
+  stack.Translate(0, -1.0f, -10.0f);
+  for (int i = 0; i < objectCount; i++)
+  {
+    PushStack object(stack);
+    stack.Translate((float) i, 0, 0);
+    stack.RotateZ((float) i);
+    {
+      PushStack child(stack);
+      stack.Scale(.5f);
+      sum += stack.Top();
+    }
+    sum += stack.Top();
+  }
+  
+  return sum;
+}
+
+//median ms of frameCount stackFrames; every stack type gets its own copy of
+//the loop, so one doesn't shape the other's code
+template <typename Stack>
+internal double timeStackFrames(int frameCount, int objectCount, int runs, long *allocations, glm::mat4 *sink)
+{
+  std::vector<double> ms;
+  for (int run = 0; run < runs; run++)
+  {
+    long allocationsBefore = g_allocationCount;
+    Clock::time_point start = Clock::now();
+    for (int frame = 0; frame < frameCount; frame++)
+    {
+      *sink += stackFrame<Stack>(objectCount);
+    }
+    ms.push_back(elapsedMs(start));
+    *allocations = g_allocationCount - allocationsBefore;
+  }
+  
+  return median(ms);
+}
+
+//checks that FixedMatrixStack never allocates, and times both stacks
+internal void benchmarkMatrixStack(void)
+{
+  const int frameCount = 1000;
+  const int objectCount = 64;
+  const int runs = 11;
+  
+  const char *names[2] = {"MatrixStack", "FixedMatrixStack<4>"};
+  glm::mat4 sink(0);
+  for (int method = 0; method < 2; method++)
+  {
+    long allocations = 0;
+    double ms = method == 0
+      ? timeStackFrames<MatrixStack>(frameCount, objectCount, runs, &allocations, &sink)
+      : timeStackFrames<FixedMatrixStack<4> >(frameCount, objectCount, runs, &allocations, &sink);
+    
+    double perFrame = (double) allocations / frameCount;
+    bool failed = method == 1 && allocations > 0;
+    g_checkFailed = g_checkFailed || failed;
+    printf("matrix stack %-20s %6.2f allocations/frame, %7.3f us/frame%s\n", names[method], perFrame,
+           ms * 1000.0 / frameCount, failed ? "   FAILED, expected none" : "");
+  }
+  
+  //keeps the frames from being optimized away
+  volatile float keep = sink[0][0];
+  (void) keep;
+}
+
+//Affine against glm::mat4 for what the scene graph and the cube recording do
+//per node: parent * local, and the normal matrix of camera * world
+internal void benchmarkAffine(void)
+{
+  const int nodeCount = 1 << 16;
+  const int runs = 11;
+  
+  std::vector<glm::mat4> locals(nodeCount), worlds(nodeCount);
+  std::vector<Affine> localAffines(nodeCount), worldAffines(nodeCount);
+  std::vector<glm::mat3> normals(nodeCount), normalsAffine(nodeCount);
+  unsigned seed = 3;
+  for (int i = 0; i < nodeCount; i++)
+  {
+    glm::vec3 axis = glm::normalize(glm::vec3(randomFloat(&seed, -1, 1), randomFloat(&seed, -1, 1), 1.0f));
+    glm::quat rotation = glm::angleAxis(randomFloat(&seed, -180.0f, 180.0f), axis);
+    glm::vec3 translation(randomFloat(&seed, -10, 10), randomFloat(&seed, -10, 10), randomFloat(&seed, -10, 10));
+    glm::vec3 scale(randomFloat(&seed, .5f, 2.0f), randomFloat(&seed, .5f, 2.0f), randomFloat(&seed, .5f, 2.0f));
+    localAffines[i] = makeAffine(translation, rotation, scale);
+    locals[i] = affineToMat4(localAffines[i]);
+  }
+  glm::mat4 camera = glm::lookAt(glm::vec3(.0f, 20.0f, 60.0f), glm::vec3(.0f), glm::vec3(.0f, 1.0f, .0f));
+  Affine cameraAffine = makeAffine(camera);
+  
+  //a binary tree: node i is the child of node i / 2
+  std::vector<double> ms[4];
+  for (int run = 0; run < runs; run++)
+  {
+    Clock::time_point start = Clock::now();
+    worlds[0] = locals[0];
+    for (int i = 1; i < nodeCount; i++)
+    {
+      worlds[i] = worlds[i / 2] * locals[i];
+    }
+    ms[0].push_back(elapsedMs(start));
+    
+    start = Clock::now();
+    worldAffines[0] = localAffines[0];
+    for (int i = 1; i < nodeCount; i++)
+    {
+      worldAffines[i] = affineMultiply(worldAffines[i / 2], localAffines[i]);
+    }
+    ms[1].push_back(elapsedMs(start));
+    
+    start = Clock::now();
+    for (int i = 0; i < nodeCount; i++)
+    {
+      normals[i] = glm::transpose(glm::inverse(glm::mat3(camera * locals[i])));
+    }
+    ms[2].push_back(elapsedMs(start));
+    
+    start = Clock::now();
+    for (int i = 0; i < nodeCount; i++)
+    {
+      normalsAffine[i] = affineNormalMatrix(affineMultiply(cameraAffine, localAffines[i]));
+    }
+    ms[3].push_back(elapsedMs(start));
+  }
+  
+  //relative, deep nodes get large scales
+  float worldError = 0, normalError = 0;
+  for (int i = 0; i < nodeCount; i++)
+  {
+    glm::mat4 world = affineToMat4(worldAffines[i]);
+    for (int c = 0; c < 4; c++)
+    {
+      for (int r = 0; r < 4; r++)
+      {
+        float error = fabsf(world[c][r] - worlds[i][c][r]) / (1.0f + fabsf(worlds[i][c][r]));
+        worldError = error > worldError ? error : worldError;
+      }
+    }
+    for (int c = 0; c < 3; c++)
+    {
+      for (int r = 0; r < 3; r++)
+      {
+        float error = fabsf(normalsAffine[i][c][r] - normals[i][c][r]) / (1.0f + fabsf(normals[i][c][r]));
+        normalError = error > normalError ? error : normalError;
+      }
+    }
+  }
+  
+  printf("affine parent * local  mat4 %6.2f ns, affine %6.2f ns   max relative difference %g\n",
+         median(ms[0]) * 1e6 / nodeCount, median(ms[1]) * 1e6 / nodeCount, worldError);
+  printf("affine normal matrix   mat4 %6.2f ns, affine %6.2f ns   max relative difference %g\n",
+         median(ms[2]) * 1e6 / nodeCount, median(ms[3]) * 1e6 / nodeCount, normalError);
+  
+  Affine roundTrip = affineMultiply(affineInverse(localAffines[1]), localAffines[1]);
+  Affine roundTripOrthogonal = affineMultiply(affineInverseOrthogonal(localAffines[1]), localAffines[1]);
+  float inverseError = 0;
+  for (int r = 0; r < 3; r++)
+  {
+    for (int c = 0; c < 4; c++)
+    {
+      float identity = r == c ? 1.0f : .0f;
+      inverseError = glm::max(inverseError, fabsf(roundTrip.rows[r][c] - identity));
+      inverseError = glm::max(inverseError, fabsf(roundTripOrthogonal.rows[r][c] - identity));
+    }
+  }
+  printf("affine inverse * transform: max difference to identity %g\n", inverseError);
+}
+
+//points through the world to clip matrix with the perspective divide, i.e.
+//to NDC, for 1k to 10M points. Small counts are repeated so every timing
+//covers about 10M points
+internal void benchmarkTransform(void)
+{
+  const int maxCount = 10000000;
+  const int runs = 5;
+  
+  std::vector<float> x(maxCount), y(maxCount), z(maxCount);
+  std::vector<float> outX(maxCount), outY(maxCount), outZ(maxCount);
+  std::vector<float> checkX(maxCount), checkY(maxCount), checkZ(maxCount);
+  unsigned seed = 5;
+  for (int i = 0; i < maxCount; i++)
+  {
+    x[i] = randomFloat(&seed, -50.0f, 50.0f);
+    y[i] = randomFloat(&seed, -5.0f, 20.0f);
+    z[i] = randomFloat(&seed, -50.0f, 50.0f);
+  }
+  glm::mat4 worldToClip = benchmarkWorldToClipMatrix();
+  
+  bool avx2 = cpuHasAvx2Fma();
+  printf("transform: dispatch picks %s\n", transformKernelName());
+  printf("transform, Mpoints/s     %10s %10s %10s %10s\n", "soa scalar", "soa avx2", "aos scalar", "aos avx2");
+  
+  for (int count = 1000; count <= maxCount; count *= 10)
+  {
+    int repeats = maxCount / count;
+    double pointsPerUs[4] = {0, 0, 0, 0};
+    float maxError = 0;
+    for (int method = 0; method < 4; method++)
+    {
+      bool aos = method >= 2;
+      bool simd = (method & 1) != 0;
+      if (simd && !avx2)
+      {
+        continue;
+      }
+      
+      //AoS in and out, packed from the same points
+      std::vector<glm::vec3> points, outPoints;
+      if (aos)
+      {
+        points.resize(count);
+        outPoints.resize(count);
+        for (int i = 0; i < count; i++)
+        {
+          points[i] = glm::vec3(x[i], y[i], z[i]);
+        }
+      }
+      
+      std::vector<double> ms;
+      for (int run = 0; run < runs; run++)
+      {
+        Clock::time_point start = Clock::now();
+        for (int r = 0; r < repeats; r++)
+        {
+          if (aos)
+          {
+            (simd ? transformAoSAvx2 : transformAoSScalar)(worldToClip, &points[0], count, &outPoints[0], 1.0f, true);
+          }
+          else
+          {
+            (simd ? transformSoAAvx2 : transformSoAScalar)(worldToClip, &x[0], &y[0], &z[0], count,
+                                                           &outX[0], &outY[0], &outZ[0], 1.0f, true);
+          }
+        }
+        ms.push_back(elapsedMs(start));
+      }
+      pointsPerUs[method] = (double) count * repeats / (median(ms) * 1000.0);
+      
+      if (aos)
+      {
+        for (int i = 0; i < count; i++)
+        {
+          outX[i] = outPoints[i].x;
+          outY[i] = outPoints[i].y;
+          outZ[i] = outPoints[i].z;
+        }
+      }
+      if (method == 0)
+      {
+        std::copy(outX.begin(), outX.begin() + count, checkX.begin());
+        std::copy(outY.begin(), outY.begin() + count, checkY.begin());
+        std::copy(outZ.begin(), outZ.begin() + count, checkZ.begin());
+      }
+      
+      //FMA rounds once per multiply-add, so AVX2 differs a little from scalar
+      for (int i = 0; i < count; i++)
+      {
+        float error = glm::max(fabsf(outX[i] - checkX[i]), glm::max(fabsf(outY[i] - checkY[i]), fabsf(outZ[i] - checkZ[i])));
+        maxError = glm::max(maxError, error / (1.0f + fabsf(checkX[i]) + fabsf(checkY[i])));
+      }
+    }
+    
+    printf("transform %8d points %10.1f %10.1f %10.1f %10.1f   max relative difference %g\n", count,
+           pointsPerUs[0], pointsPerUs[1], pointsPerUs[2], pointsPerUs[3], maxError);
+  }
+}
+
+//angle between two unit quaternions, in degrees, from the chord between them
+//rather than acos(dot), which loses everything under about 0.1 degrees
+internal float quaternionAngle(float ax, float ay, float az, float aw, float bx, float by, float bz, float bw)
+{
+  float sign = ax * bx + ay * by + az * bz + aw * bw < 0 ? -1.0f : 1.0f;
+  glm::vec4 chord(ax - bx * sign, ay - by * sign, az - bz * sign, aw - bw * sign);
+  float halfChord = glm::min(glm::length(chord) * .5f, 1.0f);
+  
+  return 4.0f * asinf(halfChord) * 57.29578f;
+}
+
+//one t per object between two random keyframes, against the acos/sin
+//slerp, then axis angle against quaternion rotation on a MatrixStack
+internal void benchmarkQuaternion(void)
+{
+  const int count = 100000;
+  const int runs = 11;
+  
+  std::vector<float> keyframes[8], result[4], exact[4];
+  for (int c = 0; c < 4; c++)
+  {
+    result[c].resize(count);
+    exact[c].resize(count);
+  }
+  std::vector<float> t(count);
+  std::vector<glm::quat> from(count), to(count), glmResult(count);
+  unsigned seed = 7;
+  for (int i = 0; i < count; i++)
+  {
+    //the keyframes are up to 180 degrees apart, either sign
+    for (int k = 0; k < 2; k++)
+    {
+      glm::vec3 axis = normalize(glm::vec3(randomFloat(&seed, -1.0f, 1.0f), randomFloat(&seed, -1.0f, 1.0f),
+                                           randomFloat(&seed, -1.0f, 1.0f)));
+      glm::quat q = glm::angleAxis(randomFloat(&seed, -360.0f, 360.0f), axis);
+      (k == 0 ? from : to)[i] = q;
+      keyframes[4 * k + 0].push_back(q.x);
+      keyframes[4 * k + 1].push_back(q.y);
+      keyframes[4 * k + 2].push_back(q.z);
+      keyframes[4 * k + 3].push_back(q.w);
+    }
+    t[i] = randomFloat(&seed, .0f, 1.0f);
+  }
+  QuaternionArrays a = {&keyframes[0][0], &keyframes[1][0], &keyframes[2][0], &keyframes[3][0]};
+  QuaternionArrays b = {&keyframes[4][0], &keyframes[5][0], &keyframes[6][0], &keyframes[7][0]};
+  QuaternionArrays out = {&result[0][0], &result[1][0], &result[2][0], &result[3][0]};
+  QuaternionArrays reference = {&exact[0][0], &exact[1][0], &exact[2][0], &exact[3][0]};
+  slerpQuaternionsExact(a, b, &t[0], count, reference);
+  
+  typedef void (*BatchFunc)(const QuaternionArrays &, const QuaternionArrays &, const float *, int,
+                            const QuaternionArrays &);
+  BatchFunc batches[3] = {slerpQuaternionsExact, nlerpQuaternions, slerpQuaternions};
+  const char *batchNames[3] = {"exact slerp", "batch nlerp", "batch slerp"};
+  
+  std::vector<double> ms;
+  for (int run = 0; run < runs; run++)
+  {
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < count; i++)
+    {
+      glmResult[i] = glm::slerp(from[i], to[i], t[i]);
+    }
+    ms.push_back(elapsedMs(start));
+  }
+  float glmError = 0;
+  for (int i = 0; i < count; i++)
+  {
+    glm::quat q = glm::normalize(glmResult[i]);
+    glmError = glm::max(glmError, quaternionAngle(q.x, q.y, q.z, q.w, exact[0][i], exact[1][i], exact[2][i],
+                                                  exact[3][i]));
+  }
+  printf("quaternion %-16s %7.2f ns/object   max error %g degrees\n", "glm::slerp", median(ms) * 1e6 / count,
+         glmError);
+  
+  for (int batch = 0; batch < 3; batch++)
+  {
+    ms.clear();
+    for (int run = 0; run < runs; run++)
+    {
+      Clock::time_point start = Clock::now();
+      batches[batch](a, b, &t[0], count, out);
+      ms.push_back(elapsedMs(start));
+    }
+    
+    float maxError = 0;
+    for (int i = 0; i < count; i++)
+    {
+      maxError = glm::max(maxError, quaternionAngle(result[0][i], result[1][i], result[2][i], result[3][i],
+                                                    exact[0][i], exact[1][i], exact[2][i], exact[3][i]));
+    }
+    printf("quaternion %-16s %7.2f ns/object   max error %g degrees\n", batchNames[batch],
+           median(ms) * 1e6 / count, maxError);
+  }
+  
+  //a two level hierarchy per object, rotated by axis angle or by quaternion
+  const int objectCount = 1 << 18;
+  glm::vec3 axis(.267f, .535f, .802f);
+  glm::quat rotation = glm::angleAxis(10.0f, axis);
+  glm::mat4 sums[2];
+  double stackNs[2];
+  for (int method = 0; method < 2; method++)
+  {
+    ms.clear();
+    for (int run = 0; run < runs; run++)
+    {
+      FixedMatrixStack<4> stack;
+      glm::mat4 sum(0);
+      Clock::time_point start = Clock::now();
+      for (int i = 0; i < objectCount; i++)
+      {
+        PushStack object(stack);
+        if (method == 0)
+        {
+          stack.Translate(1.0f, 2.0f, 3.0f);
+          stack.Rotate(10.0f, axis);
+          stack.Scale(.5f);
+        }
+        else
+        {
+          stack.Transform(glm::vec3(1.0f, 2.0f, 3.0f), rotation, glm::vec3(.5f));
+        }
+        PushStack child(stack);
+        if (method == 0)
+        {
+          stack.Rotate(10.0f, axis);
+        }
+        else
+        {
+          stack.Rotate(rotation);
+        }
+        sum += stack.Top();
+      }
+      ms.push_back(elapsedMs(start));
+      sums[method] = sum;
+    }
+    stackNs[method] = median(ms) * 1e6 / objectCount;
+  }
+  
+  float stackError = 0;
+  for (int i = 0; i < 16; i++)
+  {
+    float error = fabsf(glm::value_ptr(sums[1])[i] - glm::value_ptr(sums[0])[i]) / objectCount;
+    stackError = glm::max(stackError, error);
+  }
+  printf("quaternion stack, ns/object: axis angle %.2f, quaternion %.2f   max difference %g\n", stackNs[0],
+         stackNs[1], stackError);
+}
+
+//error of a float result in units in the last place of the exact value
+internal double ulpError(float result, double exact)
+{
+  float rounded = (float) exact;
+  double ulp = nextafterf(fabsf(rounded), INFINITY) - fabsf(rounded);
+  
+  return fabs(result - exact) / ulp;
+}
+
+//sinf + cosf against sincosBatch, 1M angles at a time over growing ranges;
+//errors against the double sin/cos. Then the batched rotation path, axis
+//angles to quaternions, against glm::angleAxis
+internal void benchmarkTrig(void)
+{
+  const int count = 1 << 20;
+  const int runs = 11;
+  const float ranges[4] = {PI, 100.0f, 1000.0f, 8000.0f};
+  
+  std::vector<float> x(count), s(count), c(count);
+  printf("trig, ns/angle for sin and cos   max abs error, max ulp\n");
+  for (int r = 0; r < 4; r++)
+  {
+    unsigned seed = 9;
+    for (int i = 0; i < count; i++)
+    {
+      x[i] = randomFloat(&seed, -ranges[r], ranges[r]);
+    }
+    
+    for (int method = 0; method < 3; method++)
+    {
+      std::vector<double> ms;
+      for (int run = 0; run < runs; run++)
+      {
+        Clock::time_point start = Clock::now();
+        if (method == 0)
+        {
+          for (int i = 0; i < count; i++)
+          {
+            s[i] = sinf(x[i]);
+            c[i] = cosf(x[i]);
+          }
+        }
+        else
+        {
+          sincosBatch(&x[0], count, &s[0], &c[0], method == 1 ? SINCOS_PRECISE : SINCOS_FAST);
+        }
+        ms.push_back(elapsedMs(start));
+      }
+      
+      double maxError = 0, maxUlp = 0;
+      for (int i = 0; i < count; i++)
+      {
+        double exactSin = sin((double) x[i]);
+        double exactCos = cos((double) x[i]);
+        maxError = glm::max(maxError, glm::max(fabs(s[i] - exactSin), fabs(c[i] - exactCos)));
+        maxUlp = glm::max(maxUlp, glm::max(ulpError(s[i], exactSin), ulpError(c[i], exactCos)));
+      }
+      
+      const char *names[3] = {"libm", "sincos precise", "sincos fast"};
+      printf("trig |x| < %-6g %-15s %6.2f   %.3g, %.3g\n", ranges[r], names[method], median(ms) * 1e6 / count,
+             maxError, maxUlp);
+    }
+  }
+  
+  std::vector<float> axisX(count), axisY(count), axisZ(count), degrees(count), quaternions[4];
+  std::vector<glm::quat> reference(count);
+  unsigned seed = 11;
+  for (int i = 0; i < count; i++)
+  {
+    glm::vec3 axis = normalize(glm::vec3(randomFloat(&seed, -1.0f, 1.0f), randomFloat(&seed, -1.0f, 1.0f),
+                                         randomFloat(&seed, -1.0f, 1.0f)));
+    axisX[i] = axis.x;
+    axisY[i] = axis.y;
+    axisZ[i] = axis.z;
+    degrees[i] = randomFloat(&seed, -360.0f, 360.0f);
+  }
+  for (int q = 0; q < 4; q++)
+  {
+    quaternions[q].resize(count);
+  }
+  QuaternionArrays out = {&quaternions[0][0], &quaternions[1][0], &quaternions[2][0], &quaternions[3][0]};
+  
+  for (int method = 0; method < 3; method++)
+  {
+    std::vector<double> ms;
+    for (int run = 0; run < runs; run++)
+    {
+      Clock::time_point start = Clock::now();
+      if (method == 0)
+      {
+        for (int i = 0; i < count; i++)
+        {
+          reference[i] = glm::angleAxis(degrees[i], glm::vec3(axisX[i], axisY[i], axisZ[i]));
+        }
+      }
+      else
+      {
+        quaternionsFromAxisAngles(&axisX[0], &axisY[0], &axisZ[0], &degrees[0], count, out,
+                                  method == 1 ? SINCOS_PRECISE : SINCOS_FAST);
+      }
+      ms.push_back(elapsedMs(start));
+    }
+    
+    float maxError = 0;
+    for (int i = 0; method > 0 && i < count; i++)
+    {
+      const glm::quat &q = reference[i];
+      maxError = glm::max(maxError, quaternionAngle(q.x, q.y, q.z, q.w, quaternions[0][i], quaternions[1][i],
+                                                    quaternions[2][i], quaternions[3][i]));
+    }
+    const char *names[3] = {"glm::angleAxis", "batch precise", "batch fast"};
+    printf("trig axis angle to quaternion %-15s %6.2f ns/rotation   max error %g degrees\n", names[method],
+           median(ms) * 1e6 / count, maxError);
+  }
+}
+
+//a fly-through of random keys, one view matrix per frame: Evaluate plus
+//calcLookAtMatrix frame by frame against EvaluateViewMatrices
+internal void benchmarkCameraPath(void)
+{
+  const int frameCount = 10000;
+  const int runs = 11;
+  
+  CameraPath path;
+  unsigned seed = 17;
+  for (int k = 0; k < 12; k++)
+  {
+    Camera key;
+    key.cameraSphericalRelPos = glm::vec3(k * 40.0f + randomFloat(&seed, -10.0f, 10.0f),
+                                          randomFloat(&seed, 10.0f, 80.0f), randomFloat(&seed, 20.0f, 60.0f));
+    key.cameraTargetPos = glm::vec3(randomFloat(&seed, -10.0f, 10.0f), randomFloat(&seed, .0f, 5.0f),
+                                    randomFloat(&seed, -10.0f, 10.0f));
+    path.AddKey(key);
+  }
+  
+  std::vector<glm::mat4> reference(frameCount), batch(frameCount);
+  printf("camera path, %d frames       ms      max abs error\n", frameCount);
+  for (int method = 0; method < 3; method++)
+  {
+    std::vector<double> ms;
+    for (int run = 0; run < runs; run++)
+    {
+      Clock::time_point start = Clock::now();
+      if (method == 0)
+      {
+        for (int i = 0; i < frameCount; i++)
+        {
+          reference[i] = calcLookAtMatrix(path.Evaluate(i / (frameCount - 1.0f)));
+        }
+      }
+      else
+      {
+        path.EvaluateViewMatrices(frameCount, &batch[0], method == 1 ? SINCOS_PRECISE : SINCOS_FAST);
+      }
+      ms.push_back(elapsedMs(start));
+    }
+    
+    float maxError = 0;
+    for (int i = 0; i < frameCount && method > 0; i++)
+    {
+      for (int c = 0; c < 4; c++)
+      {
+        glm::vec4 d = glm::abs(batch[i][c] - reference[i][c]);
+        maxError = glm::max(maxError, glm::max(glm::max(d.x, d.y), glm::max(d.z, d.w)));
+      }
+    }
+    
+    const char *names[3] = {"Evaluate + calcLookAtMatrix", "EvaluateViewMatrices", "  SINCOS_FAST"};
+    printf("camera path %-28s %8.3f   %.3g\n", names[method], median(ms), maxError);
+  }
+}
+
+global MicroBenchmarkReport g_microReport;
+
+//one operation at a time, inputs cycling through 1024 random ones
+internal void benchmarkMath(void)
+{
+  const int inputCount = 1024;
+  const int mask = inputCount - 1;
+  
+  std::vector<glm::mat4> matrices(inputCount);
+  std::vector<glm::vec4> points(inputCount);
+  std::vector<glm::vec3> vectors(inputCount);
+  std::vector<glm::quat> rotations(inputCount);
+  std::vector<float> angles(inputCount);
+  std::vector<Camera> cameras(inputCount);
+  unsigned seed = 13;
+  for (int i = 0; i < inputCount; i++)
+  {
+    glm::vec3 axis = normalize(glm::vec3(randomFloat(&seed, -1.0f, 1.0f), randomFloat(&seed, -1.0f, 1.0f),
+                                         randomFloat(&seed, -1.0f, 1.0f)));
+    angles[i] = randomFloat(&seed, -180.0f, 180.0f);
+    rotations[i] = glm::angleAxis(angles[i], axis);
+    vectors[i] = glm::vec3(randomFloat(&seed, -10.0f, 10.0f), randomFloat(&seed, -10.0f, 10.0f),
+                           randomFloat(&seed, -10.0f, 10.0f));
+    points[i] = glm::vec4(vectors[i], 1.0f);
+    matrices[i] = glm::translate(glm::mat4(1), vectors[i]) * glm::mat4_cast(rotations[i]) *
+                  glm::scale(glm::mat4(1), glm::vec3(randomFloat(&seed, .5f, 2.0f)));
+    cameras[i].cameraSphericalRelPos = glm::vec3(randomFloat(&seed, .0f, 360.0f), randomFloat(&seed, 1.0f, 80.0f),
+                                                 randomFloat(&seed, 5.0f, 80.0f));
+    cameras[i].cameraTargetPos = vectors[i];
+  }
+  std::vector<float> soaX(inputCount), soaY(inputCount), soaZ(inputCount);
+  std::vector<Affine> affines(inputCount);
+  for (int i = 0; i < inputCount; i++)
+  {
+    affines[i] = makeAffine(matrices[i]);
+    soaX[i] = vectors[i].x;
+    soaY[i] = vectors[i].y;
+    soaZ[i] = vectors[i].z;
+  }
+  
+  //the stack ops keep changing one matrix; scales alternate up and down so it stays finite
+  FixedMatrixStack<4> stack;
+  MatrixStack heapStack;
+  MicroBenchmarkReport &r = g_microReport;
+  
+  r.Add("stack", "Translate", runMicroBenchmark([&](int i)
+  {
+    stack.Translate(vectors[i & mask] * ((i & 1) ? 1.0f : -1.0f));
+    microBenchmarkKeep(stack.Top());
+  }));
+  r.Add("stack", "Scale", runMicroBenchmark([&](int i)
+  {
+    stack.Scale((i & 1) ? 1.25f : .8f);
+    microBenchmarkKeep(stack.Top());
+  }));
+  r.Add("stack", "RotateZ", runMicroBenchmark([&](int i)
+  {
+    stack.RotateZ(angles[i & mask]);
+    microBenchmarkKeep(stack.Top());
+  }));
+  r.Add("stack", "Rotate(degrees, axis)", runMicroBenchmark([&](int i)
+  {
+    stack.Rotate(angles[i & mask], vectors[i & mask]);
+    microBenchmarkKeep(stack.Top());
+  }));
+  r.Add("stack", "Rotate(quat)", runMicroBenchmark([&](int i)
+  {
+    stack.Rotate(rotations[i & mask]);
+    microBenchmarkKeep(stack.Top());
+  }));
+  r.Add("stack", "FixedMatrixStack Push + Pop", runMicroBenchmark([&](int i)
+  {
+    stack.Push();
+    stack.Translate(vectors[i & mask]);
+    microBenchmarkKeep(stack.Top());
+    stack.Pop();
+  }));
+  r.Add("stack", "MatrixStack Push + Pop", runMicroBenchmark([&](int i)
+  {
+    heapStack.Push();
+    heapStack.Translate(vectors[i & mask]);
+    microBenchmarkKeep(heapStack.Top());
+    heapStack.Pop();
+  }));
+  r.Add("stack", "Perspective", runMicroBenchmark([&](int i)
+  {
+    stack.Perspective(10.0f + (i & 63), .1f, 100.0f);
+    microBenchmarkKeep(stack.Top());
+  }));
+  
+  r.Add("vector", "normalize (helper.h)", runMicroBenchmark([&](int i)
+  {
+    microBenchmarkKeep(normalize(vectors[i & mask]));
+  }));
+  r.Add("vector", "glm::normalize", runMicroBenchmark([&](int i)
+  {
+    microBenchmarkKeep(glm::normalize(vectors[i & mask]));
+  }));
+  
+  r.Add("camera", "calcLookAtMatrix", runMicroBenchmark([&](int i)
+  {
+    microBenchmarkKeep(calcLookAtMatrix(cameras[i & mask]));
+  }));
+  r.Add("camera", "glm::lookAt", runMicroBenchmark([&](int i)
+  {
+    const Camera &camera = cameras[i & mask];
+    microBenchmarkKeep(glm::lookAt(resolveCameraPosition_sphericalToEuclidean(camera), camera.cameraTargetPos,
+                                   glm::vec3(.0f, 1.0f, .0f)));
+  }));
+  
+  r.Add("normal", "transpose(inverse(mat3))", runMicroBenchmark([&](int i)
+  {
+    microBenchmarkKeep(glm::transpose(glm::inverse(glm::mat3(matrices[i & mask]))));
+  }));
+  r.Add("normal", "glm::inverseTranspose", runMicroBenchmark([&](int i)
+  {
+    microBenchmarkKeep(glm::inverseTranspose(glm::mat3(matrices[i & mask])));
+  }));
+  r.Add("normal", "affineNormalMatrix", runMicroBenchmark([&](int i)
+  {
+    microBenchmarkKeep(affineNormalMatrix(affines[i & mask]));
+  }));
+  
+  r.Add("multiply", "glm mat4 * vec4", runMicroBenchmark([&](int i)
+  {
+    microBenchmarkKeep(matrices[i & mask] * points[(i + 1) & mask]);
+  }));
+  r.Add("multiply", "glm mat4 * mat4", runMicroBenchmark([&](int i)
+  {
+    microBenchmarkKeep(matrices[i & mask] * matrices[(i + 1) & mask]);
+  }));
+  r.Add("multiply", "mat4MultiplyScalar", runMicroBenchmark([&](int i)
+  {
+    float out[16];
+    mat4MultiplyScalar(glm::value_ptr(matrices[i & mask]), glm::value_ptr(matrices[(i + 1) & mask]), out);
+    microBenchmarkKeep(out);
+  }));
+  r.Add("multiply", "mat4MultiplySimd", runMicroBenchmark([&](int i)
+  {
+    float out[16];
+    mat4MultiplySimd(glm::value_ptr(matrices[i & mask]), glm::value_ptr(matrices[(i + 1) & mask]), out);
+    microBenchmarkKeep(out);
+  }));
+  r.Add("multiply", "affineMultiply", runMicroBenchmark([&](int i)
+  {
+    microBenchmarkKeep(affineMultiply(affines[i & mask], affines[(i + 1) & mask]));
+  }));
+  
+  //64 points per operation
+  std::vector<float> outX(64), outY(64), outZ(64);
+  r.Add("points", "transformSoAScalar x64", runMicroBenchmark([&](int i)
+  {
+    int first = (i * 64) & mask;
+    transformSoAScalar(matrices[i & mask], &soaX[first], &soaY[first], &soaZ[first], 64, &outX[0], &outY[0],
+                       &outZ[0], 1.0f, false);
+    microBenchmarkKeep(outX[0]);
+  }));
+  r.Add("points", "transformPoints x64 (dispatched)", runMicroBenchmark([&](int i)
+  {
+    int first = (i * 64) & mask;
+    transformPoints(matrices[i & mask], &soaX[first], &soaY[first], &soaZ[first], 64, &outX[0], &outY[0],
+                    &outZ[0], false);
+    microBenchmarkKeep(outX[0]);
+  }));
+  r.Add("points", "sincosBatch x64", runMicroBenchmark([&](int i)
+  {
+    int first = (i * 64) & mask;
+    sincosBatch(&soaX[first], 64, &outX[0], &outY[0]);
+    microBenchmarkKeep(outX[0]);
+  }));
+  
+  r.Print();
+  printf("math: transformPoints runs %s, cycles are %s\n", transformKernelName(),
+#ifdef ZZXOTO_HAS_RDTSC
+         "time stamp counter ticks"
+#else
+         "not available"
+#endif
+         );
+}
+
+global Benchmark benchmarks[] =
+{
+  {"culling", benchmarkCulling},
+  {"bvh", benchmarkBvh},
+  {"lights", benchmarkLightClusters},
+  {"profiler", benchmarkProfiler},
+  {"matrix", benchmarkMatrix},
+  {"stack", benchmarkMatrixStack},
+  {"affine", benchmarkAffine},
+  {"transform", benchmarkTransform},
+  {"quaternion", benchmarkQuaternion},
+  {"trig", benchmarkTrig},
+  {"camera_path", benchmarkCameraPath},
+  {"math", benchmarkMath},
+};
+
+int main(int argc, char **argv)
+{
+  int benchmarkCount = sizeof(benchmarks) / sizeof(benchmarks[0]);
+  
+  //names of benchmarks to run, none for all; --json <path> for the math results
+  const char *jsonPath = NULL;
+  std::vector<const char *> names;
+  for (int arg = 1; arg < argc; arg++)
+  {
+    if (strcmp(argv[arg], "--json") == 0 && arg + 1 < argc)
+    {
+      jsonPath = argv[++arg];
+    }
+    else
+    {
+      names.push_back(argv[arg]);
+    }
+  }
+  
+  for (int i = 0; i < benchmarkCount; i++)
+  {
+    bool selected = names.empty();
+    for (size_t n = 0; n < names.size(); n++)
+    {
+      selected = selected || strcmp(names[n], benchmarks[i].name) == 0;
+    }
+    
+    if (selected)
+    {
+      benchmarks[i].run();
+    }
+  }
+  
+  if (jsonPath && !g_microReport.Empty())
+  {
+    if (g_microReport.WriteJson(jsonPath))
+    {
+      printf("wrote %s\n", jsonPath);
+    }
+    else
+    {
+      printf("could not write %s\n", jsonPath);
+    }
+  }
+  
+  return g_checkFailed ? 1 : 0;
+}
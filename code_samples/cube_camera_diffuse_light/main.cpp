@@ -4,10 +4,30 @@
 #include <GL/freeglut.h>
 #include <GL/gl.h>
 #include <GL/glu.h>
+#include "zzxoto/gl_trace.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "zzxoto/helper.h"
+#include "zzxoto/camera.h"
+#include "zzxoto/constexpr_matrix.h"
+#include "zzxoto/shader_cache.h"
+#include "zzxoto/program_reflection.h"
+#include "zzxoto/thread_pool.h"
+#include "zzxoto/command_buffer.h"
+#include "zzxoto/scene_graph.h"
+#include "zzxoto/vertex_layout.h"
+#include "zzxoto/mesh_optimizer.h"
+#include "zzxoto/mesh_file.h"
+#include "zzxoto/vertex_layout_gl.h"
+#include "zzxoto/frustum_culling.h"
+#include "zzxoto/light_clusters.h"
+#include "zzxoto/headless.h"
+#include "zzxoto/profiler.h"
 #include "math.h"
+#include <chrono>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
 
 #define internal static
 #define global static
@@ -19,8 +39,9 @@ typedef unsigned int uint;
 
 global const int windowH = 640;
 global const int windowW = 640;
-global const float ZNEAR = .1f;
-global const float ZFAR = 100.0f;
+global ZZXOTO_CONSTEXPR_VALUE float ZNEAR = .1f;
+global ZZXOTO_CONSTEXPR_VALUE float ZFAR = 100.0f;
+global ZZXOTO_CONSTEXPR_VALUE ConstMat4 CAMERA_TO_CLIP = constPerspective(45.0f, ZNEAR, ZFAR);
 
 global const char *vertexShaderSource = R"FOO(
   #version 330 core
@@ -55,19 +76,55 @@ global const char *fragmentShaderSource = R"FOO(
   uniform vec3 ambientIntensity;
   uniform vec3 lightPosition_cameraSpace;
 
+  //clustered point lights, see zzxoto/light_clusters.h
+  uniform samplerBuffer clusterLights;        //2 texels per light: position_cameraSpace + radius, intensity
+  uniform usamplerBuffer clusterRanges;       //per cluster: offset, count into clusterLightIndices
+  uniform usamplerBuffer clusterLightIndices;
+  uniform ivec3 clusterDimensions;
+  uniform vec2 viewportSize;
+  uniform float clusterSliceScale;
+  uniform float clusterSliceBias;
+
   in vec3 position_cameraSpace;
   in vec3 normal_cameraSpace;
 
   out vec4 outColor;
+
+  vec3 calcClusteredLighting(vec3 normal)
+  {
+    ivec2 tile = ivec2(gl_FragCoord.xy / viewportSize * vec2(clusterDimensions.xy));
+    int slice = int(log(-position_cameraSpace.z) * clusterSliceScale + clusterSliceBias);
+    ivec3 cluster = clamp(ivec3(tile, slice), ivec3(0), clusterDimensions - 1);
+    uvec2 range = texelFetch(clusterRanges, (cluster.z * clusterDimensions.y + cluster.y) * clusterDimensions.x + cluster.x).xy;
+
+    vec3 result = vec3(0);
+    for (uint i = 0u; i < range.y; i++)
+    {
+      int light = int(texelFetch(clusterLightIndices, int(range.x + i)).x);
+      vec4 positionRadius = texelFetch(clusterLights, light * 2);
+      vec3 intensity = texelFetch(clusterLights, light * 2 + 1).xyz;
+
+      vec3 toLight = positionRadius.xyz - position_cameraSpace;
+      float distanceSquared = dot(toLight, toLight);
+      float falloff = clamp(1.0 - distanceSquared / (positionRadius.w * positionRadius.w), 0, 1);
+      float cosAngIncedence = clamp(dot(normal, toLight * inversesqrt(distanceSquared)), 0, 1);
+      result += intensity * cosAngIncedence * falloff * falloff;
+    }
+
+    return result;
+  }
+
   void main()
   {
+    vec3 normal = normalize(normal_cameraSpace);
     vec3 lightDirection_cameraSpace = normalize(lightPosition_cameraSpace - position_cameraSpace);
 
-    float cosAngIncedence = dot(normalize(normal_cameraSpace), lightDirection_cameraSpace);
+    float cosAngIncedence = dot(normal, lightDirection_cameraSpace);
     cosAngIncedence = clamp(cosAngIncedence, 0, 1);
 
     //outColor = vec4(vec3(gl_FragCoord.z), 1.0);
     outColor = vec4((diffuseColor * lightIntensity * cosAngIncedence)
+               + (diffuseColor * calcClusteredLighting(normal))
                + (diffuseColor * ambientIntensity), 1.0);
   }
 )FOO";
@@ -184,7 +241,87 @@ global float floorNormals[] =
 
 glm::vec3 floorSurfaceColor(.9f, .8f, .7f);
 
-global GLuint floorVAO, cubeVAO, matricesUBO, bindingPointUBO;
+typedef struct Mesh
+{
+  GLuint VAO;
+  GLuint indexCount;
+  GLenum indexType;   //GL_UNSIGNED_SHORT when the vertex count allows
+} Mesh;
+
+global Mesh floorMesh, cubeMesh;
+global Mesh objectMesh;   //drawn for every CubeInstance, the cube unless `--mesh` is given
+global GLuint matricesUBO, bindingPointUBO;
+
+typedef struct CubeInstance
+{
+  int node;   //in g_sceneGraph
+  glm::vec3 color;
+} CubeInstance;
+
+//the big cube in the middle, plus an optional `--grid N` field of N*N
+//small cubes to stress the frame recording. The grid cubes are children of
+//g_gridNode, which 'r' spins.
+global std::vector<CubeInstance> g_cubes;
+global int g_gridDim = 0;
+global SceneGraph g_sceneGraph;
+global int g_gridNode;
+global float g_gridRotation = 0;
+
+//`--mesh file.mesh` draws a converted mesh (see obj_to_mesh) instead of the cube
+global const char *g_meshFilePath = NULL;
+
+//`--shader-timing` compares compiling the programs against loading the cached binaries
+global bool g_reportShaderTiming = false;
+
+global ThreadPool *g_threadPool;
+global FrameRecorder *g_frameRecorder;
+
+//world space bounding spheres of g_cubes, SoA for the culling, refreshed
+//whenever the scene graph recomputed any world matrix
+typedef struct CubeBounds
+{
+  std::vector<float> x, y, z, radius;
+} CubeBounds;
+
+global CubeBounds g_cubeBounds;
+global std::vector<unsigned> g_visibleCubes;
+
+//bounding sphere of objectMesh in model space
+global glm::vec3 g_objectBoundsCenter(.0f);
+global float g_objectBoundsRadius = .8660254f;   //sqrt(3) / 2, the unit cube
+
+global glm::mat4 g_cameraToClipMatrix = toMat4(CAMERA_TO_CLIP);
+
+//`--lights N` scatters N small point lights over the floor. They are binned
+//into g_lightClusters every frame and the fragment shader only loops over the
+//ones in its own cluster.
+global int g_clusteredLightCount = 0;
+global std::vector<glm::vec4> g_clusteredLights_world;      //xyz position, w radius
+global std::vector<glm::vec3> g_clusteredLightIntensities;
+global std::vector<glm::vec4> g_clusteredLights_cameraSpace;
+global std::vector<glm::vec4> g_clusteredLightTexels;       //what clusterLights samples
+global LightClusters g_lightClusters;
+
+//texture buffers for the shader, on fixed texture units
+typedef struct ClusterBuffer
+{
+  GLuint buffer;
+  GLuint texture;
+} ClusterBuffer;
+
+global ClusterBuffer g_clusterLightsBuffer, g_clusterRangesBuffer, g_clusterLightIndicesBuffer;
+global const int clusterLightsTextureUnit = 4;
+global const int clusterRangesTextureUnit = 5;
+global const int clusterLightIndicesTextureUnit = 6;
+
+typedef struct FrameData
+{
+  glm::mat4 cameraMatrix;
+  glm::vec3 lightPosition_cameraSpace;
+  FrustumPlanes frustumPlanes;
+  const unsigned *visibleCubes;
+  int visibleCubeCount;
+} FrameData;
 
 typedef struct PointLight
 {
@@ -203,6 +340,14 @@ typedef struct FragmentLightingProgramData
   GLuint ambientIntensity;
   GLuint lightPosition_cameraSpace;
   
+  //uniform indices for the g_fragmentLightingReflection setters
+  int clusterLights;
+  int clusterRanges;
+  int clusterLightIndices;
+  int clusterDimensions;
+  int viewportSize;
+  int clusterSliceScale;
+  int clusterSliceBias;
 } FragmentLightingProgramData;
 
 typedef struct SimpleShaderProgramData
@@ -213,214 +358,217 @@ typedef struct SimpleShaderProgramData
   GLuint surfaceColor;
 } SimpleShaderProgramData;
 
-typedef struct Camera
-{
-  glm::vec3 cameraSphericalRelPos;
-  glm::vec3 cameraTargetPos;
-} Camera;
-
 FragmentLightingProgramData programData_fragmentLighting;
 SimpleShaderProgramData programData_simpleShader;
-Camera camera;
+global ProgramReflection g_fragmentLightingReflection;
+global ProgramReflection g_simpleShaderReflection;
+CachedCamera camera;
 PointLight pointLight;
 glm::vec3 ambientIntensity;
 
-internal glm::vec3 resolveCameraPosition_sphericalToEuclidean(const Camera &camera)
+//what a frame derives from the view matrix, kept until the camera changes;
+//pointLight and the clustered lights never move, so nothing else can
+//invalidate it
+typedef struct CameraDerived
 {
-  float theta = glm::radians(camera.cameraSphericalRelPos.x);
-  float phi = glm::radians(camera.cameraSphericalRelPos.y);
-  float r = camera.cameraSphericalRelPos.z;
-  
-  float cosTheta = cosf(theta);
-  float sinTheta = sinf(theta);
-  float sinPhi   = sinf(phi);
-  float cosPhi   = cosf(phi);
-  
-  glm::vec3 cameraRelPos_euclidean = glm::vec3(r * sinPhi * cosTheta, r * cosPhi, r * sinPhi * sinTheta);
-  return cameraRelPos_euclidean + camera.cameraTargetPos;
-}
+  unsigned cameraVersion;
+  glm::vec3 lightPosition_cameraSpace;
+  FrustumPlanes frustumPlanes;
+  int recomputes;
+} CameraDerived;
+
+global CameraDerived g_cameraDerived;
+global unsigned g_uploadedCameraVersion;   //of the view matrix in the UBO and the binned clustered lights
 
-internal glm::mat4 calcLookAtMatrix(const Camera &camera)
+//the uniforms are looked up in the program's reflection, filled once at load
+internal FragmentLightingProgramData loadProgram_fragmentLighting(GLuint program, ProgramReflection &r)
 {
-  const glm::vec3 upPt = glm::vec3(.0f, 1.0f, .0f);
-  const glm::vec3 &lookPt = camera.cameraTargetPos;
-  const glm::vec3 &cameraPt = resolveCameraPosition_sphericalToEuclidean(camera);
-  
-  glm::vec3 lookDir = glm::normalize(lookPt - cameraPt);
-  glm::vec3 upDir = glm::normalize(upPt);
+  FragmentLightingProgramData p;
   
-  glm::vec3 rightDir = glm::normalize(glm::cross(lookDir, upDir));
-  glm::vec3 perpUpDir = glm::cross(rightDir, lookDir);
+  r.Reflect(program);
+  p.program = program;
+  p.modelToWorldMatrix  = r.UniformLocation("modelToWorldMatrix");
+  p.normalTransformMatrix = r.UniformLocation("normalTransformMatrix");
+  p.matricesUniformBlock = r.UniformBlockIndex("Matrices");
   
-  glm::mat4 rotMat(1.0f);
-  rotMat[0] = glm::vec4(rightDir, 0.0f);
-  rotMat[1] = glm::vec4(perpUpDir, 0.0f);
-  rotMat[2] = glm::vec4(-lookDir, 0.0f);
+  p.diffuseColor   = r.UniformLocation("diffuseColor");
+  p.lightIntensity = r.UniformLocation("lightIntensity");
+  p.ambientIntensity = r.UniformLocation("ambientIntensity");
   
-  rotMat = glm::transpose(rotMat);
+  p.lightPosition_cameraSpace = r.UniformLocation("lightPosition_cameraSpace");
   
-  glm::mat4 transMat(1.0f);
-  transMat[3] = glm::vec4(-cameraPt, 1.0f);
+  p.clusterLights = r.FindUniform("clusterLights");
+  p.clusterRanges = r.FindUniform("clusterRanges");
+  p.clusterLightIndices = r.FindUniform("clusterLightIndices");
+  p.clusterDimensions = r.FindUniform("clusterDimensions");
+  p.viewportSize = r.FindUniform("viewportSize");
+  p.clusterSliceScale = r.FindUniform("clusterSliceScale");
+  p.clusterSliceBias = r.FindUniform("clusterSliceBias");
   
-  return rotMat * transMat;
+  return p;
 }
 
-internal GLuint createShaderProgram(const char *vertexShaderSource, const char *fragmentShaderSource)
+internal SimpleShaderProgramData loadProgram_simpleShader(GLuint program, ProgramReflection &r)
 {
-  uint vertexShader, fragmentShader, program;
-  
-  vertexShader = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-  glCompileShader(vertexShader);
-  
-  {
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-      glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-      cout << infoLog << endl;
-    }
-  }
+  SimpleShaderProgramData p;
   
-  fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-  glCompileShader(fragmentShader);
+  r.Reflect(program);
+  p.program = program;
   
-  {
-    int success;
-    char infoLog[512];
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-      glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-      cout << infoLog << endl;
-    }
-  }
+  p.modelToWorldMatrix  = r.UniformLocation("modelToWorldMatrix");
+  p.matricesUniformBlock = r.UniformBlockIndex("Matrices");
   
-  program = glCreateProgram();
-  glAttachShader(program, vertexShader);
-  glAttachShader(program, fragmentShader);
-  glLinkProgram(program);
-  {
-    int success;
-    char infoLog[512];
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-      glGetProgramInfoLog(program, 512, NULL, infoLog);
-      cout << infoLog << endl;
-    }
-  }
+  p.surfaceColor = r.UniformLocation("surfaceColor");
   
-  return program;
+  return p;
 }
 
-internal FragmentLightingProgramData loadProgram_fragmentLighting(const char *vertexShaderSource, const char *fragmentShaderSource)
+//position as half3, normal as snorm 2_10_10_10: 12 bytes per vertex
+internal VertexLayout meshVertexLayout(void)
 {
-  FragmentLightingProgramData p;
-  
-  p.program = createShaderProgram(vertexShaderSource, fragmentShaderSource);
-  p.modelToWorldMatrix  = glGetUniformLocation(p.program, "modelToWorldMatrix");
-  p.normalTransformMatrix = glGetUniformLocation(p.program, "normalTransformMatrix");
-  p.matricesUniformBlock = glGetUniformBlockIndex(p.program, "Matrices");
-  
-  p.diffuseColor   = glGetUniformLocation(p.program, "diffuseColor");
-  p.lightIntensity = glGetUniformLocation(p.program, "lightIntensity");
-  p.ambientIntensity = glGetUniformLocation(p.program, "ambientIntensity");
-  
-  p.lightPosition_cameraSpace = glGetUniformLocation(p.program, "lightPosition_cameraSpace");
+  VertexLayout layout = makeVertexLayout();
+  addVertexAttribute(&layout, "aPos", vf_half3);
+  addVertexAttribute(&layout, "aNormal", vf_snorm10x3);
   
-  return p;
+  return layout;
 }
 
-internal SimpleShaderProgramData loadProgram_simpleShader(const char *vertexShaderSource, const char *fragmentShaderSource)
+//optimizes the mesh for the vertex cache at load, then uploads it interleaved
+internal Mesh initMesh(const char *name, const float *positions_, const float *normals_, int vertexCount,
+                       const GLuint *indices_, int indexCount)
 {
-  SimpleShaderProgramData p;
+  std::vector<float> positions(positions_, positions_ + vertexCount * 3);
+  std::vector<float> normals(normals_, normals_ + vertexCount * 3);
+  std::vector<GLuint> indices(indices_, indices_ + indexCount);
   
-  p.program = createShaderProgram(vertexShaderSource, fragmentShaderSource);
+  void *streams[] = {&positions[0], &normals[0]};
+  size_t strides[] = {3 * sizeof(float), 3 * sizeof(float)};
+  MeshOptimizeReport report = optimizeMesh(&indices[0], indexCount, vertexCount, streams, strides, 2);
+  vertexCount = report.vertexCount;
   
-  p.modelToWorldMatrix  = glGetUniformLocation(p.program, "modelToWorldMatrix");
-  p.matricesUniformBlock = glGetUniformBlockIndex(p.program, "Matrices");
+  VertexLayout layout = meshVertexLayout();
+  const float *sources[] = {&positions[0], &normals[0]};
   
-  p.surfaceColor = glGetUniformLocation(p.program, "surfaceColor");
+  std::vector<unsigned char> vertices(vertexCount * layout.stride);
+  size_t verticesSize = packVertices(layout, sources, vertexCount, &vertices[0]);
+  
+  Mesh mesh;
+  mesh.indexCount = indexCount;
+  
+  std::vector<GLushort> shortIndices;
+  const void *indexData = &indices[0];
+  size_t indicesSize = indexCount * sizeof(GLuint);
+  mesh.indexType = GL_UNSIGNED_INT;
+  if (canUseShortIndices(vertexCount))
+  {
+    shortIndices.resize(indexCount);
+    narrowIndices(&indices[0], indexCount, &shortIndices[0]);
+    indexData = &shortIndices[0];
+    indicesSize = indexCount * sizeof(GLushort);
+    mesh.indexType = GL_UNSIGNED_SHORT;
+  }
+  
+  printf("%s: %d vertices, %u bytes interleaved (%u bytes as float3 blocks), %u index bytes, ACMR %.3f -> %.3f\n",
+         name, vertexCount, (unsigned) verticesSize, (unsigned) (vertexCount * 6 * sizeof(float)),
+         (unsigned) indicesSize, report.acmrBefore, report.acmrAfter);
   
-  return p;
-}
-
-internal void initFloor(void)
-{
   GLuint VBO, EBO, VAO;
   glGenBuffers(1, &VBO);
   glGenBuffers(1, &EBO);
   glGenVertexArrays(1, &VAO);
   
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(floorIndices), floorIndices, GL_STATIC_DRAW);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesSize, indexData, GL_STATIC_DRAW);
   
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(floorNormals) + sizeof(floorPositions), NULL, GL_STATIC_DRAW);
-  glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(floorNormals), floorNormals);
-  glBufferSubData(GL_ARRAY_BUFFER, sizeof(floorNormals), sizeof(floorPositions), floorPositions);
+  glBufferData(GL_ARRAY_BUFFER, verticesSize, &vertices[0], GL_STATIC_DRAW);
   
   glBindVertexArray(VAO);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
   
-  GLint normalAttribLocation = glGetAttribLocation(programData_fragmentLighting.program, "aNormal");
-  glVertexAttribPointer(normalAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, (void *) 0);
-  glEnableVertexAttribArray(normalAttribLocation);
-  
-  GLint positionAttribLocation = glGetAttribLocation(programData_fragmentLighting.program, "aPos");
-  glVertexAttribPointer(positionAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, (void *) sizeof(floorNormals));
-  glEnableVertexAttribArray(positionAttribLocation);
+  applyVertexLayout(layout, programData_fragmentLighting.program);
+  applyVertexLayout(layout, programData_simpleShader.program);
   
   glBindVertexArray(0);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
   
-  floorVAO = VAO;
+  mesh.VAO = VAO;
+  return mesh;
+}
+
+internal void initFloor(void)
+{
+  int vertexCount = sizeof(floorPositions) / (3 * sizeof(float));
+  int indexCount = sizeof(floorIndices) / sizeof(GLuint);
+  floorMesh = initMesh("floor", floorPositions, floorNormals, vertexCount, floorIndices, indexCount);
 }
 
 internal void initCube(void)
 {
+  int vertexCount = sizeof(cubePositions) / (3 * sizeof(float));
+  int indexCount = sizeof(cubeIndices) / sizeof(GLuint);
+  cubeMesh = initMesh("cube", cubePositions, cubeNormals, vertexCount, cubeIndices, indexCount);
+}
+
+//uploads straight from the file mapping, the data is never copied on the CPU
+internal bool initMeshFile(const char *path, Mesh *mesh)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  
+  MeshFile file;
+  if (!openMeshFile(path, &file))
+  {
+    return false;
+  }
+  
+  //a copy, the mapping is gone by the report at the end
+  const MeshFileHeader header = *file.header;
+  size_t verticesSize = (size_t) header.vertexCount * header.stride;
+  size_t indicesSize = (size_t) header.indexCount * header.indexSize;
+  
   GLuint VBO, EBO, VAO;
   glGenBuffers(1, &VBO);
   glGenBuffers(1, &EBO);
   glGenVertexArrays(1, &VAO);
   
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubeIndices), cubeIndices, GL_STATIC_DRAW);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesSize, file.indices, GL_STATIC_DRAW);
   
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(cubePositions) + sizeof(cubeNormals), NULL, GL_STATIC_DRAW);
-  glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(cubeNormals), cubeNormals);
-  glBufferSubData(GL_ARRAY_BUFFER, sizeof(cubeNormals), sizeof(cubePositions), cubePositions);
+  glBufferData(GL_ARRAY_BUFFER, verticesSize, file.vertices, GL_STATIC_DRAW);
   
   glBindVertexArray(VAO);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
   
-  {
-    GLint normalAttribLocation = glGetAttribLocation(programData_fragmentLighting.program, "aNormal");
-    glVertexAttribPointer(normalAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, (void *) 0);
-    glEnableVertexAttribArray(normalAttribLocation);
-    
-    GLint positionAttribLocation = glGetAttribLocation(programData_fragmentLighting.program, "aPos");
-    glVertexAttribPointer(positionAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, (void *) sizeof(cubeNormals));
-    glEnableVertexAttribArray(positionAttribLocation);
-  }
-  
-  {
-    GLint positionAttribLocation = glGetAttribLocation(programData_simpleShader.program, "aPos");
-    glVertexAttribPointer(positionAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, (void *) sizeof(cubeNormals));
-    glEnableVertexAttribArray(positionAttribLocation);
-  }
+  applyVertexLayout(file.layout, programData_fragmentLighting.program);
+  applyVertexLayout(file.layout, programData_simpleShader.program);
   
   glBindVertexArray(0);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
   
-  cubeVAO = VAO;
+  mesh->VAO = VAO;
+  mesh->indexCount = header.indexCount;
+  mesh->indexType = meshFileIndexType(file);
+  
+  glm::vec3 boundsMin(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+  glm::vec3 boundsMax(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+  g_objectBoundsCenter = .5f * (boundsMin + boundsMax);
+  g_objectBoundsRadius = .5f * glm::length(boundsMax - boundsMin);
+  
+  //glFinish so the timing includes the driver's copy out of the mapping
+  glFinish();
+  closeMeshFile(&file);
+  
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("%s: %u triangles, %u vertices, bounds <%.2f, %.2f, %.2f> - <%.2f, %.2f, %.2f>, loaded in %.1f ms (%.0f MB/s)\n",
+         path, header.indexCount / 3, header.vertexCount,
+         header.boundsMin[0], header.boundsMin[1], header.boundsMin[2],
+         header.boundsMax[0], header.boundsMax[1], header.boundsMax[2],
+         seconds * 1000.0, (verticesSize + indicesSize) / (1024.0 * 1024.0) / seconds);
+  
+  return true;
 }
 
 internal void initUBO()
@@ -441,10 +589,213 @@ internal void initUBO()
   glBindBufferRange(GL_UNIFORM_BUFFER, bindingPointUBO, matricesUBO, 0, 2 * sizeof(glm::mat4));
 }
 
+internal void updateCubeBounds(void)
+{
+  int cubeCount = (int) g_cubes.size();
+  g_cubeBounds.x.resize(cubeCount);
+  g_cubeBounds.y.resize(cubeCount);
+  g_cubeBounds.z.resize(cubeCount);
+  g_cubeBounds.radius.resize(cubeCount);
+  
+  for (int i = 0; i < cubeCount; i++)
+  {
+    const Affine &world = g_sceneGraph.WorldAffine(g_cubes[i].node);
+    glm::vec3 center = affineTransformPoint(world, g_objectBoundsCenter);
+    
+    //the largest axis scale bounds any rotation/non-uniform scale
+    float scale = glm::max(glm::length(affineColumn(world, 0)),
+                           glm::max(glm::length(affineColumn(world, 1)), glm::length(affineColumn(world, 2))));
+    
+    g_cubeBounds.x[i] = center.x;
+    g_cubeBounds.y[i] = center.y;
+    g_cubeBounds.z[i] = center.z;
+    g_cubeBounds.radius[i] = g_objectBoundsRadius * scale;
+  }
+}
+
+internal ClusterBuffer initClusterBuffer(int textureUnit, GLenum format)
+{
+  ClusterBuffer result;
+  glGenBuffers(1, &result.buffer);
+  glGenTextures(1, &result.texture);
+  
+  glBindBuffer(GL_TEXTURE_BUFFER, result.buffer);
+  glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  
+  glActiveTexture(GL_TEXTURE0 + textureUnit);
+  glBindTexture(GL_TEXTURE_BUFFER, result.texture);
+  glTexBuffer(GL_TEXTURE_BUFFER, format, result.buffer);
+  glActiveTexture(GL_TEXTURE0);
+  
+  return result;
+}
+
+//orphans the old storage so the upload never waits for the GPU
+internal void uploadClusterBuffer(const ClusterBuffer &clusterBuffer, const void *data, size_t size)
+{
+  glBindBuffer(GL_TEXTURE_BUFFER, clusterBuffer.buffer);
+  glBufferData(GL_TEXTURE_BUFFER, size, NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+internal void initClusteredLights(void)
+{
+  srand(1);
+  for (int i = 0; i < g_clusteredLightCount; i++)
+  {
+    float x = -25.0f + 50.0f * rand() / RAND_MAX;
+    float y = .3f + 1.7f * rand() / RAND_MAX;
+    float z = -25.0f + 50.0f * rand() / RAND_MAX;
+    float radius = 2.0f + 3.0f * rand() / RAND_MAX;
+    glm::vec3 color((float) rand() / RAND_MAX, (float) rand() / RAND_MAX, (float) rand() / RAND_MAX);
+    
+    g_clusteredLights_world.push_back(glm::vec4(x, y, z, radius));
+    g_clusteredLightIntensities.push_back(.6f * color);
+  }
+  g_clusteredLights_cameraSpace.resize(g_clusteredLightCount);
+  g_clusteredLightTexels.resize(glm::max(2 * g_clusteredLightCount, 1));
+  
+  g_lightClusters.SetProjection(g_cameraToClipMatrix[0][0], g_cameraToClipMatrix[1][1], ZNEAR, ZFAR);
+  
+  g_clusterLightsBuffer = initClusterBuffer(clusterLightsTextureUnit, GL_RGBA32F);
+  g_clusterRangesBuffer = initClusterBuffer(clusterRangesTextureUnit, GL_RG32UI);
+  g_clusterLightIndicesBuffer = initClusterBuffer(clusterLightIndicesTextureUnit, GL_R32UI);
+  
+  //without lights every cluster stays empty
+  uploadClusterBuffer(g_clusterRangesBuffer, g_lightClusters.ClusterRanges(),
+                      g_lightClusters.ClusterCount() * 2 * sizeof(unsigned));
+  
+  glm::ivec3 dimensions = g_lightClusters.Dimensions();
+  glUseProgram(programData_fragmentLighting.program);
+  g_fragmentLightingReflection.Set(programData_fragmentLighting.clusterLights, clusterLightsTextureUnit);
+  g_fragmentLightingReflection.Set(programData_fragmentLighting.clusterRanges, clusterRangesTextureUnit);
+  g_fragmentLightingReflection.Set(programData_fragmentLighting.clusterLightIndices, clusterLightIndicesTextureUnit);
+  g_fragmentLightingReflection.Set(programData_fragmentLighting.clusterDimensions, dimensions);
+  g_fragmentLightingReflection.Set(programData_fragmentLighting.clusterSliceScale, g_lightClusters.SliceScale());
+  g_fragmentLightingReflection.Set(programData_fragmentLighting.clusterSliceBias, g_lightClusters.SliceBias());
+  glUseProgram(0);
+}
+
+internal void transformClusteredLights(const glm::mat4 &cameraMatrix)
+{
+  for (int i = 0; i < g_clusteredLightCount; i++)
+  {
+    const glm::vec4 &light = g_clusteredLights_world[i];
+    glm::vec3 position_cameraSpace = glm::vec3(cameraMatrix * glm::vec4(glm::vec3(light), 1.0f));
+    g_clusteredLights_cameraSpace[i] = glm::vec4(position_cameraSpace, light.w);
+  }
+}
+
+//bins the lights for this frame's camera and uploads everything the shader reads
+internal void updateClusteredLights(const glm::mat4 &cameraMatrix)
+{
+  PROFILE_FUNCTION();
+  if (g_clusteredLightCount == 0)
+  {
+    return;
+  }
+  
+  transformClusteredLights(cameraMatrix);
+  g_lightClusters.Bin(&g_clusteredLights_cameraSpace[0], g_clusteredLightCount, g_threadPool);
+  
+  for (int i = 0; i < g_clusteredLightCount; i++)
+  {
+    g_clusteredLightTexels[i * 2] = g_clusteredLights_cameraSpace[i];
+    g_clusteredLightTexels[i * 2 + 1] = glm::vec4(g_clusteredLightIntensities[i], 1.0f);
+  }
+  
+  uploadClusterBuffer(g_clusterLightsBuffer, &g_clusteredLightTexels[0], g_clusteredLightTexels.size() * sizeof(glm::vec4));
+  uploadClusterBuffer(g_clusterRangesBuffer, g_lightClusters.ClusterRanges(),
+                      g_lightClusters.ClusterCount() * 2 * sizeof(unsigned));
+  uploadClusterBuffer(g_clusterLightIndicesBuffer, g_lightClusters.LightIndices(),
+                      glm::max(g_lightClusters.LightIndexCount(), 1) * sizeof(unsigned));
+}
+
+internal void reportLightBinning(void)
+{
+  const int frames = 100;
+  transformClusteredLights(camera.ViewMatrix());
+  
+  double ms[2];
+  ThreadPool *pools[2] = {NULL, g_threadPool};
+  for (int run = 0; run < 2; run++)
+  {
+    g_lightClusters.Bin(&g_clusteredLights_cameraSpace[0], g_clusteredLightCount, pools[run]);
+    
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++)
+    {
+      g_lightClusters.Bin(&g_clusteredLights_cameraSpace[0], g_clusteredLightCount, pools[run]);
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    ms[run] = elapsed.count() / frames;
+  }
+  
+  printf("light binning, %d lights into %d clusters, %d indices: 1 thread %.3f ms/frame, %d threads %.3f ms/frame\n",
+         g_clusteredLightCount, g_lightClusters.ClusterCount(), g_lightClusters.LightIndexCount(),
+         ms[0], g_threadPool->ThreadCount(), ms[1]);
+}
+
+internal void initScene(void)
+{
+  g_sceneGraph.Reserve(2 + g_gridDim * g_gridDim);
+  
+  CubeInstance center;
+  center.node = g_sceneGraph.AddNode(-1, glm::vec3(.0f, 1.0f, .0f), glm::quat(), glm::vec3(8.0f));
+  center.color = cubeSurfaceColor;
+  g_cubes.push_back(center);
+  
+  //grid of unit cubes laid on the floor, centered around the origin
+  g_gridNode = g_sceneGraph.AddNode(-1);
+  float spacing = 2.0f;
+  float origin = -.5f * spacing * (g_gridDim - 1);
+  for (int z = 0; z < g_gridDim; z++)
+  {
+    for (int x = 0; x < g_gridDim; x++)
+    {
+      CubeInstance cube;
+      cube.node = g_sceneGraph.AddNode(g_gridNode, glm::vec3(origin + x * spacing, .5f, origin + z * spacing));
+      cube.color = glm::vec3(.2f + .6f * x / g_gridDim, .3f, .2f + .6f * z / g_gridDim);
+      g_cubes.push_back(cube);
+    }
+  }
+  
+  g_sceneGraph.UpdateWorldTransforms();
+  updateCubeBounds();
+}
+
+internal void reportRecordingSpeedup(void);
+
+//compiles the programs once more from source and once from the binaries the
+//regular load left behind
+internal void reportShaderCacheTiming(void)
+{
+  double ms[2];
+  for (int warm = 0; warm < 2; warm++)
+  {
+    ShaderCache shaderCache;
+    shaderCache.SetUseBinaries(warm == 1);
+    shaderCache.Add(vertexShaderSource, fragmentShaderSource);
+    shaderCache.Add(vertexShaderSource2, fragmentShaderSource2);
+    shaderCache.Finish();
+    ms[warm] = shaderCache.Milliseconds();
+    
+    glDeleteProgram(shaderCache.Program(0));
+    glDeleteProgram(shaderCache.Program(1));
+  }
+  
+  printf("shader startup: cold (from source) %.1f ms, warm (from binaries) %.1f ms\n", ms[0], ms[1]);
+}
+
 internal void init(void)
 {
-  camera.cameraSphericalRelPos = glm::vec3(90.0f, 45.0f, 50.0f);
-  camera.cameraTargetPos = glm::vec3(.0f, .0f, .0f);
+  PROFILE_FUNCTION();
+  Camera state;
+  state.cameraSphericalRelPos = glm::vec3(90.0f, 45.0f, 50.0f);
+  state.cameraTargetPos = glm::vec3(.0f, .0f, .0f);
+  camera.Set(state);
   
   pointLight.intensity = glm::vec3(.8f, .8f, .8f);
   pointLight.position  = glm::vec3(5.0f, 10.0f, 4.0f);
@@ -453,181 +804,313 @@ internal void init(void)
   
   bindingPointUBO = 2;
   
-  programData_fragmentLighting = loadProgram_fragmentLighting(vertexShaderSource, fragmentShaderSource);
-  programData_simpleShader = loadProgram_simpleShader(vertexShaderSource2, fragmentShaderSource2);
+  //both programs compile together; the second run loads the binaries
+  ShaderCache shaderCache;
+  int fragmentLightingProgram = shaderCache.Add(vertexShaderSource, fragmentShaderSource);
+  int simpleShaderProgram = shaderCache.Add(vertexShaderSource2, fragmentShaderSource2);
+  shaderCache.Finish();
+  shaderCache.PrintStats("shader programs");
+  
+  programData_fragmentLighting = loadProgram_fragmentLighting(shaderCache.Program(fragmentLightingProgram),
+                                                              g_fragmentLightingReflection);
+  programData_simpleShader = loadProgram_simpleShader(shaderCache.Program(simpleShaderProgram),
+                                                      g_simpleShaderReflection);
+  
+  if (g_reportShaderTiming)
+  {
+    reportShaderCacheTiming();
+  }
   
   initUBO();
   initFloor();
   initCube();
+  
+  objectMesh = cubeMesh;
+  if (g_meshFilePath)
+  {
+    initMeshFile(g_meshFilePath, &objectMesh);
+  }
+  initScene();
+  
+  g_threadPool = new ThreadPool();
+  g_frameRecorder = new FrameRecorder(*g_threadPool);
+  
+  initClusteredLights();
+  if (g_clusteredLightCount > 0)
+  {
+    reportLightBinning();
+  }
+  
+  if (g_gridDim > 0)
+  {
+    reportRecordingSpeedup();
+  }
 }
 
-internal void drawFloor(const glm::mat4 &cameraMatrix, MatrixStack &modelMatrix)
+//NOTE: record* functions run on worker threads and must not call GL
+
+internal void recordFloor(const glm::mat4 &cameraMatrix, CommandBuffer &commands)
 {
-  PushStack push(modelMatrix);
+  FixedMatrixStack<4> modelMatrix;
   modelMatrix.Scale(glm::vec3(50.0f, 1.0f, 50.0f));
   
-  glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(cameraMatrix * modelMatrix.Top())));
+  glm::mat3 normalMatrix = affineNormalMatrix(makeAffine(cameraMatrix * modelMatrix.Top()));
   
-  glUseProgram(programData_fragmentLighting.program);
-  glUniformMatrix4fv(programData_fragmentLighting.modelToWorldMatrix, 1, GL_FALSE, glm::value_ptr(modelMatrix.Top()));
-  glUniformMatrix3fv(programData_fragmentLighting.normalTransformMatrix, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-  glUniform3f(programData_fragmentLighting.diffuseColor, floorSurfaceColor.x, floorSurfaceColor.y, floorSurfaceColor.z);
-  
-  glBindVertexArray(floorVAO);
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+  commands.DepthMask(GL_FALSE);
+  commands.UseProgram(programData_fragmentLighting.program);
+  commands.UniformMatrix4(programData_fragmentLighting.modelToWorldMatrix, modelMatrix.Top());
+  commands.UniformMatrix3(programData_fragmentLighting.normalTransformMatrix, normalMatrix);
+  commands.Uniform3f(programData_fragmentLighting.diffuseColor, floorSurfaceColor);
   
-  glUseProgram(0);
-  glBindVertexArray(0);
+  commands.BindVertexArray(floorMesh.VAO);
+  commands.DrawElements(floorMesh.indexCount, floorMesh.indexType);
+  commands.DepthMask(GL_TRUE);
 }
 
-internal void drawCube(const glm::mat4 &cameraMatrix, MatrixStack &modelMatrix)
+internal void recordCube(const Affine &cameraMatrix, const CubeInstance &cube, CommandBuffer &commands)
 {
-  PushStack push(modelMatrix);
-  modelMatrix.Scale(8.0f);
-  
-  glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(cameraMatrix * modelMatrix.Top())));
+  const Affine &modelToWorld = g_sceneGraph.WorldAffine(cube.node);
+  glm::mat4 modelToWorldMatrix = affineToMat4(modelToWorld);
   
-  glUseProgram(programData_fragmentLighting.program);
-  glUniformMatrix4fv(programData_fragmentLighting.modelToWorldMatrix, 1, GL_FALSE, glm::value_ptr(modelMatrix.Top()));
-  glUniformMatrix3fv(programData_fragmentLighting.normalTransformMatrix, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-  glUniform3f(programData_fragmentLighting.diffuseColor, cubeSurfaceColor.x, cubeSurfaceColor.y, cubeSurfaceColor.z);
+  glm::mat3 normalMatrix = affineNormalMatrix(affineMultiply(cameraMatrix, modelToWorld));
   
-  glBindVertexArray(cubeVAO);
-  glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+  commands.UseProgram(programData_fragmentLighting.program);
+  commands.UniformMatrix4(programData_fragmentLighting.modelToWorldMatrix, modelToWorldMatrix);
+  commands.UniformMatrix3(programData_fragmentLighting.normalTransformMatrix, normalMatrix);
+  commands.Uniform3f(programData_fragmentLighting.diffuseColor, cube.color);
   
-  glUseProgram(0);
-  glBindVertexArray(0);
+  commands.BindVertexArray(objectMesh.VAO);
+  commands.DrawElements(objectMesh.indexCount, objectMesh.indexType);
 }
 
-internal void drawLightSource(const glm::mat4 &cameraMatrix, MatrixStack &modelMatrix)
+internal void recordLightSource(CommandBuffer &commands)
 {
-  PushStack push(modelMatrix);
+  FixedMatrixStack<4> modelMatrix;
   modelMatrix.Translate(pointLight.position.x, pointLight.position.y, pointLight.position.z);
   //modelMatrix.Scale(.8f);
   
-  glUseProgram(programData_simpleShader.program);
-  glUniformMatrix4fv(programData_simpleShader.modelToWorldMatrix, 1, GL_FALSE, glm::value_ptr(modelMatrix.Top()));
-  glUniform3f(programData_simpleShader.surfaceColor, pointLight.intensity.x, pointLight.intensity.y, pointLight.intensity.z);
+  commands.UseProgram(programData_simpleShader.program);
+  commands.UniformMatrix4(programData_simpleShader.modelToWorldMatrix, modelMatrix.Top());
+  commands.Uniform3f(programData_simpleShader.surfaceColor, pointLight.intensity);
   
-  glBindVertexArray(cubeVAO);
-  glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+  commands.BindVertexArray(cubeMesh.VAO);
+  commands.DrawElements(cubeMesh.indexCount, cubeMesh.indexType);
+}
+
+//slice 0 also records the per-frame lighting uniforms and the floor, the last
+//slice records the light source; cubes are split evenly across slices
+internal void recordScene(int workerIndex, int workerCount, CommandBuffer &commands, void *userData)
+{
+  PROFILE_FUNCTION();
+  const FrameData *frame = (const FrameData *) userData;
   
-  glUseProgram(0);
-  glBindVertexArray(0);
+  if (workerIndex == 0)
+  {
+    commands.UseProgram(programData_fragmentLighting.program);
+    commands.Uniform3f(programData_fragmentLighting.lightIntensity, pointLight.intensity);
+    commands.Uniform3f(programData_fragmentLighting.ambientIntensity, ambientIntensity);
+    commands.Uniform3f(programData_fragmentLighting.lightPosition_cameraSpace, frame->lightPosition_cameraSpace);
+    
+    recordFloor(frame->cameraMatrix, commands);
+  }
+  
+  Affine cameraMatrix = makeAffine(frame->cameraMatrix);
+  int begin, end;
+  taskRange(frame->visibleCubeCount, workerIndex, workerCount, &begin, &end);
+  for (int i = begin; i < end; i++)
+  {
+    recordCube(cameraMatrix, g_cubes[frame->visibleCubes[i]], commands);
+  }
+  
+  if (workerIndex == workerCount - 1)
+  {
+    recordLightSource(commands);
+  }
+}
+
+//the frame's view matrix and what is derived from it, recomputed only after
+//the camera changed
+internal void setFrameCamera(FrameData *frame)
+{
+  frame->cameraMatrix = camera.ViewMatrix();
+  if (g_cameraDerived.cameraVersion != camera.Version())
+  {
+    g_cameraDerived.cameraVersion = camera.Version();
+    g_cameraDerived.lightPosition_cameraSpace = glm::vec3(frame->cameraMatrix * glm::vec4(pointLight.position, 1.0f));
+    g_cameraDerived.frustumPlanes = extractFrustumPlanes(g_cameraToClipMatrix * frame->cameraMatrix);
+    g_cameraDerived.recomputes++;
+  }
+  frame->lightPosition_cameraSpace = g_cameraDerived.lightPosition_cameraSpace;
+  frame->frustumPlanes = g_cameraDerived.frustumPlanes;
+}
+
+//fills the frame's visible cube list
+internal void cullCubes(FrameData *frame)
+{
+  PROFILE_FUNCTION();
+  int cubeCount = (int) g_cubes.size();
+  g_visibleCubes.resize(cubeCount);
+  
+  frame->visibleCubeCount = cubeCount > 0
+    ? cullSpheres(frame->frustumPlanes, &g_cubeBounds.x[0], &g_cubeBounds.y[0], &g_cubeBounds.z[0],
+                  &g_cubeBounds.radius[0], cubeCount, &g_visibleCubes[0])
+    : 0;
+  frame->visibleCubes = cubeCount > 0 ? &g_visibleCubes[0] : NULL;
+}
+
+internal void reportRecordingSpeedup(void)
+{
+  const int frames = 50;
+  FrameData frame;
+  setFrameCamera(&frame);
+  cullCubes(&frame);
+  
+  double ms[2];
+  int threadCounts[2] = {1, g_frameRecorder->ThreadCount()};
+  for (int run = 0; run < 2; run++)
+  {
+    //warm up, also lets the arenas grow to the scene size
+    g_frameRecorder->Record(recordScene, &frame, threadCounts[run]);
+    g_frameRecorder->Record(recordScene, &frame, threadCounts[run]);
+    
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++)
+    {
+      g_frameRecorder->Record(recordScene, &frame, threadCounts[run]);
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    ms[run] = elapsed.count() / frames;
+  }
+  
+  printf("command recording, %d of %d cubes visible: 1 thread %.3f ms/frame, %d threads %.3f ms/frame, speedup %.2fx\n",
+         frame.visibleCubeCount, (int) g_cubes.size(), ms[0], threadCounts[1], ms[1], ms[0] / ms[1]);
 }
 
 internal void display(void)
 {
+  PROFILE_FUNCTION();
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   
-  glm::mat4 cameraMatrix = calcLookAtMatrix(camera);
-  glBindBuffer(GL_UNIFORM_BUFFER, matricesUBO);
-  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(cameraMatrix));
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  FrameData frame;
+  setFrameCamera(&frame);
   
-  glUseProgram(programData_fragmentLighting.program);
-  glm::vec3 &intensity = pointLight.intensity;
-  glm::vec3 lightPosition_cameraSpace = glm::vec3(cameraMatrix * glm::vec4(pointLight.position, 1.0f));
-  
-  glUniform3f(programData_fragmentLighting.lightIntensity, intensity.x, intensity.y, intensity.z);
-  glUniform3f(programData_fragmentLighting.ambientIntensity, ambientIntensity.x, ambientIntensity.y, ambientIntensity.z);
-  glUniform3f(programData_fragmentLighting.lightPosition_cameraSpace, lightPosition_cameraSpace.x, lightPosition_cameraSpace.y, lightPosition_cameraSpace.z);
-  glUseProgram(0);
-  
-  MatrixStack modelMatrix;
+  //the view matrix in the UBO and the clustered lights binned in camera
+  //space only change with the camera
+  bool cameraChanged = g_uploadedCameraVersion != camera.Version();
+  if (cameraChanged)
   {
-    glDepthMask(GL_FALSE);
-    drawFloor(cameraMatrix, modelMatrix);
-    glDepthMask(GL_TRUE);
+    glBindBuffer(GL_UNIFORM_BUFFER, matricesUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(frame.cameraMatrix));
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    g_uploadedCameraVersion = camera.Version();
   }
   
+  //only the subtrees touched since the last frame are recomputed
+  g_sceneGraph.UpdateWorldTransforms(*g_threadPool);
+  if (g_sceneGraph.LastUpdatedCount() > 0)
   {
-    PushStack push(modelMatrix);
-    modelMatrix.Translate(0, 1.0f, 0.0f);
-    drawCube(cameraMatrix, modelMatrix);
+    updateCubeBounds();
   }
   
+  //cubes outside the view frustum are never recorded
+  cullCubes(&frame);
+  if (cameraChanged)
   {
-    drawLightSource(cameraMatrix, modelMatrix);
+    updateClusteredLights(frame.cameraMatrix);
   }
+  g_frameRecorder->Record(recordScene, &frame);
+  g_frameRecorder->Replay();
   
   glutSwapBuffers();
+  GL_TRACE_END_FRAME();
 }
 
 internal void keyboard(unsigned char key, int x, int y)
 {
+  Camera state = camera.State();
   switch(key)
   {
     case 27: 
     {
+      printf("uniform uploads: %d, skipped as unchanged: %d\n",
+             g_fragmentLightingReflection.UploadCount() + g_simpleShaderReflection.UploadCount(),
+             g_fragmentLightingReflection.SkippedCount() + g_simpleShaderReflection.SkippedCount());
       glutLeaveMainLoop();
       break;
     }
     case 'w': 
     {
-      camera.cameraTargetPos.z -= 4.0f; 
+      state.cameraTargetPos.z -= 4.0f; 
       break;
     }
     case 's': 
     {
-      camera.cameraTargetPos.z += 4.0f; 
+      state.cameraTargetPos.z += 4.0f; 
       break;
     }
     case 'd': 
     {
-      camera.cameraTargetPos.x += 4.0f; 
+      state.cameraTargetPos.x += 4.0f; 
       break;
     }
     case 'a': 
     {
-      camera.cameraTargetPos.x -= 4.0f; 
+      state.cameraTargetPos.x -= 4.0f; 
       break;
     }
     case 'e': 
     {
-      camera.cameraTargetPos.y -= 4.0f; 
+      state.cameraTargetPos.y -= 4.0f; 
       break;
     }
     case 'q': 
     {
-      camera.cameraTargetPos.y += 4.0f; 
+      state.cameraTargetPos.y += 4.0f; 
       break;
     }
     case 'j':
     {
-      camera.cameraSphericalRelPos.x -= 3.0f;
+      state.cameraSphericalRelPos.x -= 3.0f;
       break;
     }
     case 'l':
     {
-      camera.cameraSphericalRelPos.x += 3.0f;
+      state.cameraSphericalRelPos.x += 3.0f;
       break;
     }
     case 'i':
     {
-      camera.cameraSphericalRelPos.y -= 1.0f;
+      state.cameraSphericalRelPos.y -= 1.0f;
       break;
     }
     case 'k':
     {
-      camera.cameraSphericalRelPos.y += 1.0f;
+      state.cameraSphericalRelPos.y += 1.0f;
+      break;
+    }
+    case 'r':
+    {
+      g_gridRotation += 5.0f;
+      g_sceneGraph.SetRotation(g_gridNode, glm::angleAxis(g_gridRotation, glm::vec3(.0f, 1.0f, .0f)));
       break;
     }
   }
   
-  camera.cameraSphericalRelPos.y = glm::clamp(camera.cameraSphericalRelPos.y, 1.0f, 80.0f);
+  state.cameraSphericalRelPos.y = glm::clamp(state.cameraSphericalRelPos.y, 1.0f, 80.0f);
+  camera.Set(state);
   glutPostRedisplay();
 }
 
 internal void reshape(int w, int h)
 {
-  MatrixStack mat;
-  mat.Perspective(45.0f, ZNEAR, ZFAR);
-  
   glBindBuffer(GL_UNIFORM_BUFFER, matricesUBO);
-  glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(mat.Top()));
+  glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(g_cameraToClipMatrix));
   glBindBuffer(GL_UNIFORM_BUFFER, 0);
   
+  glUseProgram(programData_fragmentLighting.program);
+  g_fragmentLightingReflection.Set(programData_fragmentLighting.viewportSize, glm::vec2((float) w, (float) h));
+  glUseProgram(0);
+  
   glViewport(0, 0, (GLsizei) w, (GLsizei) h);
   glutPostRedisplay();
 }
@@ -637,6 +1120,26 @@ int main(int argc, char **argv)
   //glut init
   glutInit(&argc, argv);
   
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--grid") == 0 && i + 1 < argc)
+    {
+      g_gridDim = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc)
+    {
+      g_meshFilePath = argv[++i];
+    }
+    else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc)
+    {
+      g_clusteredLightCount = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--shader-timing") == 0)
+    {
+      g_reportShaderTiming = true;
+    }
+  }
+  
   //init context
   glutInitContextVersion(3, 3);
   glutInitContextProfile(GLUT_CORE_PROFILE);
@@ -657,6 +1160,7 @@ int main(int argc, char **argv)
   {
     cout << "OpenGL 3.3 not supported\n";
   }
+  GL_TRACE_INSTALL(60);
   
   glEnable(GL_CULL_FACE);
   glCullFace(GL_BACK);
@@ -678,6 +1182,10 @@ int main(int argc, char **argv)
   glutKeyboardFunc(keyboard);
   glutReshapeFunc(reshape);
   glutMainLoop();
+  PROFILE_WRITE_TRACE("build/cube_camera_diffuse_light_trace.json");
+  printf("view matrix: %d recomputes for %d requests, derived values: %d recomputes\n", camera.ViewRecomputes(),
+         camera.ViewRequests(), g_cameraDerived.recomputes);
+  printf("command buffers: %d arena growths\n", g_frameRecorder->ArenaGrowCount());
   
   return 0;
 }
\ No newline at end of file
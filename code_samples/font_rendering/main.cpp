@@ -5,9 +5,16 @@
 #include <GL/freeglut.h>
 #include <GL/gl.h>
 #include <GL/glu.h>
+#include <zzxoto/gl_trace.h>
 #include <stdio.h>
 #include <zzxoto/helper.h>
+#include <zzxoto/constexpr_matrix.h>
 #include <zzxoto/gl_helper.h>
+#include <zzxoto/headless.h>
+#include <zzxoto/frame_benchmark.h>
+#include <zzxoto/game_loop.h>
+#include <zzxoto/quaternion_batch.h>
+#include <zzxoto/profiler.h>
 #include <iostream>
 
 using std::cout;
@@ -43,9 +50,9 @@ typedef struct Font
 } Font;
 Font *g_font;
 
-static const int FPS = 60;
-static const int DELAYMS = 1000 / FPS;
+static FixedStepLoop g_gameLoop(1.0 / 60);
 static int g_frames = 0;
+static FrameBenchmark g_frameBenchmark;
 static int g_windowH = 600, g_windowW = 600;
 static int g_displayTextLeft = 100, g_displayTextTop = 100;
 
@@ -63,7 +70,13 @@ Lazy  DOg
 static glm::mat4 g_worldToClipMatrix(1);
 static glm::mat4 g_modelMatrix(1);
 
-static float g_zRotation  = 0;
+//For top left coordinate, rotation around -Z axis for CCW
+//cupping direction
+static glm::quat g_rotation;
+static glm::quat g_previousRotation;   //at the update step before, for interpolation
+static const float SPIN_DEGREES_PER_SECOND = 60.0f;
+static const glm::quat g_spinStep = glm::angleAxis(SPIN_DEGREES_PER_SECOND * (float) g_gameLoop.StepSeconds(),
+                                                   glm::vec3(0.f, 0.f, -1.f));
 static bool g_shouldSpin = true;
 
 uchar g_characters[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz01234567891 !@#$%^&*()-_+=.";
@@ -72,6 +85,7 @@ uchar ttfBuffer[1 << 22];
 
 Font *initFont(char *ttfFilename, int fontHeightPx)
 {
+  PROFILE_FUNCTION();
   Font *myFont;
   //1. load ttf content to buffer
   FILE *fp = fopen(ttfFilename, "r");
@@ -270,6 +284,7 @@ void initShaderData(Font *font)
 
 void init()
 {
+  PROFILE_FUNCTION();
   g_programData = initProgram(pixelCoordVertexShader, fontFragShader);
   g_font = initFont("shared/data/arial.ttf", 30);
   initShaderData(g_font);
@@ -400,39 +415,50 @@ void layoutText(Font *font, const char *text, int left, int top, int *right, int
   *bottom = top + h;
 }
 
+//one fixed step of g_gameLoop.StepSeconds()
 static void update()
 {
-  int textLayoutW = 0, textLayoutH = 0;
-  layoutText(g_font, g_displayTextBuffer, 0, 0, &textLayoutW, &textLayoutH);
-  
+  PROFILE_FUNCTION();
+  g_previousRotation = g_rotation;
   if (g_shouldSpin)
   {
-    g_zRotation += 1.0f;
+    //renormalized so rounding can't build up over many steps
+    g_rotation = glm::normalize(g_spinStep * g_rotation);
+  }
+}
+
+void exitGameLoop()
+{
+  glutIdleFunc(NULL);
+  glutLeaveMainLoop();
+}
+
+static void display()
+{
+  PROFILE_FUNCTION();
+  glClearColor(.1f, .2f, .2f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  
+  glUseProgram(g_programData.program);
+  
+  //rotation between the last two update steps
+  {
+    int textLayoutW = 0, textLayoutH = 0;
+    layoutText(g_font, g_displayTextBuffer, 0, 0, &textLayoutW, &textLayoutH);
     
+    float alpha = (float) g_gameLoop.Alpha();
+    glm::quat rotation = nlerp(g_previousRotation, g_rotation, alpha);
     float translateX = g_displayTextLeft + textLayoutW / 2;
     float translateY = g_displayTextTop + textLayoutH / 2;
     
-    MatrixStack mat;
+    FixedMatrixStack<4> mat;
     mat.Translate(translateX, translateY, 0);
-    //For top left coordinate, rotation around -Z axis for CCW
-    //cupping direction
-    mat.Rotate(g_zRotation, glm::vec3(0.f, 0.f, -1.f));
+    mat.Rotate(rotation);
     
     mat.Translate(-translateX, -translateY, 0);
     g_modelMatrix = mat.Top();
-    
-    glUseProgram(g_programData.program);
     glUniformMatrix4fv(g_programData.modelMatrix, 1, GL_FALSE, glm::value_ptr(g_modelMatrix));
-    glUseProgram(0);
   }
-}
-
-static void display()
-{
-  glClearColor(.1f, .2f, .2f, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  
-  glUseProgram(g_programData.program);
   
   glUniform3f(g_programData.fontColor, .8f, .8f, .8f);
   
@@ -440,7 +466,14 @@ static void display()
   
   glUseProgram(0);
   
+  g_frameBenchmark.EndPhase(phase_display);
   glutSwapBuffers();
+  g_frameBenchmark.EndPhase(phase_swap);
+  GL_TRACE_END_FRAME();
+  if (g_frameBenchmark.EndFrame())
+  {
+    exitGameLoop();
+  }
 }
 
 static void reshape(int w, int h)
@@ -448,11 +481,8 @@ static void reshape(int w, int h)
   g_windowH = h;
   g_windowW = w;
   
-  MatrixStack mat;
-  mat.Translate(-1.0f, 1.0f, 0.0f);
-  mat.Scale(glm::vec3(2.0f / g_windowW, -2.0f / g_windowH, 1.0f));  
-  
-  g_worldToClipMatrix = mat.Top();
+  //pixels to clip space: top left origin, y down
+  g_worldToClipMatrix = toMat4(constOrthographic(0, (float) g_windowW, (float) g_windowH, 0, 1, -1));
   
   glUseProgram(g_programData.program);
   glUniformMatrix4fv(g_programData.worldToClipMatrix, 1, GL_FALSE, glm::value_ptr(g_worldToClipMatrix));
@@ -461,23 +491,19 @@ static void reshape(int w, int h)
   glViewport(0, 0, (GLsizei) w, (GLsizei) h);
 }
 
-static bool g_gameLoopContinues = true;
-void runGameLoop(int val)
+//idle func: update at a fixed 60 Hz, render as often as the swap allows
+void runGameLoop()
 {
   g_frames++;
   
-  update();
-  display();
-  
-  if (g_gameLoopContinues)
+  g_frameBenchmark.BeginFrame();
+  int steps = g_gameLoop.Advance();
+  for (int i = 0; i < steps; i++)
   {
-    glutTimerFunc(DELAYMS, runGameLoop, val);
+    update();
   }
-}
-
-void exitGameLoop()
-{
-  g_gameLoopContinues = false;
+  g_frameBenchmark.EndPhase(phase_update);
+  glutPostRedisplay();
 }
 
 
@@ -496,6 +522,12 @@ static void keyboard(uchar key, int x, int y)
       g_shouldSpin = !g_shouldSpin;
       break;
     }
+    case 'r':
+    {
+      printf("%.1f updates/s, %.1f frames/s, %.3f s dropped\n", g_gameLoop.UpdateRate(), g_gameLoop.RenderRate(),
+             g_gameLoop.DroppedSeconds());
+      break;
+    }
     
   }
 }
@@ -505,6 +537,20 @@ int main(int argc, char **argv)
   //init glut
   glutInit(&argc, argv);
   
+  int benchmarkFrames = 0;
+  const char *benchmarkJsonPath = "build/font_rendering_benchmark.json";
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc)
+    {
+      benchmarkFrames = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--benchmark-json") == 0 && i + 1 < argc)
+    {
+      benchmarkJsonPath = argv[++i];
+    }
+  }
+  
   //init context
   glutInitContextVersion(3, 3);
   glutInitContextProfile(GLUT_CORE_PROFILE);
@@ -528,6 +574,7 @@ int main(int argc, char **argv)
     printf("OpenGL 3.1 not supported\n");
     return 1;
   }
+  GL_TRACE_INSTALL(60);
   glDisable(GL_CULL_FACE);
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);  
@@ -538,9 +585,14 @@ int main(int argc, char **argv)
   glutKeyboardFunc(keyboard);
   glutDisplayFunc(display);
   
-  runGameLoop(0);
+  if (benchmarkFrames > 0)
+  {
+    g_frameBenchmark.Start("font_rendering", benchmarkFrames, benchmarkJsonPath);
+  }
+  glutIdleFunc(runGameLoop);
   
   glutMainLoop();
+  PROFILE_WRITE_TRACE("build/font_rendering_trace.json");
   
   return 0;
 }
\ No newline at end of file
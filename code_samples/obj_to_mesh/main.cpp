@@ -0,0 +1,376 @@
+//Converts a Wavefront OBJ file into the binary mesh format of zzxoto/mesh_file.h
+//
+//Usage: main <input.obj> <output.mesh> [--half]
+//  --half  store positions as half floats instead of floats
+//
+//Vertices are deduplicated on their (position, texcoord, normal) triple,
+//polygons are fan triangulated, missing normals are computed as smooth
+//normals, and the result goes through the vertex cache optimizer before it is
+//packed into an interleaved layout.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "zzxoto/vertex_layout.h"
+#include "zzxoto/mesh_optimizer.h"
+#include "zzxoto/mesh_file.h"
+
+#define internal static
+
+typedef struct ObjCorner
+{
+  int position;
+  int texcoord;   //-1 when absent
+  int normal;     //-1 when absent
+} ObjCorner;
+
+struct ObjCornerHash
+{
+  size_t operator()(const ObjCorner &c) const
+  {
+    unsigned long long h = (unsigned) c.position;
+    h = h * 0x9e3779b97f4a7c15ull + (unsigned) c.texcoord;
+    h = h * 0x9e3779b97f4a7c15ull + (unsigned) c.normal;
+    return (size_t) (h ^ (h >> 29));
+  }
+};
+
+struct ObjCornerEqual
+{
+  bool operator()(const ObjCorner &a, const ObjCorner &b) const
+  {
+    return a.position == b.position && a.texcoord == b.texcoord && a.normal == b.normal;
+  }
+};
+
+typedef struct ObjData
+{
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec2> texcoords;
+  std::vector<glm::vec3> normals;
+  std::vector<ObjCorner> corners;   //3 per triangle
+} ObjData;
+
+internal const char *skipSpaces(const char *at)
+{
+  while (*at == ' ' || *at == '\t')
+  {
+    at++;
+  }
+  return at;
+}
+
+internal const char *nextLine(const char *at)
+{
+  while (*at && *at != '\n')
+  {
+    at++;
+  }
+  return *at ? at + 1 : at;
+}
+
+//OBJ indices are 1 based, negative ones count back from the end. Out of
+//range ones (0 too) come back as count, so they fail the face's range checks
+internal int resolveObjIndex(int index, int count)
+{
+  int resolved = index < 0 ? count + index : index - 1;
+  return resolved >= 0 && resolved < count ? resolved : count;
+}
+
+internal const char *parseCorner(const char *at, const ObjData &obj, ObjCorner *corner)
+{
+  char *end;
+  corner->position = resolveObjIndex(strtol(at, &end, 10), (int) obj.positions.size());
+  corner->texcoord = -1;
+  corner->normal = -1;
+  at = end;
+  
+  if (*at == '/')
+  {
+    at++;
+    if (*at != '/')
+    {
+      corner->texcoord = resolveObjIndex(strtol(at, &end, 10), (int) obj.texcoords.size());
+      at = end;
+    }
+    if (*at == '/')
+    {
+      at++;
+      corner->normal = resolveObjIndex(strtol(at, &end, 10), (int) obj.normals.size());
+      at = end;
+    }
+  }
+  
+  return at;
+}
+
+internal bool parseObj(const char *text, ObjData *obj)
+{
+  const char *at = text;
+  
+  while (*at)
+  {
+    at = skipSpaces(at);
+    char *end;
+    
+    if (at[0] == 'v' && (at[1] == ' ' || at[1] == '\t'))
+    {
+      glm::vec3 p;
+      p.x = strtof(at + 2, &end);
+      p.y = strtof(end, &end);
+      p.z = strtof(end, &end);
+      obj->positions.push_back(p);
+    }
+    else if (at[0] == 'v' && at[1] == 't')
+    {
+      glm::vec2 t;
+      t.x = strtof(at + 2, &end);
+      t.y = strtof(end, &end);
+      obj->texcoords.push_back(t);
+    }
+    else if (at[0] == 'v' && at[1] == 'n')
+    {
+      glm::vec3 n;
+      n.x = strtof(at + 2, &end);
+      n.y = strtof(end, &end);
+      n.z = strtof(end, &end);
+      obj->normals.push_back(n);
+    }
+    else if (at[0] == 'f' && (at[1] == ' ' || at[1] == '\t'))
+    {
+      //fan triangulation: (0, i - 1, i)
+      ObjCorner first = {}, previous = {}, corner;
+      int count = 0;
+      
+      at = skipSpaces(at + 1);
+      while (*at && *at != '\n' && *at != '\r')
+      {
+        at = parseCorner(at, *obj, &corner);
+        //texcoord and normal are -1 when the corner has none
+        if (corner.position < 0 || corner.position >= (int) obj->positions.size() ||
+            corner.texcoord >= (int) obj->texcoords.size() || corner.normal >= (int) obj->normals.size())
+        {
+          printf("Invalid face index\n");
+          return false;
+        }
+        
+        if (count == 0)
+        {
+          first = corner;
+        }
+        else if (count >= 2)
+        {
+          obj->corners.push_back(first);
+          obj->corners.push_back(previous);
+          obj->corners.push_back(corner);
+        }
+        previous = corner;
+        count++;
+        
+        at = skipSpaces(at);
+      }
+    }
+    
+    at = nextLine(at);
+  }
+  
+  return true;
+}
+
+internal char *readFile(const char *path, size_t *size)
+{
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL)
+  {
+    return NULL;
+  }
+  
+  fseek(fp, 0, SEEK_END);
+  *size = (size_t) ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  
+  char *text = (char *) malloc(*size + 1);
+  *size = fread(text, 1, *size, fp);
+  text[*size] = 0;
+  fclose(fp);
+  
+  return text;
+}
+
+internal double secondsSince(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    printf("Usage: main <input.obj> <output.mesh> [--half]\n");
+    return 1;
+  }
+  
+  bool halfPositions = argc > 3 && strcmp(argv[3], "--half") == 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  
+  //1. parse
+  size_t textSize;
+  char *text = readFile(argv[1], &textSize);
+  if (text == NULL)
+  {
+    printf("Failed to read %s\n", argv[1]);
+    return 1;
+  }
+  
+  ObjData obj;
+  bool parsed = parseObj(text, &obj);
+  free(text);
+  if (!parsed || obj.corners.empty())
+  {
+    printf("No triangles in %s\n", argv[1]);
+    return 1;
+  }
+  printf("parsed %u bytes in %.3f s\n", (unsigned) textSize, secondsSince(start));
+  
+  //2. deduplicate corners into vertices
+  bool hasTexcoords = !obj.texcoords.empty();
+  bool hasNormals = !obj.normals.empty();
+  
+  std::vector<float> positions, normals, texcoords;
+  std::vector<unsigned> indices;
+  std::vector<int> vertexPosition;   //position index of every vertex, for smooth normals
+  indices.reserve(obj.corners.size());
+  
+  {
+    std::unordered_map<ObjCorner, unsigned, ObjCornerHash, ObjCornerEqual> vertexMap;
+    vertexMap.reserve(obj.corners.size());
+    
+    for (size_t i = 0; i < obj.corners.size(); i++)
+    {
+      ObjCorner c = obj.corners[i];
+      if (!hasTexcoords)
+      {
+        c.texcoord = -1;
+      }
+      if (!hasNormals)
+      {
+        c.normal = -1;
+      }
+      
+      std::pair<std::unordered_map<ObjCorner, unsigned, ObjCornerHash, ObjCornerEqual>::iterator, bool> inserted =
+        vertexMap.insert(std::make_pair(c, (unsigned) vertexPosition.size()));
+      
+      if (inserted.second)
+      {
+        vertexPosition.push_back(c.position);
+        
+        const glm::vec3 &p = obj.positions[c.position];
+        positions.push_back(p.x);
+        positions.push_back(p.y);
+        positions.push_back(p.z);
+        
+        glm::vec3 n = c.normal >= 0 ? glm::normalize(obj.normals[c.normal]) : glm::vec3(0);
+        normals.push_back(n.x);
+        normals.push_back(n.y);
+        normals.push_back(n.z);
+        
+        if (hasTexcoords)
+        {
+          glm::vec2 t = c.texcoord >= 0 ? obj.texcoords[c.texcoord] : glm::vec2(0);
+          texcoords.push_back(t.x);
+          texcoords.push_back(t.y);
+        }
+      }
+      
+      indices.push_back(inserted.first->second);
+    }
+  }
+  
+  int vertexCount = (int) vertexPosition.size();
+  int indexCount = (int) indices.size();
+  
+  //3. smooth normals, accumulated per position so split vertices agree
+  if (!hasNormals)
+  {
+    std::vector<glm::vec3> accumulated(obj.positions.size(), glm::vec3(0));
+    for (int t = 0; t < indexCount; t += 3)
+    {
+      int a = vertexPosition[indices[t]];
+      int b = vertexPosition[indices[t + 1]];
+      int c = vertexPosition[indices[t + 2]];
+      
+      //area weighted
+      glm::vec3 faceNormal = glm::cross(obj.positions[b] - obj.positions[a], obj.positions[c] - obj.positions[a]);
+      accumulated[a] += faceNormal;
+      accumulated[b] += faceNormal;
+      accumulated[c] += faceNormal;
+    }
+    
+    for (int v = 0; v < vertexCount; v++)
+    {
+      glm::vec3 n = accumulated[vertexPosition[v]];
+      float length = glm::length(n);
+      n = length > 0 ? n / length : glm::vec3(0, 1, 0);
+      normals[v * 3] = n.x;
+      normals[v * 3 + 1] = n.y;
+      normals[v * 3 + 2] = n.z;
+    }
+  }
+  
+  //4. vertex cache and fetch order
+  void *streams[] = {&positions[0], &normals[0], hasTexcoords ? &texcoords[0] : NULL};
+  size_t strides[] = {3 * sizeof(float), 3 * sizeof(float), 2 * sizeof(float)};
+  MeshOptimizeReport report = optimizeMesh(&indices[0], indexCount, vertexCount, streams, strides, hasTexcoords ? 3 : 2);
+  vertexCount = report.vertexCount;
+  
+  //5. pack
+  VertexLayout layout = makeVertexLayout();
+  addVertexAttribute(&layout, "aPos", halfPositions ? vf_half3 : vf_float3);
+  addVertexAttribute(&layout, "aNormal", vf_snorm10x3);
+  if (hasTexcoords)
+  {
+    addVertexAttribute(&layout, "textureCoord", vf_float2);
+  }
+  
+  const float *sources[] = {&positions[0], &normals[0], hasTexcoords ? &texcoords[0] : NULL};
+  std::vector<unsigned char> vertices((size_t) vertexCount * layout.stride);
+  packVertices(layout, sources, vertexCount, &vertices[0]);
+  
+  float boundsMin[3] = {positions[0], positions[1], positions[2]};
+  float boundsMax[3] = {positions[0], positions[1], positions[2]};
+  for (int v = 0; v < vertexCount; v++)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      boundsMin[k] = fminf(boundsMin[k], positions[v * 3 + k]);
+      boundsMax[k] = fmaxf(boundsMax[k], positions[v * 3 + k]);
+    }
+  }
+  
+  std::vector<unsigned short> shortIndices;
+  const void *indexData = &indices[0];
+  int indexSize = sizeof(unsigned);
+  if (canUseShortIndices(vertexCount))
+  {
+    shortIndices.resize(indexCount);
+    narrowIndices(&indices[0], indexCount, &shortIndices[0]);
+    indexData = &shortIndices[0];
+    indexSize = sizeof(unsigned short);
+  }
+  
+  //6. write
+  if (!writeMeshFile(argv[2], layout, &vertices[0], vertexCount, indexData, indexCount, indexSize, boundsMin, boundsMax))
+  {
+    return 1;
+  }
+  
+  printf("%s: %d triangles, %d vertices, %u byte stride, %d bit indices, ACMR %.3f -> %.3f, %.3f s\n",
+         argv[2], indexCount / 3, vertexCount, layout.stride, indexSize * 8,
+         report.acmrBefore, report.acmrAfter, secondsSince(start));
+  
+  return 0;
+}
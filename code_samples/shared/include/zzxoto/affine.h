@@ -0,0 +1,188 @@
+#ifndef H_ZZXOTO_AFFINE
+#define H_ZZXOTO_AFFINE
+
+//Affine transform stored as the top three rows of a 4x4 matrix, 48 bytes.
+//The bottom row of every model, camera and hierarchy transform in the
+//samples is (0, 0, 0, 1), so there is no need to store or multiply it:
+//
+//  [ linear  | translation ]     a point p maps to linear * p + translation
+//  [ 0  0  0 |      1      ]
+//
+//affineMultiply is 36 multiply-adds against 64 for a glm::mat4 product, done
+//as 9 SSE multiply-adds on rows (like frustum_culling.h, SSE is assumed). The
+//normal matrix comes straight from cross products of the linear columns
+//instead of a general 3x3 inverse. affineToMat4/makeAffine convert to and
+//from glm::mat4 without losing anything; upload the glm::mat4.
+//
+//No GL dependency.
+
+#include <math.h>
+#include <emmintrin.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+typedef struct Affine
+{
+  float rows[3][4];   //row i: linear row i, translation i
+} Affine;
+
+static_assert(sizeof(Affine) == 48, "Affine must stay 3x4 floats");
+
+Affine makeAffineIdentity(void)
+{
+  Affine result =
+  {{
+    {1.0f, .0f, .0f, .0f},
+    {.0f, 1.0f, .0f, .0f},
+    {.0f, .0f, 1.0f, .0f}
+  }};
+  
+  return result;
+}
+
+//m must be affine, its bottom row is dropped
+Affine makeAffine(const glm::mat4 &m)
+{
+  Affine result;
+  for (int row = 0; row < 3; row++)
+  {
+    for (int column = 0; column < 4; column++)
+    {
+      result.rows[row][column] = m[column][row];
+    }
+  }
+  
+  return result;
+}
+
+//translate * rotate * scale, the order SceneGraph composes a node in
+Affine makeAffine(const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale)
+{
+  float x = rotation.x, y = rotation.y, z = rotation.z, w = rotation.w;
+  
+  Affine result =
+  {{
+    {(1.0f - 2.0f * (y * y + z * z)) * scale.x, 2.0f * (x * y - w * z) * scale.y,
+     2.0f * (x * z + w * y) * scale.z, translation.x},
+    {2.0f * (x * y + w * z) * scale.x, (1.0f - 2.0f * (x * x + z * z)) * scale.y,
+     2.0f * (y * z - w * x) * scale.z, translation.y},
+    {2.0f * (x * z - w * y) * scale.x, 2.0f * (y * z + w * x) * scale.y,
+     (1.0f - 2.0f * (x * x + y * y)) * scale.z, translation.z}
+  }};
+  
+  return result;
+}
+
+glm::mat4 affineToMat4(const Affine &a)
+{
+  glm::mat4 result;
+  for (int column = 0; column < 4; column++)
+  {
+    result[column] = glm::vec4(a.rows[0][column], a.rows[1][column], a.rows[2][column], column == 3 ? 1.0f : .0f);
+  }
+  
+  return result;
+}
+
+//a * b: apply b first, then a
+Affine affineMultiply(const Affine &a, const Affine &b)
+{
+  //row i of the result is a weighted sum of b's rows, one SSE register per row
+  __m128 b0 = _mm_loadu_ps(b.rows[0]);
+  __m128 b1 = _mm_loadu_ps(b.rows[1]);
+  __m128 b2 = _mm_loadu_ps(b.rows[2]);
+  __m128 lastLane = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+  
+  Affine result;
+  for (int row = 0; row < 3; row++)
+  {
+    __m128 r = _mm_loadu_ps(a.rows[row]);
+    __m128 sum = _mm_mul_ps(_mm_shuffle_ps(r, r, 0x00), b0);
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(r, r, 0x55), b1));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(r, r, 0xaa), b2));
+    sum = _mm_add_ps(sum, _mm_and_ps(r, lastLane));   //plus a's translation
+    _mm_storeu_ps(result.rows[row], sum);
+  }
+  
+  return result;
+}
+
+glm::vec3 affineTransformPoint(const Affine &a, const glm::vec3 &p)
+{
+  return glm::vec3(a.rows[0][0] * p.x + a.rows[0][1] * p.y + a.rows[0][2] * p.z + a.rows[0][3],
+                   a.rows[1][0] * p.x + a.rows[1][1] * p.y + a.rows[1][2] * p.z + a.rows[1][3],
+                   a.rows[2][0] * p.x + a.rows[2][1] * p.y + a.rows[2][2] * p.z + a.rows[2][3]);
+}
+
+glm::vec3 affineTransformVector(const Affine &a, const glm::vec3 &v)
+{
+  return glm::vec3(a.rows[0][0] * v.x + a.rows[0][1] * v.y + a.rows[0][2] * v.z,
+                   a.rows[1][0] * v.x + a.rows[1][1] * v.y + a.rows[1][2] * v.z,
+                   a.rows[2][0] * v.x + a.rows[2][1] * v.y + a.rows[2][2] * v.z);
+}
+
+glm::vec3 affineColumn(const Affine &a, int column)
+{
+  return glm::vec3(a.rows[0][column], a.rows[1][column], a.rows[2][column]);
+}
+
+//Inverse of rotation * scale + translation, i.e. linear columns that are
+//orthogonal (no shear). The inverse linear part is the transpose with row i
+//divided by the squared length of column i, so no determinant is needed.
+//Non-uniform scale under a rotated child does shear; use affineInverse there
+Affine affineInverseOrthogonal(const Affine &a)
+{
+  glm::vec3 translation = affineColumn(a, 3);
+  
+  Affine result;
+  for (int row = 0; row < 3; row++)
+  {
+    glm::vec3 column = affineColumn(a, row);
+    float lengthSquared = glm::dot(column, column);
+    glm::vec3 inverseRow = lengthSquared > 0 ? column / lengthSquared : column;
+    result.rows[row][0] = inverseRow.x;
+    result.rows[row][1] = inverseRow.y;
+    result.rows[row][2] = inverseRow.z;
+    result.rows[row][3] = -glm::dot(inverseRow, translation);
+  }
+  
+  return result;
+}
+
+//Transpose of the inverse linear part: the cross products of its columns over
+//the determinant. Transforms normals correctly under any scale and shear.
+glm::mat3 affineNormalMatrix(const Affine &a)
+{
+  glm::vec3 c0 = affineColumn(a, 0);
+  glm::vec3 c1 = affineColumn(a, 1);
+  glm::vec3 c2 = affineColumn(a, 2);
+  
+  glm::vec3 n0 = glm::cross(c1, c2);
+  float determinant = glm::dot(c0, n0);
+  float inverseDeterminant = determinant != 0 ? 1.0f / determinant : .0f;
+  
+  return glm::mat3(n0 * inverseDeterminant, glm::cross(c2, c0) * inverseDeterminant,
+                   glm::cross(c0, c1) * inverseDeterminant);
+}
+
+//any invertible affine transform
+Affine affineInverse(const Affine &a)
+{
+  //inverse linear part = transpose of the normal matrix
+  glm::mat3 normalMatrix = affineNormalMatrix(a);
+  glm::vec3 translation = affineColumn(a, 3);
+  
+  Affine result;
+  for (int row = 0; row < 3; row++)
+  {
+    glm::vec3 inverseRow = normalMatrix[row];
+    result.rows[row][0] = inverseRow.x;
+    result.rows[row][1] = inverseRow.y;
+    result.rows[row][2] = inverseRow.z;
+    result.rows[row][3] = -glm::dot(inverseRow, translation);
+  }
+  
+  return result;
+}
+
+#endif
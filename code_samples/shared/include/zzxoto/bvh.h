@@ -0,0 +1,604 @@
+#ifndef H_ZZXOTO_BVH
+#define H_ZZXOTO_BVH
+
+//Bounding volume hierarchy over object AABBs, for culling and picking.
+//
+//Build splits with the surface area heuristic evaluated on a fixed number of
+//centroid bins per axis (Wald - "On fast Construction of SAH-based Bounding
+//Volume Hierarchies", 2007), so a build is O(n log n) no matter how the
+//objects are spread.
+//
+//Nodes live in one array; the two children of an interior node are adjacent,
+//leaves point at a run of m_objects. When an object moves, Update refits just
+//the path from its leaf to the root. Refits never change the topology, so
+//after a lot of movement a Build gives tighter boxes again.
+
+#include <float.h>
+#include <math.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "zzxoto/frustum_culling.h"
+
+typedef struct Aabb
+{
+  glm::vec3 min;
+  glm::vec3 max;
+} Aabb;
+
+//the empty box: grows into whatever is added, never intersects anything
+Aabb makeEmptyAabb(void)
+{
+  Aabb result;
+  result.min = glm::vec3(FLT_MAX);
+  result.max = glm::vec3(-FLT_MAX);
+  
+  return result;
+}
+
+bool isAabbEmpty(const Aabb &box)
+{
+  return box.min.x > box.max.x || box.min.y > box.max.y || box.min.z > box.max.z;
+}
+
+Aabb makeAabb(const glm::vec3 &min, const glm::vec3 &max)
+{
+  Aabb result;
+  result.min = min;
+  result.max = max;
+  
+  return result;
+}
+
+void growAabb(Aabb *box, const Aabb &other)
+{
+  box->min = glm::min(box->min, other.min);
+  box->max = glm::max(box->max, other.max);
+}
+
+void growAabb(Aabb *box, const glm::vec3 &point)
+{
+  box->min = glm::min(box->min, point);
+  box->max = glm::max(box->max, point);
+}
+
+float aabbSurfaceArea(const Aabb &box)
+{
+  glm::vec3 size = box.max - box.min;
+  if (size.x < 0 || size.y < 0 || size.z < 0)
+  {
+    return 0;
+  }
+  
+  return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+//t of the ray entering the box, or -1 when it misses within [0, maxT].
+//inverseDirection = 1 / direction; an infinite component means the ray is
+//parallel to that slab, which it is inside for every t or for none. Those
+//are tested explicitly: for an origin on the slab's plane the slab test
+//would compute 0 * inf = NaN and miss.
+float intersectRayAabb(const glm::vec3 &origin, const glm::vec3 &inverseDirection, float maxT, const Aabb &box)
+{
+  if (isAabbEmpty(box))
+  {
+    return -1.0f;
+  }
+  
+  float enter = .0f, exit = maxT;
+  for (int axis = 0; axis < 3; axis++)
+  {
+    if (fabsf(inverseDirection[axis]) > FLT_MAX)
+    {
+      if (origin[axis] < box.min[axis] || origin[axis] > box.max[axis])
+      {
+        return -1.0f;
+      }
+      continue;
+    }
+    
+    float t0 = (box.min[axis] - origin[axis]) * inverseDirection[axis];
+    float t1 = (box.max[axis] - origin[axis]) * inverseDirection[axis];
+    enter = glm::max(enter, glm::min(t0, t1));
+    exit = glm::min(exit, glm::max(t0, t1));
+  }
+  
+  return enter <= exit ? enter : -1.0f;
+}
+
+//deeper nodes are forced to be leaves, so traversal stacks have a fixed size
+static const int BVH_MAX_DEPTH = 64;
+
+typedef struct BvhNode
+{
+  Aabb bounds;
+  int first;    //interior: index of the left child, the right one follows. leaf: first entry in m_objects
+  int count;    //objects in the leaf, 0 for interior nodes
+  int parent;   //-1 for the root
+} BvhNode;
+
+typedef struct RayHit
+{
+  int object;   //-1 on a miss
+  float t;
+} RayHit;
+
+//exact test for the objects whose box the ray hits. returns t, or a negative
+//value on a miss
+typedef float (*RayObjectFunc)(int object, const glm::vec3 &origin, const glm::vec3 &direction, void *userData);
+
+class Bvh
+{
+  public:
+  Bvh()
+    :m_maxLeafSize(4)
+  {
+  }
+  
+  void Build(const Aabb *bounds, int objectCount)
+  {
+    m_bounds.assign(bounds, bounds + objectCount);
+    m_objects.resize(objectCount);
+    m_centroids.resize(objectCount);
+    m_objectLeaf.assign(objectCount, -1);
+    for (int i = 0; i < objectCount; i++)
+    {
+      m_objects[i] = i;
+      m_centroids[i] = .5f * (bounds[i].min + bounds[i].max);
+    }
+    
+    m_nodes.clear();
+    m_nodes.reserve(objectCount > 0 ? 2 * objectCount - 1 : 1);
+    
+    BvhNode root;
+    root.first = 0;
+    root.count = objectCount;
+    root.parent = -1;
+    m_nodes.push_back(root);
+    
+    //explicit stack of (node, depth) still to split
+    std::vector<glm::ivec2> pending;
+    pending.push_back(glm::ivec2(0, 0));
+    while (!pending.empty())
+    {
+      glm::ivec2 entry = pending.back();
+      pending.pop_back();
+      
+      int left = Split(entry.x, entry.y + 1 < BVH_MAX_DEPTH);
+      if (left >= 0)
+      {
+        pending.push_back(glm::ivec2(left, entry.y + 1));
+        pending.push_back(glm::ivec2(left + 1, entry.y + 1));
+      }
+    }
+    
+    m_centroids.clear();
+  }
+  
+  //new bounds for every object, topology unchanged
+  void Refit(const Aabb *bounds)
+  {
+    m_bounds.assign(bounds, bounds + m_bounds.size());
+    
+    //children always come after their parent
+    for (int node = NodeCount() - 1; node >= 0; node--)
+    {
+      RecomputeBounds(node);
+    }
+  }
+  
+  //new bounds for one object; refits its leaf and the leaf's ancestors
+  void Update(int object, const Aabb &bounds)
+  {
+    m_bounds[object] = bounds;
+    
+    for (int node = m_objectLeaf[object]; node >= 0; node = m_nodes[node].parent)
+    {
+      RecomputeBounds(node);
+    }
+  }
+  
+  //appends every object whose box is at least partially inside the frustum.
+  //returns the count; `visible` must hold ObjectCount entries
+  int CullFrustum(const FrustumPlanes &planes, unsigned *visible) const
+  {
+    if (m_nodes.empty() || ObjectCount() == 0)
+    {
+      return 0;
+    }
+    
+    //per entry, the planes the node still straddles. a box fully inside a
+    //plane doesn't test it again below, one fully inside all planes takes its
+    //whole subtree without any test
+    typedef struct CullEntry
+    {
+      int node;
+      int planeMask;
+    } CullEntry;
+    
+    CullEntry stack[BVH_MAX_DEPTH + 1];
+    int stackSize = 0;
+    int visibleCount = 0;
+    
+    stack[stackSize].node = 0;
+    stack[stackSize].planeMask = (1 << 6) - 1;
+    stackSize++;
+    
+    while (stackSize > 0)
+    {
+      CullEntry entry = stack[--stackSize];
+      const BvhNode &node = m_nodes[entry.node];
+      
+      int planeMask = entry.planeMask;
+      bool outside = isAabbEmpty(node.bounds);
+      if (planeMask && !outside)
+      {
+        glm::vec3 center = .5f * (node.bounds.min + node.bounds.max);
+        glm::vec3 extent = .5f * (node.bounds.max - node.bounds.min);
+        
+        for (int p = 0; p < 6 && !outside; p++)
+        {
+          if (planeMask & (1 << p))
+          {
+            float distance = planes.a[p] * center.x + planes.b[p] * center.y + planes.c[p] * center.z + planes.d[p];
+            float reach = fabsf(planes.a[p]) * extent.x + fabsf(planes.b[p]) * extent.y + fabsf(planes.c[p]) * extent.z;
+            
+            outside = distance + reach < 0;
+            if (distance - reach > 0)
+            {
+              planeMask &= ~(1 << p);
+            }
+          }
+        }
+      }
+      
+      if (outside)
+      {
+        continue;
+      }
+      
+      if (planeMask == 0)
+      {
+        visibleCount += AppendSubtree(entry.node, visible + visibleCount);
+      }
+      else if (node.count > 0)
+      {
+        //leaf straddling a plane, the objects get their own test
+        for (int i = node.first; i < node.first + node.count; i++)
+        {
+          int object = m_objects[i];
+          if (IsAabbVisible(planes, planeMask, m_bounds[object]))
+          {
+            visible[visibleCount++] = object;
+          }
+        }
+      }
+      else
+      {
+        stack[stackSize].node = node.first;
+        stack[stackSize].planeMask = planeMask;
+        stackSize++;
+        stack[stackSize].node = node.first + 1;
+        stack[stackSize].planeMask = planeMask;
+        stackSize++;
+      }
+    }
+    
+    return visibleCount;
+  }
+  
+  //closest hit along the ray within maxT. without `objectFunc` the object
+  //boxes are the hit surfaces
+  RayHit Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxT = FLT_MAX,
+                 RayObjectFunc objectFunc = NULL, void *userData = NULL) const
+  {
+    RayHit hit;
+    hit.object = -1;
+    hit.t = maxT;
+    
+    if (m_nodes.empty() || ObjectCount() == 0)
+    {
+      return hit;
+    }
+    
+    glm::vec3 inverseDirection = 1.0f / direction;
+    
+    int stack[BVH_MAX_DEPTH + 1];
+    int stackSize = 0;
+    if (intersectRayAabb(origin, inverseDirection, hit.t, m_nodes[0].bounds) >= 0)
+    {
+      stack[stackSize++] = 0;
+    }
+    
+    while (stackSize > 0)
+    {
+      const BvhNode &node = m_nodes[stack[--stackSize]];
+      
+      if (node.count > 0)
+      {
+        for (int i = node.first; i < node.first + node.count; i++)
+        {
+          int object = m_objects[i];
+          float t = intersectRayAabb(origin, inverseDirection, hit.t, m_bounds[object]);
+          if (t >= 0 && objectFunc)
+          {
+            t = objectFunc(object, origin, direction, userData);
+          }
+          if (t >= 0 && t <= hit.t)
+          {
+            hit.object = object;
+            hit.t = t;
+          }
+        }
+        continue;
+      }
+      
+      //push the far child first so the near one is visited first and
+      //shortens hit.t for the other
+      float tLeft = intersectRayAabb(origin, inverseDirection, hit.t, m_nodes[node.first].bounds);
+      float tRight = intersectRayAabb(origin, inverseDirection, hit.t, m_nodes[node.first + 1].bounds);
+      int near = node.first, far = node.first + 1;
+      if (tRight >= 0 && (tLeft < 0 || tRight < tLeft))
+      {
+        near = node.first + 1;
+        far = node.first;
+        float swap = tLeft;
+        tLeft = tRight;
+        tRight = swap;
+      }
+      if (tRight >= 0)
+      {
+        stack[stackSize++] = far;
+      }
+      if (tLeft >= 0)
+      {
+        stack[stackSize++] = near;
+      }
+    }
+    
+    return hit;
+  }
+  
+  int NodeCount() const
+  {
+    return (int) m_nodes.size();
+  }
+  
+  int ObjectCount() const
+  {
+    return (int) m_bounds.size();
+  }
+  
+  const Aabb &Bounds(int object) const
+  {
+    return m_bounds[object];
+  }
+  
+  private:
+  static const int BIN_COUNT = 12;
+  
+  typedef struct Bin
+  {
+    Aabb bounds;
+    int count;
+  } Bin;
+  
+  //splits a node with the best binned SAH split. returns the index of the
+  //new left child, or -1 if the node stays a leaf
+  int Split(int nodeIndex, bool canSplit)
+  {
+    BvhNode node = m_nodes[nodeIndex];
+    
+    node.bounds = makeEmptyAabb();
+    Aabb centroidBounds = makeEmptyAabb();
+    for (int i = node.first; i < node.first + node.count; i++)
+    {
+      growAabb(&node.bounds, m_bounds[m_objects[i]]);
+      growAabb(&centroidBounds, m_centroids[m_objects[i]]);
+    }
+    m_nodes[nodeIndex].bounds = node.bounds;
+    
+    if (node.count <= m_maxLeafSize || !canSplit)
+    {
+      MakeLeaf(nodeIndex);
+      return -1;
+    }
+    
+    //cost of a split relative to intersecting one object; 1 for traversing
+    //the node itself
+    float bestCost = FLT_MAX;
+    int bestAxis = -1;
+    int bestBin = 0;
+    
+    for (int axis = 0; axis < 3; axis++)
+    {
+      float lo = centroidBounds.min[axis];
+      float extent = centroidBounds.max[axis] - lo;
+      if (extent <= 0)
+      {
+        continue;
+      }
+      float binScale = BIN_COUNT / extent;
+      
+      Bin bins[BIN_COUNT];
+      for (int b = 0; b < BIN_COUNT; b++)
+      {
+        bins[b].bounds = makeEmptyAabb();
+        bins[b].count = 0;
+      }
+      
+      for (int i = node.first; i < node.first + node.count; i++)
+      {
+        int object = m_objects[i];
+        int b = glm::min((int) ((m_centroids[object][axis] - lo) * binScale), BIN_COUNT - 1);
+        growAabb(&bins[b].bounds, m_bounds[object]);
+        bins[b].count++;
+      }
+      
+      //sweep from the right for the areas/counts of every right side
+      float rightArea[BIN_COUNT];
+      int rightCount[BIN_COUNT];
+      Aabb right = makeEmptyAabb();
+      int count = 0;
+      for (int b = BIN_COUNT - 1; b > 0; b--)
+      {
+        growAabb(&right, bins[b].bounds);
+        count += bins[b].count;
+        rightArea[b] = aabbSurfaceArea(right);
+        rightCount[b] = count;
+      }
+      
+      Aabb left = makeEmptyAabb();
+      count = 0;
+      for (int b = 0; b < BIN_COUNT - 1; b++)
+      {
+        growAabb(&left, bins[b].bounds);
+        count += bins[b].count;
+        
+        float cost = aabbSurfaceArea(left) * count + rightArea[b + 1] * rightCount[b + 1];
+        if (count > 0 && rightCount[b + 1] > 0 && cost < bestCost)
+        {
+          bestCost = cost;
+          bestAxis = axis;
+          bestBin = b;
+        }
+      }
+    }
+    
+    float parentArea = aabbSurfaceArea(node.bounds);
+    float leafCost = (float) node.count;
+    float splitCost = 1.0f + (parentArea > 0 ? bestCost / parentArea : 0);
+    
+    int mid;
+    if (bestAxis >= 0 && splitCost < leafCost)
+    {
+      float lo = centroidBounds.min[bestAxis];
+      float binScale = BIN_COUNT / (centroidBounds.max[bestAxis] - lo);
+      
+      int *begin = &m_objects[node.first];
+      int *end = begin + node.count;
+      while (begin < end)
+      {
+        int b = glm::min((int) ((m_centroids[*begin][bestAxis] - lo) * binScale), BIN_COUNT - 1);
+        if (b <= bestBin)
+        {
+          begin++;
+        }
+        else
+        {
+          int swap = *begin;
+          *begin = *--end;
+          *end = swap;
+        }
+      }
+      mid = (int) (begin - &m_objects[0]);
+    }
+    else if (bestAxis < 0 && node.count > 2 * m_maxLeafSize)
+    {
+      //all centroids in one spot, no split separates them; halve the run so
+      //leaves stay small
+      mid = node.first + node.count / 2;
+    }
+    else
+    {
+      MakeLeaf(nodeIndex);
+      return -1;
+    }
+    
+    int leftIndex = NodeCount();
+    BvhNode child;
+    child.parent = nodeIndex;
+    child.first = node.first;
+    child.count = mid - node.first;
+    m_nodes.push_back(child);
+    child.first = mid;
+    child.count = node.first + node.count - mid;
+    m_nodes.push_back(child);
+    
+    m_nodes[nodeIndex].first = leftIndex;
+    m_nodes[nodeIndex].count = 0;
+    
+    return leftIndex;
+  }
+  
+  void MakeLeaf(int nodeIndex)
+  {
+    const BvhNode &node = m_nodes[nodeIndex];
+    for (int i = node.first; i < node.first + node.count; i++)
+    {
+      m_objectLeaf[m_objects[i]] = nodeIndex;
+    }
+  }
+  
+  void RecomputeBounds(int nodeIndex)
+  {
+    BvhNode &node = m_nodes[nodeIndex];
+    node.bounds = makeEmptyAabb();
+    
+    if (node.count > 0)
+    {
+      for (int i = node.first; i < node.first + node.count; i++)
+      {
+        growAabb(&node.bounds, m_bounds[m_objects[i]]);
+      }
+    }
+    else
+    {
+      growAabb(&node.bounds, m_nodes[node.first].bounds);
+      growAabb(&node.bounds, m_nodes[node.first + 1].bounds);
+    }
+  }
+  
+  int AppendSubtree(int nodeIndex, unsigned *visible) const
+  {
+    const BvhNode &node = m_nodes[nodeIndex];
+    if (node.count > 0)
+    {
+      //removed objects keep an empty box in their leaf
+      int count = 0;
+      for (int i = node.first; i < node.first + node.count; i++)
+      {
+        visible[count] = m_objects[i];
+        count += !isAabbEmpty(m_bounds[m_objects[i]]);
+      }
+      return count;
+    }
+    
+    int count = AppendSubtree(node.first, visible);
+    return count + AppendSubtree(node.first + 1, visible + count);
+  }
+  
+  static bool IsAabbVisible(const FrustumPlanes &planes, int planeMask, const Aabb &box)
+  {
+    if (isAabbEmpty(box))
+    {
+      return false;
+    }
+    
+    glm::vec3 center = .5f * (box.min + box.max);
+    glm::vec3 extent = .5f * (box.max - box.min);
+    
+    for (int p = 0; p < 6; p++)
+    {
+      if (planeMask & (1 << p))
+      {
+        float distance = planes.a[p] * center.x + planes.b[p] * center.y + planes.c[p] * center.z + planes.d[p];
+        float reach = fabsf(planes.a[p]) * extent.x + fabsf(planes.b[p]) * extent.y + fabsf(planes.c[p]) * extent.z;
+        if (distance + reach < 0)
+        {
+          return false;
+        }
+      }
+    }
+    
+    return true;
+  }
+  
+  std::vector<BvhNode> m_nodes;
+  std::vector<Aabb> m_bounds;         //per object
+  std::vector<int> m_objects;         //object indices, grouped by leaf
+  std::vector<int> m_objectLeaf;      //per object
+  std::vector<glm::vec3> m_centroids; //build only
+  int m_maxLeafSize;
+};
+
+#endif
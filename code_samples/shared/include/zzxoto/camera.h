@@ -0,0 +1,156 @@
+#ifndef H_ZZXOTO_CAMERA
+#define H_ZZXOTO_CAMERA
+
+//Orbit camera of camera_control and cube_camera_diffuse_light: the camera
+//sits on a sphere around cameraTargetPos and always looks at it.
+//cameraSphericalRelPos is (theta, phi, radius), theta around the y axis from
+//+x and phi down from +y, both in degrees (see spherical_coordinate_system.pdf).
+//
+//  glm::mat4 worldToCamera = calcLookAtMatrix(camera);
+//
+//CachedCamera holds a Camera and keeps its view matrix until the camera
+//changes, for a display() that runs every frame while the camera only moves
+//on a key press.
+//
+//No GL dependency.
+
+#include <math.h>
+#include <glm/glm.hpp>
+
+typedef struct Camera
+{
+  glm::vec3 cameraSphericalRelPos;
+  glm::vec3 cameraTargetPos;
+} Camera;
+
+glm::vec3 resolveCameraPosition_sphericalToEuclidean(const Camera &camera)
+{
+  float theta = glm::radians(camera.cameraSphericalRelPos.x);
+  float phi = glm::radians(camera.cameraSphericalRelPos.y);
+  float r = camera.cameraSphericalRelPos.z;
+  
+  float cosTheta = cosf(theta);
+  float sinTheta = sinf(theta);
+  float sinPhi   = sinf(phi);
+  float cosPhi   = cosf(phi);
+  
+  glm::vec3 cameraRelPos_euclidean = glm::vec3(r * sinPhi * cosTheta, r * cosPhi, r * sinPhi * sinTheta);
+  return cameraRelPos_euclidean + camera.cameraTargetPos;
+}
+
+glm::mat4 calcLookAtMatrix(const Camera &camera)
+{
+  const glm::vec3 upPt = glm::vec3(.0f, 1.0f, .0f);
+  const glm::vec3 &lookPt = camera.cameraTargetPos;
+  const glm::vec3 &cameraPt = resolveCameraPosition_sphericalToEuclidean(camera);
+  
+  glm::vec3 lookDir = glm::normalize(lookPt - cameraPt);
+  glm::vec3 upDir = glm::normalize(upPt);
+  
+  glm::vec3 rightDir = glm::normalize(glm::cross(lookDir, upDir));
+  glm::vec3 perpUpDir = glm::cross(rightDir, lookDir);
+  
+  glm::mat4 rotMat(1.0f);
+  rotMat[0] = glm::vec4(rightDir, 0.0f);
+  rotMat[1] = glm::vec4(perpUpDir, 0.0f);
+  rotMat[2] = glm::vec4(-lookDir, 0.0f);
+  
+  rotMat = glm::transpose(rotMat);
+  
+  glm::mat4 transMat(1.0f);
+  transMat[3] = glm::vec4(-cameraPt, 1.0f);
+  
+  return rotMat * transMat;
+}
+
+//Set() bumps Version() whenever the state really changes; ViewMatrix() and
+//InverseViewMatrix() are recomputed on the first call after that. Code that
+//derives more from the view (a light position in camera space, frustum
+//planes) can remember the version it derived at and skip its work the same
+//way. The counters show how often the view was asked for and how often that
+//meant recomputing it.
+class CachedCamera
+{
+  public:
+  CachedCamera()
+    :m_version(1), m_viewVersion(0), m_viewRequests(0), m_viewRecomputes(0)
+  {
+    m_state.cameraSphericalRelPos = glm::vec3(.0f);
+    m_state.cameraTargetPos = glm::vec3(.0f);
+  }
+  
+  const Camera &State() const
+  {
+    return m_state;
+  }
+  
+  void Set(const Camera &state)
+  {
+    if (state.cameraSphericalRelPos != m_state.cameraSphericalRelPos ||
+        state.cameraTargetPos != m_state.cameraTargetPos)
+    {
+      m_state = state;
+      m_version++;
+    }
+  }
+  
+  unsigned Version() const
+  {
+    return m_version;
+  }
+  
+  //world to camera, calcLookAtMatrix(State())
+  const glm::mat4 &ViewMatrix()
+  {
+    update();
+    return m_view;
+  }
+  
+  //camera to world
+  const glm::mat4 &InverseViewMatrix()
+  {
+    update();
+    return m_inverseView;
+  }
+  
+  int ViewRequests() const
+  {
+    return m_viewRequests;
+  }
+  
+  int ViewRecomputes() const
+  {
+    return m_viewRecomputes;
+  }
+  
+  private:
+  void update()
+  {
+    m_viewRequests++;
+    if (m_viewVersion == m_version)
+    {
+      return;
+    }
+    
+    m_view = calcLookAtMatrix(m_state);
+    
+    //the view is a rotation after a translation: the inverse rotates back by
+    //the transpose, then translates to the camera position
+    glm::mat3 rotation = glm::transpose(glm::mat3(m_view));
+    m_inverseView = glm::mat4(rotation);
+    m_inverseView[3] = glm::vec4(rotation * -glm::vec3(m_view[3]), 1.0f);
+    
+    m_viewVersion = m_version;
+    m_viewRecomputes++;
+  }
+  
+  Camera m_state;
+  unsigned m_version;
+  unsigned m_viewVersion;
+  glm::mat4 m_view;
+  glm::mat4 m_inverseView;
+  int m_viewRequests;
+  int m_viewRecomputes;
+};
+
+#endif
@@ -0,0 +1,437 @@
+#ifndef H_ZZXOTO_COMMAND_BUFFER
+#define H_ZZXOTO_COMMAND_BUFFER
+
+//Frame recording split in two stages:
+//1. record: ThreadPool workers traverse the scene, compute matrices and write
+//   commands into their own CommandBuffer. No GL calls are made here.
+//2. replay: the GL thread walks the buffers in worker order and issues GL.
+//
+//Every CommandBuffer writes into a LinearArena that is reset at the start of
+//the frame, so recording does not touch the heap once the arena is sized. A
+//buffer that overflows its arena is never replayed with commands missing:
+//FrameRecorder grows it and records that slice again.
+//
+//Uniform commands of a program with a ProgramReflection go through its shadow
+//copy on replay, so a value that didn't change since the last upload (the
+//same light every frame, the same color for every cube) costs no GL call.
+//
+//NOTE: expects GL/glew.h to be included before this file.
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "zzxoto/program_reflection.h"
+#include "zzxoto/thread_pool.h"
+
+class LinearArena
+{
+  public:
+  LinearArena(size_t capacity)
+    :m_base((char *) malloc(capacity)), m_capacity(capacity), m_used(0), m_required(0), m_overflowed(false),
+     m_growCount(0)
+  {
+  }
+  
+  ~LinearArena()
+  {
+    free(m_base);
+  }
+  
+  //returns NULL when the arena is exhausted, and for every allocation after
+  //that until Reset, which grows the arena to fit the whole frame
+  void *Alloc(size_t size, size_t align = 16)
+  {
+    size_t offset = (m_used + (align - 1)) & ~(align - 1);
+    if (m_overflowed || offset + size > m_capacity)
+    {
+      m_overflowed = true;
+      m_required += size + align;
+      return NULL;
+    }
+    
+    m_used = offset + size;
+    return m_base + offset;
+  }
+  
+  void Reset()
+  {
+    //growing happens here, between frames, never while recording
+    if (m_overflowed)
+    {
+      free(m_base);
+      while (m_capacity < m_used + m_required)
+      {
+        m_capacity *= 2;
+      }
+      m_base = (char *) malloc(m_capacity);
+      m_overflowed = false;
+      m_required = 0;
+      m_growCount++;
+    }
+    m_used = 0;
+  }
+  
+  char *Base() const
+  {
+    return m_base;
+  }
+  
+  size_t Used() const
+  {
+    return m_used;
+  }
+  
+  bool Overflowed() const
+  {
+    return m_overflowed;
+  }
+  
+  //times Reset had to grow the arena
+  int GrowCount() const
+  {
+    return m_growCount;
+  }
+  
+  private:
+  LinearArena(const LinearArena &);
+  LinearArena &operator=(const LinearArena &);
+  
+  char *m_base;
+  size_t m_capacity;
+  size_t m_used;
+  size_t m_required;
+  bool m_overflowed;
+  int m_growCount;
+};
+
+typedef enum CommandType
+{
+  cmd_useProgram = 1,
+  cmd_bindVertexArray,
+  cmd_depthMask,
+  cmd_uniform3f,
+  cmd_uniformMatrix3,
+  cmd_uniformMatrix4,
+  cmd_drawElements
+} CommandType;
+
+//every command starts with this header; `size` includes the header and is a
+//multiple of 16 so the next command stays aligned for mat4 payloads
+typedef struct CommandHeader
+{
+  unsigned short type;
+  unsigned short size;
+  GLint location;
+  GLuint object;
+  GLuint param;
+} CommandHeader;
+
+class CommandBuffer
+{
+  public:
+  CommandBuffer(size_t capacity)
+    :m_arena(capacity), m_commandCount(0)
+  {
+  }
+  
+  void Reset()
+  {
+    m_arena.Reset();
+    m_commandCount = 0;
+  }
+  
+  void UseProgram(GLuint program)
+  {
+    Push(cmd_useProgram, 0, -1, program, 0);
+  }
+  
+  void BindVertexArray(GLuint vao)
+  {
+    Push(cmd_bindVertexArray, 0, -1, vao, 0);
+  }
+  
+  void DepthMask(GLboolean flag)
+  {
+    Push(cmd_depthMask, 0, -1, 0, flag);
+  }
+  
+  void Uniform3f(GLint location, const glm::vec3 &value)
+  {
+    Write(Push(cmd_uniform3f, sizeof(glm::vec3), location, 0, 0), glm::value_ptr(value), sizeof(glm::vec3));
+  }
+  
+  void UniformMatrix3(GLint location, const glm::mat3 &value)
+  {
+    Write(Push(cmd_uniformMatrix3, sizeof(glm::mat3), location, 0, 0), glm::value_ptr(value), sizeof(glm::mat3));
+  }
+  
+  void UniformMatrix4(GLint location, const glm::mat4 &value)
+  {
+    Write(Push(cmd_uniformMatrix4, sizeof(glm::mat4), location, 0, 0), glm::value_ptr(value), sizeof(glm::mat4));
+  }
+  
+  void DrawElements(GLuint indexCount, GLenum indexType)
+  {
+    Push(cmd_drawElements, 0, -1, indexType, indexCount);
+  }
+  
+  int CommandCount() const
+  {
+    return m_commandCount;
+  }
+  
+  size_t BytesUsed() const
+  {
+    return m_arena.Used();
+  }
+  
+  //true when commands were dropped since the last Reset
+  bool Overflowed() const
+  {
+    return m_arena.Overflowed();
+  }
+  
+  const LinearArena &Arena() const
+  {
+    return m_arena;
+  }
+  
+  //GL thread only; an overflowed buffer replays nothing rather than a frame
+  //with commands missing
+  void Replay() const
+  {
+    if (Overflowed())
+    {
+      return;
+    }
+    
+    GLuint currentProgram = 0, currentVAO = 0;
+    ProgramReflection *reflection = NULL;
+    const char *at = m_arena.Base();
+    const char *end = at + m_arena.Used();
+    
+    while (at < end)
+    {
+      const CommandHeader *cmd = (const CommandHeader *) at;
+      const GLfloat *payload = (const GLfloat *) (cmd + 1);
+      
+      switch(cmd->type)
+      {
+        case cmd_useProgram:
+        {
+          if (cmd->object != currentProgram)
+          {
+            glUseProgram(cmd->object);
+            currentProgram = cmd->object;
+            reflection = findProgramReflection(currentProgram);
+          }
+          break;
+        }
+        case cmd_bindVertexArray:
+        {
+          if (cmd->object != currentVAO)
+          {
+            glBindVertexArray(cmd->object);
+            currentVAO = cmd->object;
+          }
+          break;
+        }
+        case cmd_depthMask:
+        {
+          glDepthMask((GLboolean) cmd->param);
+          break;
+        }
+        case cmd_uniform3f:
+        {
+          if (reflection)
+          {
+            reflection->Set(reflection->UniformAtLocation(cmd->location), *(const glm::vec3 *) payload);
+          }
+          else
+          {
+            glUniform3fv(cmd->location, 1, payload);
+          }
+          break;
+        }
+        case cmd_uniformMatrix3:
+        {
+          if (reflection)
+          {
+            reflection->Set(reflection->UniformAtLocation(cmd->location), *(const glm::mat3 *) payload);
+          }
+          else
+          {
+            glUniformMatrix3fv(cmd->location, 1, GL_FALSE, payload);
+          }
+          break;
+        }
+        case cmd_uniformMatrix4:
+        {
+          if (reflection)
+          {
+            reflection->Set(reflection->UniformAtLocation(cmd->location), *(const glm::mat4 *) payload);
+          }
+          else
+          {
+            glUniformMatrix4fv(cmd->location, 1, GL_FALSE, payload);
+          }
+          break;
+        }
+        case cmd_drawElements:
+        {
+          glDrawElements(GL_TRIANGLES, cmd->param, cmd->object, 0);
+          break;
+        }
+      }
+      
+      at += cmd->size;
+    }
+    
+    glUseProgram(0);
+    glBindVertexArray(0);
+  }
+  
+  private:
+  char *Push(CommandType type, size_t payloadSize, GLint location, GLuint object, GLuint param)
+  {
+    size_t size = (sizeof(CommandHeader) + payloadSize + 15) & ~(size_t) 15;
+    CommandHeader *cmd = (CommandHeader *) m_arena.Alloc(size, 16);
+    if (cmd == NULL)
+    {
+      return NULL;
+    }
+    
+    cmd->type = (unsigned short) type;
+    cmd->size = (unsigned short) size;
+    cmd->location = location;
+    cmd->object = object;
+    cmd->param = param;
+    m_commandCount++;
+    
+    return (char *) (cmd + 1);
+  }
+  
+  void Write(char *payload, const void *src, size_t size)
+  {
+    if (payload)
+    {
+      memcpy(payload, src, size);
+    }
+  }
+  
+  LinearArena m_arena;
+  int m_commandCount;
+};
+
+//worker callback: records the `workerIndex`-th slice of the scene out of
+//`workerCount` slices into `commands`
+typedef void (*RecordFunc)(int workerIndex, int workerCount, CommandBuffer &commands, void *userData);
+
+class FrameRecorder
+{
+  public:
+  //one command buffer per pool thread
+  FrameRecorder(ThreadPool &pool, size_t commandBufferCapacity = 1 << 20)
+    :m_pool(pool), m_activeCount(1)
+  {
+    for (int i = 0; i < pool.ThreadCount(); i++)
+    {
+      m_buffers.push_back(new CommandBuffer(commandBufferCapacity));
+    }
+  }
+  
+  ~FrameRecorder()
+  {
+    for (size_t i = 0; i < m_buffers.size(); i++)
+    {
+      delete m_buffers[i];
+    }
+  }
+  
+  int ThreadCount() const
+  {
+    return (int) m_buffers.size();
+  }
+  
+  //records a frame with `activeCount` slices (0 means all threads) and blocks
+  //until every slice is done
+  void Record(RecordFunc record, void *userData, int activeCount = 0)
+  {
+    if (activeCount <= 0 || activeCount > ThreadCount())
+    {
+      activeCount = ThreadCount();
+    }
+    
+    for (int i = 0; i < ThreadCount(); i++)
+    {
+      m_buffers[i]->Reset();
+    }
+    
+    RecordTask task;
+    task.recorder = this;
+    task.record = record;
+    task.userData = userData;
+    
+    m_activeCount = activeCount;
+    m_pool.Run(RecordSlice, &task, activeCount);
+    
+    //Reset grows an overflowed arena to fit everything the slice asked for,
+    //so the second recording is complete
+    for (int i = 0; i < activeCount; i++)
+    {
+      if (m_buffers[i]->Overflowed())
+      {
+        m_buffers[i]->Reset();
+        record(i, activeCount, *m_buffers[i], userData);
+      }
+    }
+  }
+  
+  //GL thread only; replays slices in order so slice 0 draws first
+  void Replay() const
+  {
+    for (int i = 0; i < m_activeCount; i++)
+    {
+      m_buffers[i]->Replay();
+    }
+  }
+  
+  const CommandBuffer &Buffer(int index) const
+  {
+    return *m_buffers[index];
+  }
+  
+  //arena growths of all buffers so far; each one was a re-recorded slice
+  int ArenaGrowCount() const
+  {
+    int count = 0;
+    for (size_t i = 0; i < m_buffers.size(); i++)
+    {
+      count += m_buffers[i]->Arena().GrowCount();
+    }
+    
+    return count;
+  }
+  
+  private:
+  typedef struct RecordTask
+  {
+    FrameRecorder *recorder;
+    RecordFunc record;
+    void *userData;
+  } RecordTask;
+  
+  static void RecordSlice(int taskIndex, int taskCount, void *userData)
+  {
+    RecordTask *task = (RecordTask *) userData;
+    task->record(taskIndex, taskCount, *task->recorder->m_buffers[taskIndex], task->userData);
+  }
+  
+  ThreadPool &m_pool;
+  std::vector<CommandBuffer *> m_buffers;
+  int m_activeCount;
+};
+
+#endif
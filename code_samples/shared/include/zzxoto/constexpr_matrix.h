@@ -0,0 +1,197 @@
+#ifndef H_ZZXOTO_CONSTEXPR_MATRIX
+#define H_ZZXOTO_CONSTEXPR_MATRIX
+
+//Matrix builders that run at compile time, so a projection or model transform
+//made of constants is a constant itself:
+//
+//  global ZZXOTO_CONSTEXPR_VALUE ConstMat4 CAMERA_TO_CLIP = constPerspective(45.0f, ZNEAR, ZFAR);
+//  glUniformMatrix4fv(location, 1, GL_FALSE, CAMERA_TO_CLIP.m);
+//
+//ConstMat4 is 16 column major floats like glm::value_ptr(glm::mat4), since
+//glm's matrices can't be built in a constant expression; toMat4() converts.
+//The builders are ordinary functions too, e.g. for a pixel matrix out of the
+//window size in reshape().
+//
+//constexpr needs Visual Studio 2015 (or any C++11 compiler); on older MSVC
+//ZZXOTO_CONSTEXPR falls back to inline, the values are computed at startup
+//and the static_assert checks at the bottom are skipped.
+//
+//No GL dependency.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define ZZXOTO_CONSTEXPR inline
+#define ZZXOTO_CONSTEXPR_VALUE const
+#else
+#define ZZXOTO_HAS_CONSTEXPR
+#define ZZXOTO_CONSTEXPR constexpr
+#define ZZXOTO_CONSTEXPR_VALUE constexpr
+#endif
+
+typedef struct ConstMat4
+{
+  float m[16];   //column major
+} ConstMat4;
+
+//sin and cos by their Taylor series, plenty for |x| <= PI in double
+ZZXOTO_CONSTEXPR double constSinSeries(double x2, double term, int k)
+{
+  return k > 12 ? term : term + constSinSeries(x2, -term * x2 / ((2 * k) * (2 * k + 1)), k + 1);
+}
+
+ZZXOTO_CONSTEXPR double constCosSeries(double x2, double term, int k)
+{
+  return k > 12 ? term : term + constCosSeries(x2, -term * x2 / ((2 * k - 1) * (2 * k)), k + 1);
+}
+
+ZZXOTO_CONSTEXPR double constTan(double radians)
+{
+  return constSinSeries(radians * radians, radians, 1) / constCosSeries(radians * radians, 1.0, 1);
+}
+
+ZZXOTO_CONSTEXPR ConstMat4 constIdentity(void)
+{
+  return ConstMat4
+  {{
+    1, 0, 0, 0,
+    0, 1, 0, 0,
+    0, 0, 1, 0,
+    0, 0, 0, 1
+  }};
+}
+
+ZZXOTO_CONSTEXPR ConstMat4 constTranslate(float tx, float ty, float tz)
+{
+  return ConstMat4
+  {{
+    1, 0, 0, 0,
+    0, 1, 0, 0,
+    0, 0, 1, 0,
+    tx, ty, tz, 1
+  }};
+}
+
+ZZXOTO_CONSTEXPR ConstMat4 constScale(float sx, float sy, float sz)
+{
+  return ConstMat4
+  {{
+    sx, 0, 0, 0,
+    0, sy, 0, 0,
+    0, 0, sz, 0,
+    0, 0, 0, 1
+  }};
+}
+
+//The view box (l, b, n) to (r, t, f) to the 2x2x2 cube, see
+//camera_space_to_clip_space_orthographic_transform.pdf: n and f are camera
+//space z, n goes to 1 and f to -1. With l = 0, r = w, b = h, t = 0, n = 1,
+//f = -1 it is the pixel matrix: top left origin, y down, z untouched.
+ZZXOTO_CONSTEXPR ConstMat4 constOrthographic(float l, float r, float b, float t, float n, float f)
+{
+  return ConstMat4
+  {{
+    2 / (r - l), 0, 0, 0,
+    0, 2 / (t - b), 0, 0,
+    0, 0, 2 / (n - f), 0,
+    -(r + l) / (r - l), -(t + b) / (t - b), -(n + f) / (n - f), 1
+  }};
+}
+
+//Same matrix as MatrixStackBase::Perspective: fov is the angle from the view
+//direction to the top of the view in degrees, N and F the distances to the
+//near and far planes. Depth is reversed, z = -N goes to 1 and z = -F to -1.
+ZZXOTO_CONSTEXPR ConstMat4 constPerspective(float fov, float N, float F)
+{
+  return ConstMat4
+  {{
+    (float) (1 / constTan(fov * (3.14159265358979 / 180))), 0, 0, 0,
+    0, (float) (1 / constTan(fov * (3.14159265358979 / 180))), 0, 0,
+    0, 0, (F + N) / (F - N), -1,
+    0, 0, (2 * N * F) / (F - N), 0
+  }};
+}
+
+//element i (column i / 4, row i % 4) of a * b
+ZZXOTO_CONSTEXPR float constMultiplyElement(const ConstMat4 &a, const ConstMat4 &b, int i)
+{
+  return a.m[i % 4] * b.m[i / 4 * 4] + a.m[4 + i % 4] * b.m[i / 4 * 4 + 1] +
+         a.m[8 + i % 4] * b.m[i / 4 * 4 + 2] + a.m[12 + i % 4] * b.m[i / 4 * 4 + 3];
+}
+
+//a * b: apply b first, then a
+ZZXOTO_CONSTEXPR ConstMat4 constMultiply(const ConstMat4 &a, const ConstMat4 &b)
+{
+  return ConstMat4
+  {{
+    constMultiplyElement(a, b, 0), constMultiplyElement(a, b, 1), constMultiplyElement(a, b, 2),
+    constMultiplyElement(a, b, 3), constMultiplyElement(a, b, 4), constMultiplyElement(a, b, 5),
+    constMultiplyElement(a, b, 6), constMultiplyElement(a, b, 7), constMultiplyElement(a, b, 8),
+    constMultiplyElement(a, b, 9), constMultiplyElement(a, b, 10), constMultiplyElement(a, b, 11),
+    constMultiplyElement(a, b, 12), constMultiplyElement(a, b, 13), constMultiplyElement(a, b, 14),
+    constMultiplyElement(a, b, 15)
+  }};
+}
+
+glm::mat4 toMat4(const ConstMat4 &matrix)
+{
+  return glm::make_mat4(matrix.m);
+}
+
+#ifdef ZZXOTO_HAS_CONSTEXPR
+
+//Compile time checks against matrices worked out by hand; a wrong builder
+//fails the build of every sample that includes this file.
+
+ZZXOTO_CONSTEXPR bool constNear(float a, float b)
+{
+  return (a - b < 0 ? b - a : a - b) <= 1e-6f * (1 + (a < 0 ? -a : a));
+}
+
+ZZXOTO_CONSTEXPR bool constEqual(const ConstMat4 &a, const ConstMat4 &b, int i = 0)
+{
+  return i == 16 || (constNear(a.m[i], b.m[i]) && constEqual(a, b, i + 1));
+}
+
+//z / w in clip space of the camera space point (0, 0, z)
+ZZXOTO_CONSTEXPR float constDepth(const ConstMat4 &m, float z)
+{
+  return (m.m[10] * z + m.m[14]) / (m.m[11] * z + m.m[15]);
+}
+
+static_assert(constEqual(constMultiply(constTranslate(1, 2, 3), constScale(2, 2, 2)),
+                         ConstMat4{{2, 0, 0, 0, 0, 2, 0, 0, 0, 0, 2, 0, 1, 2, 3, 1}}),
+              "translate * scale scales first, then translates");
+static_assert(constEqual(constMultiply(constScale(2, 2, 2), constTranslate(1, 2, 3)),
+                         ConstMat4{{2, 0, 0, 0, 0, 2, 0, 0, 0, 0, 2, 0, 2, 4, 6, 1}}),
+              "scale * translate scales the translation too");
+static_assert(constEqual(constMultiply(constIdentity(), constTranslate(4, 5, 6)), constTranslate(4, 5, 6)),
+              "identity");
+
+//view box (-2, -1, -1) to (2, 1, -5): x / 2, y / 1, z: -1 -> 1, -5 -> -1
+static_assert(constEqual(constOrthographic(-2, 2, -1, 1, -1, -5),
+                         ConstMat4{{.5f, 0, 0, 0, 0, 1, 0, 0, 0, 0, .5f, 0, 0, 0, 1.5f, 1}}),
+              "orthographic view box");
+
+//the pixel matrix of a 600x600 window, as chess and font_rendering built it:
+//translate(-1, 1, 0) * scale(2 / 600, -2 / 600, 1)
+static_assert(constEqual(constOrthographic(0, 600, 600, 0, 1, -1),
+                         ConstMat4{{2.0f / 600, 0, 0, 0, 0, -2.0f / 600, 0, 0, 0, 0, 1, 0, -1, 1, 0, 1}}),
+              "pixel matrix");
+static_assert(constEqual(constOrthographic(0, 600, 600, 0, 1, -1),
+                         constMultiply(constTranslate(-1, 1, 0), constScale(2.0f / 600, -2.0f / 600, 1))),
+              "pixel matrix from translate and scale");
+
+//45 degrees: tan is 1. Near .1, far 100: (100.1 / 99.9) and 20 / 99.9
+static_assert(constNear((float) constTan(3.14159265358979 / 4), 1), "tan(PI / 4)");
+static_assert(constEqual(constPerspective(45, .1f, 100),
+                         ConstMat4{{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 100.1f / 99.9f, -1, 0, 0, 20 / 99.9f, 0}}),
+              "perspective");
+static_assert(constNear(constDepth(constPerspective(45, .1f, 100), -.1f), 1) &&
+              constNear(constDepth(constPerspective(45, .1f, 100), -100), -1),
+              "perspective maps near to 1 and far to -1");
+
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef H_ZZXOTO_FAST_TRIG
+#define H_ZZXOTO_FAST_TRIG
+
+//Sine and cosine together, 4 angles per SSE register:
+//
+//  sincosSse(angles, &s, &c, SINCOS_PRECISE);           //__m128 in and out
+//  sincosBatch(angles, count, sines, cosines, SINCOS_FAST);
+//
+//Both come out of one range reduction: x is brought into [-PI/4, PI/4] by a
+//multiple j of PI/2, then one polynomial makes the sine and one the cosine of
+//the reduced angle, and j's low bits swap them and pick the signs (Cephes'
+//sinf/cosf, as in sse_mathfun). The accuracies:
+//
+//  SINCOS_PRECISE  Cephes coefficients, PI/4 in three parts: 1e-7 absolute,
+//                  1.5 ulp for |x| <= PI (more ulp, not more absolute
+//                  error, next to the zeros of larger angles)
+//  SINCOS_FAST     Taylor polynomials one term shorter, PI/4 in two parts:
+//                  4e-5 absolute, plenty for positions and rotations on
+//                  screen
+//
+//Both hold to |x| ~ 8000, beyond that use libm. About 5x faster than sinf
+//plus cosf over arrays, see the trig section of cpu_benchmark; for one or two
+//angles the polynomial's latency makes it no faster than sinf/cosf, so single
+//rotations (MatrixStackBase::Rotate) stay on those.
+//
+//No GL dependency.
+
+#include <emmintrin.h>
+
+enum SincosAccuracy
+{
+  SINCOS_PRECISE,
+  SINCOS_FAST
+};
+
+void sincosSse(__m128 x, __m128 *s, __m128 *c, SincosAccuracy accuracy = SINCOS_PRECISE)
+{
+  __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+  __m128 sinSign = _mm_and_ps(x, signMask);
+  x = _mm_andnot_ps(signMask, x);
+  
+  //j = nearest even integer to x / (PI / 4), i.e. a multiple of PI / 2
+  __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+  j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+  __m128 y = _mm_cvtepi32_ps(j);
+  
+  //bit 2 of j flips the sine, bit 1 swaps sine and cosine, bit 2 of j - 2 flips the cosine
+  __m128 swapSinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29));
+  __m128 usesSinPolynomial = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)),
+                                                              _mm_setzero_si128()));
+  __m128i cosJ = _mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4));
+  __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(cosJ, 29));
+  sinSign = _mm_xor_ps(sinSign, swapSinSign);
+  
+  //x - j * PI / 4, with PI / 4 split so the first products are exact
+  __m128 z, sinPolynomial, cosPolynomial;
+  if (accuracy == SINCOS_PRECISE)
+  {
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(.78515625f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(2.4187564849853515625e-4f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(3.77489497744594108e-8f)));
+    z = _mm_mul_ps(x, x);
+    
+    cosPolynomial = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), z), _mm_set1_ps(-1.388731625493765e-3f));
+    cosPolynomial = _mm_add_ps(_mm_mul_ps(cosPolynomial, z), _mm_set1_ps(4.166664568298827e-2f));
+    sinPolynomial = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), z), _mm_set1_ps(8.3321608736e-3f));
+    sinPolynomial = _mm_add_ps(_mm_mul_ps(sinPolynomial, z), _mm_set1_ps(-1.6666654611e-1f));
+  }
+  else
+  {
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(.78515625f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(2.4191339e-4f)));
+    z = _mm_mul_ps(x, x);
+    
+    cosPolynomial = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.0f / 720), z), _mm_set1_ps(1.0f / 24));
+    sinPolynomial = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(1.0f / 120), z), _mm_set1_ps(-1.0f / 6));
+  }
+  
+  //cos = 1 - z / 2 + z^2 * p(z), sin = x + x * z * q(z)
+  __m128 cosine = _mm_mul_ps(_mm_mul_ps(cosPolynomial, z), z);
+  cosine = _mm_add_ps(_mm_sub_ps(cosine, _mm_mul_ps(z, _mm_set1_ps(.5f))), _mm_set1_ps(1.0f));
+  __m128 sine = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPolynomial, z), x), x);
+  
+  __m128 sinResult = _mm_or_ps(_mm_and_ps(usesSinPolynomial, sine), _mm_andnot_ps(usesSinPolynomial, cosine));
+  __m128 cosResult = _mm_or_ps(_mm_and_ps(usesSinPolynomial, cosine), _mm_andnot_ps(usesSinPolynomial, sine));
+  *s = _mm_xor_ps(sinResult, sinSign);
+  *c = _mm_xor_ps(cosResult, cosSign);
+}
+
+//s[i], c[i] = sin(x[i]), cos(x[i]); s and c may alias x
+void sincosBatch(const float *x, int count, float *s, float *c, SincosAccuracy accuracy = SINCOS_PRECISE)
+{
+  int i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 sine, cosine;
+    sincosSse(_mm_loadu_ps(x + i), &sine, &cosine, accuracy);
+    _mm_storeu_ps(s + i, sine);
+    _mm_storeu_ps(c + i, cosine);
+  }
+  
+  if (i < count)
+  {
+    //the last 1-3 angles go in one register, zero padded, and only the
+    //count - i results are copied out of the stack arrays
+    __m128 tail = _mm_setr_ps(x[i], i + 1 < count ? x[i + 1] : 0, i + 2 < count ? x[i + 2] : 0, 0);
+    float sines[4], cosines[4];
+    __m128 sine, cosine;
+    sincosSse(tail, &sine, &cosine, accuracy);
+    _mm_storeu_ps(sines, sine);
+    _mm_storeu_ps(cosines, cosine);
+    for (int k = 0; i + k < count; k++)
+    {
+      s[i + k] = sines[k];
+      c[i + k] = cosines[k];
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef H_ZZXOTO_FRAME_BENCHMARK
+#define H_ZZXOTO_FRAME_BENCHMARK
+
+//Frame time benchmark: runs a fixed number of frames and times the update,
+//display and swap phase of each with the monotonic clock. At the end it
+//prints p50/p95/p99/max per phase and for the whole frame, plus throughput,
+//and writes the same numbers as JSON so runs can be diffed across commits.
+//
+//  g_benchmark.Start("chess", 1000, "build/chess_benchmark.json");
+//  ...
+//  g_benchmark.BeginFrame();
+//  update();
+//  g_benchmark.EndPhase(phase_update);
+//  draw();
+//  g_benchmark.EndPhase(phase_display);
+//  glutSwapBuffers();
+//  g_benchmark.EndPhase(phase_swap);
+//  if (g_benchmark.EndFrame()) -> done, report written
+//
+//Every call is a no-op until Start, so the calls can stay in the regular
+//loop. Frames should run uncapped while benchmarking; with vsync on, the swap
+//phase is the wait for the display.
+//
+//No GL dependency.
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+typedef enum FramePhase
+{
+  phase_update,
+  phase_display,
+  phase_swap,
+  FRAME_PHASE_COUNT
+} FramePhase;
+
+static const char *FRAME_PHASE_NAMES[FRAME_PHASE_COUNT] = {"update", "display", "swap"};
+
+typedef struct FrameTimeStats
+{
+  double p50, p95, p99, max, mean;
+} FrameTimeStats;
+
+//nearest rank percentiles
+FrameTimeStats calcFrameTimeStats(std::vector<double> samples)
+{
+  FrameTimeStats stats = {0, 0, 0, 0, 0};
+  if (samples.empty())
+  {
+    return stats;
+  }
+  
+  std::sort(samples.begin(), samples.end());
+  size_t n = samples.size();
+  stats.p50 = samples[(n - 1) * 50 / 100];
+  stats.p95 = samples[(n - 1) * 95 / 100];
+  stats.p99 = samples[(n - 1) * 99 / 100];
+  stats.max = samples[n - 1];
+  for (size_t i = 0; i < n; i++)
+  {
+    stats.mean += samples[i];
+  }
+  stats.mean /= n;
+  
+  return stats;
+}
+
+class FrameBenchmark
+{
+  public:
+  FrameBenchmark()
+    :m_frameCount(0), m_inFrame(false)
+  {
+  }
+  
+  //jsonPath may be NULL
+  void Start(const char *label, int frameCount, const char *jsonPath)
+  {
+    m_label = label;
+    m_jsonPath = jsonPath ? jsonPath : "";
+    m_frameCount = frameCount;
+    m_inFrame = false;
+    for (int p = 0; p < FRAME_PHASE_COUNT; p++)
+    {
+      m_phaseMs[p].clear();
+      m_phaseMs[p].reserve(frameCount);
+    }
+    m_frameMs.clear();
+    m_frameMs.reserve(frameCount);
+  }
+  
+  bool Active() const
+  {
+    return m_frameCount > 0;
+  }
+  
+  void BeginFrame()
+  {
+    if (!Active())
+    {
+      return;
+    }
+    
+    if (m_frameMs.empty())
+    {
+      m_startTime = Clock::now();
+    }
+    m_frameStart = m_phaseStart = Clock::now();
+    for (int p = 0; p < FRAME_PHASE_COUNT; p++)
+    {
+      m_currentMs[p] = 0;
+    }
+    m_inFrame = true;
+  }
+  
+  //time since the previous EndPhase (or BeginFrame) goes to `phase`. Ignored
+  //outside BeginFrame/EndFrame, e.g. for a redraw GLUT asks for
+  void EndPhase(FramePhase phase)
+  {
+    if (!m_inFrame)
+    {
+      return;
+    }
+    
+    Clock::time_point now = Clock::now();
+    m_currentMs[phase] += std::chrono::duration<double, std::milli>(now - m_phaseStart).count();
+    m_phaseStart = now;
+  }
+  
+  //true once the last frame is in; the report has been printed and written
+  bool EndFrame()
+  {
+    if (!m_inFrame)
+    {
+      return false;
+    }
+    m_inFrame = false;
+    
+    Clock::time_point now = Clock::now();
+    m_frameMs.push_back(std::chrono::duration<double, std::milli>(now - m_frameStart).count());
+    for (int p = 0; p < FRAME_PHASE_COUNT; p++)
+    {
+      m_phaseMs[p].push_back(m_currentMs[p]);
+    }
+    
+    if ((int) m_frameMs.size() < m_frameCount)
+    {
+      return false;
+    }
+    
+    double wallMs = std::chrono::duration<double, std::milli>(now - m_startTime).count();
+    Report(wallMs);
+    m_frameCount = 0;
+    
+    return true;
+  }
+  
+  private:
+  typedef std::chrono::steady_clock Clock;
+  
+  void Report(double wallMs)
+  {
+    int frames = (int) m_frameMs.size();
+    double fps = frames * 1000.0 / wallMs;
+    
+    FrameTimeStats frame = calcFrameTimeStats(m_frameMs);
+    FrameTimeStats phases[FRAME_PHASE_COUNT];
+    for (int p = 0; p < FRAME_PHASE_COUNT; p++)
+    {
+      phases[p] = calcFrameTimeStats(m_phaseMs[p]);
+    }
+    
+    printf("%s benchmark: %d frames in %.1f ms, %.1f frames/s\n", m_label.c_str(), frames, wallMs, fps);
+    printf("  %-8s %9s %9s %9s %9s %9s\n", "ms", "p50", "p95", "p99", "max", "mean");
+    for (int p = 0; p < FRAME_PHASE_COUNT; p++)
+    {
+      PrintRow(FRAME_PHASE_NAMES[p], phases[p]);
+    }
+    PrintRow("frame", frame);
+    
+    if (m_jsonPath.empty())
+    {
+      return;
+    }
+    
+    FILE *fp = fopen(m_jsonPath.c_str(), "w");
+    if (fp == NULL)
+    {
+      printf("could not write %s\n", m_jsonPath.c_str());
+      return;
+    }
+    fprintf(fp, "{\n  \"label\": \"%s\",\n  \"frames\": %d,\n  \"wallMs\": %.4f,\n  \"framesPerSecond\": %.3f,\n",
+            m_label.c_str(), frames, wallMs, fps);
+    for (int p = 0; p < FRAME_PHASE_COUNT; p++)
+    {
+      WriteJsonStats(fp, FRAME_PHASE_NAMES[p], phases[p], false);
+    }
+    WriteJsonStats(fp, "frame", frame, true);
+    fprintf(fp, "}\n");
+    fclose(fp);
+    printf("  written to %s\n", m_jsonPath.c_str());
+  }
+  
+  static void PrintRow(const char *name, const FrameTimeStats &s)
+  {
+    printf("  %-8s %9.3f %9.3f %9.3f %9.3f %9.3f\n", name, s.p50, s.p95, s.p99, s.max, s.mean);
+  }
+  
+  static void WriteJsonStats(FILE *fp, const char *name, const FrameTimeStats &s, bool last)
+  {
+    fprintf(fp, "  \"%s\": {\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f, \"mean\": %.4f}%s\n",
+            name, s.p50, s.p95, s.p99, s.max, s.mean, last ? "" : ",");
+  }
+  
+  std::string m_label;
+  std::string m_jsonPath;
+  int m_frameCount;
+  bool m_inFrame;
+  Clock::time_point m_startTime;
+  Clock::time_point m_frameStart;
+  Clock::time_point m_phaseStart;
+  double m_currentMs[FRAME_PHASE_COUNT];
+  std::vector<double> m_phaseMs[FRAME_PHASE_COUNT];
+  std::vector<double> m_frameMs;
+};
+
+#endif
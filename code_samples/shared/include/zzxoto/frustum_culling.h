@@ -0,0 +1,273 @@
+#ifndef H_ZZXOTO_FRUSTUM_CULLING
+#define H_ZZXOTO_FRUSTUM_CULLING
+
+//View frustum culling of bounding spheres and AABBs kept in SoA arrays.
+//
+//The six planes come straight out of the world to clip matrix (Gribb &
+//Hartmann): a point is inside when -w <= x, y, z <= w in clip space, and every
+//one of those inequalities is a plane in world space. This holds for the
+//reversed depth of the samples as well, near just maps to +w instead of -w.
+//
+//Bounds are tested 8 at a time with AVX when the compiler targets it
+//(/arch:AVX, -mavx), 4 at a time with SSE otherwise. The output is the
+//compact list of visible indices.
+
+#include <math.h>
+#include <glm/glm.hpp>
+#include <xmmintrin.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+typedef struct FrustumPlanes
+{
+  //plane i: a[i] * x + b[i] * y + c[i] * z + d[i] >= 0 inside, normalized
+  float a[6];
+  float b[6];
+  float c[6];
+  float d[6];
+} FrustumPlanes;
+
+FrustumPlanes extractFrustumPlanes(const glm::mat4 &worldToClipMatrix)
+{
+  const glm::mat4 &m = worldToClipMatrix;
+  glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+  glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+  glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+  glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+  glm::vec4 planes[6] =
+  {
+    row3 + row0,  //left
+    row3 - row0,  //right
+    row3 + row1,  //bottom
+    row3 - row1,  //top
+    row3 + row2,  //z = -w
+    row3 - row2   //z = w
+  };
+
+  FrustumPlanes result;
+  for (int i = 0; i < 6; i++)
+  {
+    float length = sqrtf(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z);
+    glm::vec4 p = length > 0 ? planes[i] / length : planes[i];
+    result.a[i] = p.x;
+    result.b[i] = p.y;
+    result.c[i] = p.z;
+    result.d[i] = p.w;
+  }
+
+  return result;
+}
+
+//reference versions, also used for the tails of the SIMD loops
+
+int cullSpheresScalar(const FrustumPlanes &planes, const float *x, const float *y, const float *z,
+                      const float *radius, int begin, int end, unsigned *visible)
+{
+  int visibleCount = 0;
+  for (int i = begin; i < end; i++)
+  {
+    bool inside = true;
+    for (int p = 0; p < 6; p++)
+    {
+      float distance = planes.a[p] * x[i] + planes.b[p] * y[i] + planes.c[p] * z[i] + planes.d[p];
+      inside = inside && distance > -radius[i];
+    }
+    visible[visibleCount] = i;
+    visibleCount += inside;
+  }
+
+  return visibleCount;
+}
+
+int cullAABBsScalar(const FrustumPlanes &planes,
+                    const float *centerX, const float *centerY, const float *centerZ,
+                    const float *extentX, const float *extentY, const float *extentZ,
+                    int begin, int end, unsigned *visible)
+{
+  int visibleCount = 0;
+  for (int i = begin; i < end; i++)
+  {
+    bool inside = true;
+    for (int p = 0; p < 6; p++)
+    {
+      //distance of the corner furthest along the plane normal
+      float distance = planes.a[p] * centerX[i] + planes.b[p] * centerY[i] + planes.c[p] * centerZ[i] + planes.d[p]
+        + fabsf(planes.a[p]) * extentX[i] + fabsf(planes.b[p]) * extentY[i] + fabsf(planes.c[p]) * extentZ[i];
+      inside = inside && distance > 0;
+    }
+    visible[visibleCount] = i;
+    visibleCount += inside;
+  }
+
+  return visibleCount;
+}
+
+//appends the indices of the set lanes of `mask`, branch free
+static int compactVisible(int mask, int lanes, unsigned base, unsigned *visible)
+{
+  int visibleCount = 0;
+  for (int lane = 0; lane < lanes; lane++)
+  {
+    visible[visibleCount] = base + lane;
+    visibleCount += (mask >> lane) & 1;
+  }
+
+  return visibleCount;
+}
+
+//returns the number of visible indices written to `visible`, which must hold
+//`count` entries
+int cullSpheres(const FrustumPlanes &planes, const float *x, const float *y, const float *z,
+                const float *radius, int count, unsigned *visible)
+{
+  int visibleCount = 0;
+  int i = 0;
+
+#if defined(__AVX__)
+  __m256 a8[6], b8[6], c8[6], d8[6];
+  for (int p = 0; p < 6; p++)
+  {
+    a8[p] = _mm256_set1_ps(planes.a[p]);
+    b8[p] = _mm256_set1_ps(planes.b[p]);
+    c8[p] = _mm256_set1_ps(planes.c[p]);
+    d8[p] = _mm256_set1_ps(planes.d[p]);
+  }
+
+  for (; i + 8 <= count; i += 8)
+  {
+    __m256 px = _mm256_loadu_ps(x + i);
+    __m256 py = _mm256_loadu_ps(y + i);
+    __m256 pz = _mm256_loadu_ps(z + i);
+    __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int p = 0; p < 6; p++)
+    {
+      __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a8[p], px), _mm256_mul_ps(b8[p], py)),
+                                      _mm256_add_ps(_mm256_mul_ps(c8[p], pz), d8[p]));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GT_OQ));
+    }
+
+    visibleCount += compactVisible(_mm256_movemask_ps(inside), 8, i, visible + visibleCount);
+  }
+#endif
+
+  __m128 a4[6], b4[6], c4[6], d4[6];
+  for (int p = 0; p < 6; p++)
+  {
+    a4[p] = _mm_set1_ps(planes.a[p]);
+    b4[p] = _mm_set1_ps(planes.b[p]);
+    c4[p] = _mm_set1_ps(planes.c[p]);
+    d4[p] = _mm_set1_ps(planes.d[p]);
+  }
+
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 px = _mm_loadu_ps(x + i);
+    __m128 py = _mm_loadu_ps(y + i);
+    __m128 pz = _mm_loadu_ps(z + i);
+    __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+    __m128 inside = _mm_cmpeq_ps(px, px);
+    for (int p = 0; p < 6; p++)
+    {
+      __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a4[p], px), _mm_mul_ps(b4[p], py)),
+                                   _mm_add_ps(_mm_mul_ps(c4[p], pz), d4[p]));
+      inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negRadius));
+    }
+
+    visibleCount += compactVisible(_mm_movemask_ps(inside), 4, i, visible + visibleCount);
+  }
+
+  visibleCount += cullSpheresScalar(planes, x, y, z, radius, i, count, visible + visibleCount);
+
+  return visibleCount;
+}
+
+int cullAABBs(const FrustumPlanes &planes,
+              const float *centerX, const float *centerY, const float *centerZ,
+              const float *extentX, const float *extentY, const float *extentZ,
+              int count, unsigned *visible)
+{
+  int visibleCount = 0;
+  int i = 0;
+
+#if defined(__AVX__)
+  __m256 a8[6], b8[6], c8[6], d8[6], absA8[6], absB8[6], absC8[6];
+  for (int p = 0; p < 6; p++)
+  {
+    a8[p] = _mm256_set1_ps(planes.a[p]);
+    b8[p] = _mm256_set1_ps(planes.b[p]);
+    c8[p] = _mm256_set1_ps(planes.c[p]);
+    d8[p] = _mm256_set1_ps(planes.d[p]);
+    absA8[p] = _mm256_set1_ps(fabsf(planes.a[p]));
+    absB8[p] = _mm256_set1_ps(fabsf(planes.b[p]));
+    absC8[p] = _mm256_set1_ps(fabsf(planes.c[p]));
+  }
+
+  for (; i + 8 <= count; i += 8)
+  {
+    __m256 cx = _mm256_loadu_ps(centerX + i);
+    __m256 cy = _mm256_loadu_ps(centerY + i);
+    __m256 cz = _mm256_loadu_ps(centerZ + i);
+    __m256 ex = _mm256_loadu_ps(extentX + i);
+    __m256 ey = _mm256_loadu_ps(extentY + i);
+    __m256 ez = _mm256_loadu_ps(extentZ + i);
+
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int p = 0; p < 6; p++)
+    {
+      __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a8[p], cx), _mm256_mul_ps(b8[p], cy)),
+                                      _mm256_add_ps(_mm256_mul_ps(c8[p], cz), d8[p]));
+      __m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absA8[p], ex), _mm256_mul_ps(absB8[p], ey)),
+                                   _mm256_mul_ps(absC8[p], ez));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), _mm256_setzero_ps(), _CMP_GT_OQ));
+    }
+
+    visibleCount += compactVisible(_mm256_movemask_ps(inside), 8, i, visible + visibleCount);
+  }
+#endif
+
+  __m128 a4[6], b4[6], c4[6], d4[6], absA4[6], absB4[6], absC4[6];
+  for (int p = 0; p < 6; p++)
+  {
+    a4[p] = _mm_set1_ps(planes.a[p]);
+    b4[p] = _mm_set1_ps(planes.b[p]);
+    c4[p] = _mm_set1_ps(planes.c[p]);
+    d4[p] = _mm_set1_ps(planes.d[p]);
+    absA4[p] = _mm_set1_ps(fabsf(planes.a[p]));
+    absB4[p] = _mm_set1_ps(fabsf(planes.b[p]));
+    absC4[p] = _mm_set1_ps(fabsf(planes.c[p]));
+  }
+
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 cx = _mm_loadu_ps(centerX + i);
+    __m128 cy = _mm_loadu_ps(centerY + i);
+    __m128 cz = _mm_loadu_ps(centerZ + i);
+    __m128 ex = _mm_loadu_ps(extentX + i);
+    __m128 ey = _mm_loadu_ps(extentY + i);
+    __m128 ez = _mm_loadu_ps(extentZ + i);
+
+    __m128 inside = _mm_cmpeq_ps(cx, cx);
+    for (int p = 0; p < 6; p++)
+    {
+      __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a4[p], cx), _mm_mul_ps(b4[p], cy)),
+                                   _mm_add_ps(_mm_mul_ps(c4[p], cz), d4[p]));
+      __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absA4[p], ex), _mm_mul_ps(absB4[p], ey)),
+                                _mm_mul_ps(absC4[p], ez));
+      inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+    }
+
+    visibleCount += compactVisible(_mm_movemask_ps(inside), 4, i, visible + visibleCount);
+  }
+
+  visibleCount += cullAABBsScalar(planes, centerX, centerY, centerZ, extentX, extentY, extentZ,
+                                  i, count, visible + visibleCount);
+
+  return visibleCount;
+}
+
+#endif
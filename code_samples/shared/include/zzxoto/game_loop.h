@@ -0,0 +1,123 @@
+#ifndef H_ZZXOTO_GAME_LOOP
+#define H_ZZXOTO_GAME_LOOP
+
+//Fixed timestep main loop: simulation advances in steps of exactly
+//StepSeconds() no matter how fast frames are rendered, and rendering blends
+//the last two simulation states with Alpha().
+//
+//  FixedStepLoop loop(1.0 / 60);
+//  ...                             //once per rendered frame, e.g. glutIdleFunc
+//  int steps = loop.Advance();
+//  for (int i = 0; i < steps; i++)
+//  {
+//    previous = current;
+//    update(loop.StepSeconds());
+//  }
+//  render(lerp(previous, current, loop.Alpha()));
+//
+//Real time goes into an accumulator that the steps drain. If a frame is so
+//slow that more than maxStepsPerFrame steps are due, the rest of the time is
+//dropped rather than caught up, so a stall can't snowball into ever longer
+//frames.
+//
+//UpdateRate()/RenderRate() are measured over windows of about a second.
+//
+//No GL dependency.
+
+#include <math.h>
+#include <chrono>
+
+class FixedStepLoop
+{
+  public:
+  FixedStepLoop(double stepSeconds = 1.0 / 60, int maxStepsPerFrame = 8)
+    :m_stepSeconds(stepSeconds), m_maxStepsPerFrame(maxStepsPerFrame), m_started(false), m_accumulator(0),
+     m_droppedSeconds(0), m_windowUpdates(0), m_windowRenders(0), m_updateRate(0), m_renderRate(0)
+  {
+  }
+  
+  //call at the start of every rendered frame; returns the update steps to run
+  int Advance()
+  {
+    Clock::time_point now = Clock::now();
+    if (!m_started)
+    {
+      m_started = true;
+      m_lastTime = m_windowStart = now;
+    }
+    
+    m_accumulator += std::chrono::duration<double>(now - m_lastTime).count();
+    m_lastTime = now;
+    
+    int steps = (int) (m_accumulator / m_stepSeconds);
+    if (steps > m_maxStepsPerFrame)
+    {
+      m_droppedSeconds += (steps - m_maxStepsPerFrame) * m_stepSeconds;
+      steps = m_maxStepsPerFrame;
+    }
+    m_accumulator -= steps * m_stepSeconds;
+    if (m_accumulator >= m_stepSeconds)
+    {
+      m_accumulator = fmod(m_accumulator, m_stepSeconds);
+    }
+    
+    m_windowUpdates += steps;
+    m_windowRenders++;
+    double windowSeconds = std::chrono::duration<double>(now - m_windowStart).count();
+    if (windowSeconds >= 1.0)
+    {
+      m_updateRate = m_windowUpdates / windowSeconds;
+      m_renderRate = m_windowRenders / windowSeconds;
+      m_windowUpdates = m_windowRenders = 0;
+      m_windowStart = now;
+    }
+    
+    return steps;
+  }
+  
+  //how far the render time is past the last update step, in [0, 1)
+  double Alpha() const
+  {
+    return m_accumulator / m_stepSeconds;
+  }
+  
+  double StepSeconds() const
+  {
+    return m_stepSeconds;
+  }
+  
+  //updates and rendered frames per second over the last full window
+  double UpdateRate() const
+  {
+    return m_updateRate;
+  }
+  
+  double RenderRate() const
+  {
+    return m_renderRate;
+  }
+  
+  //simulation time given up to maxStepsPerFrame since the start
+  double DroppedSeconds() const
+  {
+    return m_droppedSeconds;
+  }
+  
+  private:
+  typedef std::chrono::steady_clock Clock;
+  
+  double m_stepSeconds;
+  int m_maxStepsPerFrame;
+  bool m_started;
+  Clock::time_point m_lastTime;
+  double m_accumulator;
+  double m_droppedSeconds;
+  
+  Clock::time_point m_windowStart;
+  int m_windowUpdates;
+  int m_windowRenders;
+  double m_updateRate;
+  double m_renderRate;
+};
+
+#endif
@@ -1,60 +1,113 @@
-#ifndef ZZXOTOGL_HELPER_H
-#define ZZXOTO_HELPER_H
+#ifndef H_ZZXOTO_GL_HELPER
+#define H_ZZXOTO_GL_HELPER
 #include <iostream>
+#include <vector>
+#include <string.h>
 #include <GL/gl.h>
 #include <GL/glu.h>
 
 using std::cout;
 using std::endl;
 
-GLuint createShaderProgram(const char *vertexShaderSource, const char *fragmentShaderSource)
+//prints the whole info log of a shader or program, however long it is
+void printShaderInfoLog(GLuint object, bool isProgram)
 {
-  GLuint vertexShader, fragmentShader, program;
-  
-  vertexShader = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-  glCompileShader(vertexShader);
+  GLint length = 0;
+  if (isProgram)
+  {
+    glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+  }
+  else
+  {
+    glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+  }
   
+  if (length > 1)
   {
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    std::vector<char> infoLog(length);
+    if (isProgram)
     {
-      glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-      cout << infoLog << endl;
+      glGetProgramInfoLog(object, length, NULL, &infoLog[0]);
     }
+    else
+    {
+      glGetShaderInfoLog(object, length, NULL, &infoLog[0]);
+    }
+    cout << &infoLog[0] << endl;
   }
+}
+
+//starts compiling `source`, with `defines` (newline separated #define lines,
+//may be NULL) spliced in right after the #version line. Does not wait for the
+//result; see checkShaderCompile
+GLuint compileShader(GLenum type, const char *source, const char *defines = NULL)
+{
+  GLuint shader = glCreateShader(type);
+  
+  const char *versionLine = strstr(source, "#version");
+  const char *afterVersion = versionLine ? strchr(versionLine, '\n') : NULL;
+  if (defines && afterVersion)
+  {
+    afterVersion++;
+    
+    const char *sources[3] = {source, defines, afterVersion};
+    GLint lengths[3] = {(GLint) (afterVersion - source), (GLint) strlen(defines), -1};
+    glShaderSource(shader, 3, sources, lengths);
+  }
+  else
+  {
+    const char *sources[2] = {defines ? defines : "", source};
+    glShaderSource(shader, 2, sources, NULL);
+  }
+  glCompileShader(shader);
   
-  fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-  glCompileShader(fragmentShader);
+  return shader;
+}
+
+bool checkShaderCompile(GLuint shader)
+{
+  GLint success;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+  if (!success)
+  {
+    printShaderInfoLog(shader, false);
+  }
   
+  return success != 0;
+}
+
+bool checkProgramLink(GLuint program)
+{
+  GLint success;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success)
   {
-    int success;
-    char infoLog[512];
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-      glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-      cout << infoLog << endl;
-    }
+    printShaderInfoLog(program, true);
   }
   
-  program = glCreateProgram();
+  return success != 0;
+}
+
+//compiles and links synchronously; zzxoto/shader_cache.h is the cached and
+//parallel version of this
+GLuint createShaderProgram(const char *vertexShaderSource, const char *fragmentShaderSource,
+                           const char *defines = NULL)
+{
+  GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource, defines);
+  GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource, defines);
+  checkShaderCompile(vertexShader);
+  checkShaderCompile(fragmentShader);
+  
+  GLuint program = glCreateProgram();
   glAttachShader(program, vertexShader);
   glAttachShader(program, fragmentShader);
   glLinkProgram(program);
-  {
-    int success;
-    char infoLog[512];
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-      glGetProgramInfoLog(program, 512, NULL, infoLog);
-      cout << infoLog << endl;
-    }
-  }
+  checkProgramLink(program);
+  
+  glDetachShader(program, vertexShader);
+  glDetachShader(program, fragmentShader);
+  glDeleteShader(vertexShader);
+  glDeleteShader(fragmentShader);
   
   return program;
 }
@@ -0,0 +1,402 @@
+#ifndef H_ZZXOTO_GL_TRACE
+#define H_ZZXOTO_GL_TRACE
+
+//GL call tracing for debug builds: counts calls per entry point, the CPU time
+//spent in them and the bytes handed to glBufferData/glBufferSubData/
+//glTexImage2D/glTexSubImage2D, and times the GPU work of each frame with
+//GL_TIME_ELAPSED queries where the driver has them (3.3 or ARB_timer_query).
+//
+//  glewInit();
+//  GL_TRACE_INSTALL(60);     //print a summary of every 60th frame
+//  ...
+//  glutSwapBuffers();
+//  GL_TRACE_END_FRAME();
+//
+//Only the entry points in the two lists below are traced, so calls to
+//anything else are missing from the summary: add new GL calls there. They
+//cover everything the samples and the shared headers call, except the timer
+//query calls this file makes itself. GLEW entry points are traced by
+//pointing the __glew* function pointers at counting thunks after
+//GL_TRACE_INSTALL. GL 1.1 functions have no GLEW pointer; those are
+//redirected with macros, so this file has to be included right after
+//GL/glew.h, before any code calling them.
+//
+//Only compiled in when ZZXOTO_GL_TRACE is defined and NDEBUG is not; release
+//builds get empty macros and no wrappers at all.
+//
+//NOTE: expects GL/glew.h to be included before this file.
+
+#if defined(ZZXOTO_GL_TRACE) && !defined(NDEBUG)
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+//entry points that are GLEW function pointers
+#define GL_TRACE_GLEW_FUNCTIONS(X) \
+  X(ActiveTexture) X(AttachShader) X(BindBuffer) X(BindBufferRange) X(BindFramebuffer) \
+  X(BindVertexArray) X(BufferData) X(BufferSubData) X(CompileShader) X(CreateProgram) \
+  X(CreateShader) X(DeleteProgram) X(DeleteShader) X(DetachShader) X(DrawArraysInstanced) \
+  X(DrawElementsInstanced) X(EnableVertexAttribArray) X(GenBuffers) X(GenVertexArrays) \
+  X(GetActiveAttrib) X(GetActiveUniform) X(GetActiveUniformBlockName) X(GetActiveUniformBlockiv) \
+  X(GetAttribLocation) X(GetProgramBinary) X(GetProgramInfoLog) X(GetProgramiv) X(GetShaderInfoLog) \
+  X(GetShaderiv) X(GetUniformBlockIndex) X(GetUniformLocation) X(LinkProgram) X(MapBufferRange) \
+  X(MaxShaderCompilerThreadsKHR) X(ProgramBinary) X(ProgramParameteri) X(ShaderSource) \
+  X(TexBuffer) X(Uniform1f) X(Uniform1i) X(Uniform2f) X(Uniform2fv) X(Uniform3f) X(Uniform3fv) \
+  X(Uniform3i) X(Uniform3iv) X(Uniform4fv) X(UniformBlockBinding) X(UniformMatrix3fv) \
+  X(UniformMatrix4fv) X(UnmapBuffer) X(UseProgram) X(VertexAttribPointer)
+
+//GL 1.1 entry points, exported by the GL library itself
+#define GL_TRACE_CORE_FUNCTIONS(X) \
+  X(BindTexture) X(BlendFunc) X(Clear) X(ClearColor) X(ClearDepth) X(CullFace) X(DepthFunc) \
+  X(DepthMask) X(DepthRange) X(Disable) X(DrawArrays) X(DrawElements) X(Enable) X(Finish) X(Flush) \
+  X(FrontFace) X(GenTextures) X(GetIntegerv) X(GetString) X(PixelStorei) X(ReadPixels) \
+  X(TexImage2D) X(TexParameteri) X(TexSubImage2D) X(Viewport)
+
+typedef enum GlTraceEntry
+{
+#define GL_TRACE_ENUM(name) gltrace_##name,
+  GL_TRACE_GLEW_FUNCTIONS(GL_TRACE_ENUM)
+  GL_TRACE_CORE_FUNCTIONS(GL_TRACE_ENUM)
+#undef GL_TRACE_ENUM
+  GL_TRACE_ENTRY_COUNT
+} GlTraceEntry;
+
+static const char *GL_TRACE_NAMES[GL_TRACE_ENTRY_COUNT] =
+{
+#define GL_TRACE_NAME(name) "gl" #name,
+  GL_TRACE_GLEW_FUNCTIONS(GL_TRACE_NAME)
+  GL_TRACE_CORE_FUNCTIONS(GL_TRACE_NAME)
+#undef GL_TRACE_NAME
+};
+
+typedef struct GlTraceCounter
+{
+  unsigned calls;
+  unsigned long long bytes;
+  double ms;
+} GlTraceCounter;
+
+static const int GL_TRACE_QUERY_COUNT = 4;
+
+typedef struct GlTraceState
+{
+  GlTraceCounter frame[GL_TRACE_ENTRY_COUNT];
+  int frameIndex;
+  int reportInterval;
+  
+  //GPU time: a ring of queries, read a few frames later so nothing stalls
+  bool timerQueries;
+  GLuint queries[GL_TRACE_QUERY_COUNT];
+  int queryFrame[GL_TRACE_QUERY_COUNT];   //-1 when not pending
+  double gpuMs;
+  int gpuMsFrame;
+} GlTraceState;
+
+static GlTraceState g_glTrace;
+
+//bytes per pixel for the format/type pairs the samples upload
+unsigned glTracePixelSize(GLenum format, GLenum type)
+{
+  unsigned components = 4;
+  switch(format)
+  {
+    case GL_RED:
+    case GL_ALPHA:
+    case GL_DEPTH_COMPONENT:
+    {
+      components = 1;
+      break;
+    }
+    case GL_RG:
+    {
+      components = 2;
+      break;
+    }
+    case GL_RGB:
+    case GL_BGR:
+    {
+      components = 3;
+      break;
+    }
+  }
+  
+  switch(type)
+  {
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+    case GL_HALF_FLOAT:
+    {
+      return components * 2;
+    }
+    case GL_UNSIGNED_INT:
+    case GL_INT:
+    case GL_FLOAT:
+    {
+      return components * 4;
+    }
+  }
+  
+  return components;
+}
+
+//bytes passed by one call, 0 for entry points that don't upload
+template <int Entry>
+struct GlTraceBytes
+{
+  template <typename... Args>
+  static unsigned long long Count(Args...)
+  {
+    return 0;
+  }
+};
+
+template <>
+struct GlTraceBytes<gltrace_BufferData>
+{
+  static unsigned long long Count(GLenum, GLsizeiptr size, const void *, GLenum)
+  {
+    return size;
+  }
+};
+
+template <>
+struct GlTraceBytes<gltrace_BufferSubData>
+{
+  static unsigned long long Count(GLenum, GLintptr, GLsizeiptr size, const void *)
+  {
+    return size;
+  }
+};
+
+template <>
+struct GlTraceBytes<gltrace_TexImage2D>
+{
+  static unsigned long long Count(GLenum, GLint, GLint, GLsizei w, GLsizei h, GLint, GLenum format, GLenum type,
+                                  const void *)
+  {
+    return (unsigned long long) w * h * glTracePixelSize(format, type);
+  }
+};
+
+template <>
+struct GlTraceBytes<gltrace_TexSubImage2D>
+{
+  static unsigned long long Count(GLenum, GLint, GLint, GLint, GLsizei w, GLsizei h, GLenum format, GLenum type,
+                                  const void *)
+  {
+    return (unsigned long long) w * h * glTracePixelSize(format, type);
+  }
+};
+
+//counts and times one call on the way out
+class GlTraceCall
+{
+  public:
+  GlTraceCall(int entry, unsigned long long bytes)
+    :m_entry(entry), m_start(std::chrono::steady_clock::now())
+  {
+    g_glTrace.frame[entry].calls++;
+    g_glTrace.frame[entry].bytes += bytes;
+  }
+  
+  ~GlTraceCall()
+  {
+    g_glTrace.frame[m_entry].ms +=
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+  }
+  
+  private:
+  int m_entry;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+//one thunk per entry point; Original is the real function
+template <int Entry, typename Function>
+struct GlTraceThunk;
+
+template <int Entry, typename Result, typename... Args>
+struct GlTraceThunk<Entry, Result (GLAPIENTRY *)(Args...)>
+{
+  static Result GLAPIENTRY Call(Args... args)
+  {
+    GlTraceCall call(Entry, GlTraceBytes<Entry>::Count(args...));
+    return Original(args...);
+  }
+  
+  static Result (GLAPIENTRY *Original)(Args...);
+};
+
+template <int Entry, typename Result, typename... Args>
+Result (GLAPIENTRY *GlTraceThunk<Entry, Result (GLAPIENTRY *)(Args...)>::Original)(Args...) = NULL;
+
+template <int Entry, typename Function>
+void glTraceWrap(Function &pointer)
+{
+  if (pointer != NULL && pointer != GlTraceThunk<Entry, Function>::Call)
+  {
+    GlTraceThunk<Entry, Function>::Original = pointer;
+    pointer = GlTraceThunk<Entry, Function>::Call;
+  }
+}
+
+//the real GL 1.1 functions, taken before the macros below hide them
+#define GL_TRACE_CORE_TYPE(name) typedef decltype(&::gl##name) GlTraceType_##name;
+GL_TRACE_CORE_FUNCTIONS(GL_TRACE_CORE_TYPE)
+#undef GL_TRACE_CORE_TYPE
+
+//set during static initialization: the macros redirect calls made before
+//GL_TRACE_INSTALL too (headless.h's glGetString), and those need the real
+//function already
+static bool glTraceSetCoreOriginals()
+{
+#define GL_TRACE_SET_CORE(name) GlTraceThunk<gltrace_##name, GlTraceType_##name>::Original = &::gl##name;
+  GL_TRACE_CORE_FUNCTIONS(GL_TRACE_SET_CORE)
+#undef GL_TRACE_SET_CORE
+  return true;
+}
+
+static bool g_glTraceCoreOriginals = glTraceSetCoreOriginals();
+
+static void glTraceBeginQuery()
+{
+  if (!g_glTrace.timerQueries)
+  {
+    return;
+  }
+  
+  int slot = g_glTrace.frameIndex % GL_TRACE_QUERY_COUNT;
+  if (g_glTrace.queryFrame[slot] >= 0)
+  {
+    //GL_TRACE_QUERY_COUNT frames old, normally long done
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(g_glTrace.queries[slot], GL_QUERY_RESULT, &ns);
+    g_glTrace.gpuMs = ns * 1e-6;
+    g_glTrace.gpuMsFrame = g_glTrace.queryFrame[slot];
+  }
+  glBeginQuery(GL_TIME_ELAPSED, g_glTrace.queries[slot]);
+  g_glTrace.queryFrame[slot] = g_glTrace.frameIndex;
+}
+
+void installGlTrace(int reportInterval)
+{
+#define GL_TRACE_WRAP_GLEW(name) glTraceWrap<gltrace_##name>(__glew##name);
+  GL_TRACE_GLEW_FUNCTIONS(GL_TRACE_WRAP_GLEW)
+#undef GL_TRACE_WRAP_GLEW
+
+  memset(g_glTrace.frame, 0, sizeof(g_glTrace.frame));
+  g_glTrace.frameIndex = 0;
+  g_glTrace.reportInterval = reportInterval > 0 ? reportInterval : 60;
+  g_glTrace.gpuMs = 0;
+  g_glTrace.gpuMsFrame = -1;
+  
+  g_glTrace.timerQueries = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+  if (g_glTrace.timerQueries)
+  {
+    glGenQueries(GL_TRACE_QUERY_COUNT, g_glTrace.queries);
+    for (int i = 0; i < GL_TRACE_QUERY_COUNT; i++)
+    {
+      g_glTrace.queryFrame[i] = -1;
+    }
+  }
+  glTraceBeginQuery();
+  
+  printf("gl trace: %d entry points, GPU timing %s\n", (int) GL_TRACE_ENTRY_COUNT,
+         g_glTrace.timerQueries ? "on" : "not supported");
+}
+
+static bool glTraceByCalls(int a, int b)
+{
+  return g_glTrace.frame[a].calls > g_glTrace.frame[b].calls;
+}
+
+static void printGlTraceFrame()
+{
+  int order[GL_TRACE_ENTRY_COUNT];
+  int used = 0;
+  unsigned totalCalls = 0;
+  unsigned long long totalBytes = 0;
+  double totalMs = 0;
+  for (int i = 0; i < GL_TRACE_ENTRY_COUNT; i++)
+  {
+    if (g_glTrace.frame[i].calls > 0)
+    {
+      order[used++] = i;
+      totalCalls += g_glTrace.frame[i].calls;
+      totalBytes += g_glTrace.frame[i].bytes;
+      totalMs += g_glTrace.frame[i].ms;
+    }
+  }
+  std::sort(order, order + used, glTraceByCalls);
+  
+  printf("gl trace, frame %d\n", g_glTrace.frameIndex);
+  printf("  %-28s %8s %12s %10s\n", "entry point", "calls", "bytes", "cpu ms");
+  for (int i = 0; i < used; i++)
+  {
+    const GlTraceCounter &c = g_glTrace.frame[order[i]];
+    printf("  %-28s %8u %12llu %10.3f\n", GL_TRACE_NAMES[order[i]], c.calls, c.bytes, c.ms);
+  }
+  printf("  %-28s %8u %12llu %10.3f\n", "total", totalCalls, totalBytes, totalMs);
+  if (g_glTrace.gpuMsFrame >= 0)
+  {
+    printf("  gpu time %.3f ms (frame %d)\n", g_glTrace.gpuMs, g_glTrace.gpuMsFrame);
+  }
+}
+
+void endGlTraceFrame()
+{
+  if (g_glTrace.timerQueries)
+  {
+    glEndQuery(GL_TIME_ELAPSED);
+  }
+  
+  if (g_glTrace.frameIndex % g_glTrace.reportInterval == 0)
+  {
+    printGlTraceFrame();
+  }
+  
+  memset(g_glTrace.frame, 0, sizeof(g_glTrace.frame));
+  g_glTrace.frameIndex++;
+  glTraceBeginQuery();
+}
+
+//from here on GL 1.1 calls go through the thunks too
+#define GL_TRACE_REDIRECT(name) GlTraceThunk<gltrace_##name, GlTraceType_##name>::Call
+#define glBindTexture GL_TRACE_REDIRECT(BindTexture)
+#define glBlendFunc GL_TRACE_REDIRECT(BlendFunc)
+#define glClear GL_TRACE_REDIRECT(Clear)
+#define glClearColor GL_TRACE_REDIRECT(ClearColor)
+#define glClearDepth GL_TRACE_REDIRECT(ClearDepth)
+#define glCullFace GL_TRACE_REDIRECT(CullFace)
+#define glDepthFunc GL_TRACE_REDIRECT(DepthFunc)
+#define glDepthMask GL_TRACE_REDIRECT(DepthMask)
+#define glDepthRange GL_TRACE_REDIRECT(DepthRange)
+#define glDisable GL_TRACE_REDIRECT(Disable)
+#define glDrawArrays GL_TRACE_REDIRECT(DrawArrays)
+#define glDrawElements GL_TRACE_REDIRECT(DrawElements)
+#define glEnable GL_TRACE_REDIRECT(Enable)
+#define glFinish GL_TRACE_REDIRECT(Finish)
+#define glFlush GL_TRACE_REDIRECT(Flush)
+#define glFrontFace GL_TRACE_REDIRECT(FrontFace)
+#define glGenTextures GL_TRACE_REDIRECT(GenTextures)
+#define glGetIntegerv GL_TRACE_REDIRECT(GetIntegerv)
+#define glGetString GL_TRACE_REDIRECT(GetString)
+#define glPixelStorei GL_TRACE_REDIRECT(PixelStorei)
+#define glReadPixels GL_TRACE_REDIRECT(ReadPixels)
+#define glTexImage2D GL_TRACE_REDIRECT(TexImage2D)
+#define glTexParameteri GL_TRACE_REDIRECT(TexParameteri)
+#define glTexSubImage2D GL_TRACE_REDIRECT(TexSubImage2D)
+#define glViewport GL_TRACE_REDIRECT(Viewport)
+
+#define GL_TRACE_INSTALL(reportInterval) installGlTrace(reportInterval)
+#define GL_TRACE_END_FRAME() endGlTraceFrame()
+
+#else
+
+#define GL_TRACE_INSTALL(reportInterval)
+#define GL_TRACE_END_FRAME()
+
+#endif
+
+#endif
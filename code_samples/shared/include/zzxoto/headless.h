@@ -0,0 +1,343 @@
+#ifndef H_ZZXOTO_HEADLESS
+#define H_ZZXOTO_HEADLESS
+
+//Headless backend for the samples: built with ZZXOTO_HEADLESS defined, this
+//file implements the handful of GLUT entry points the samples call, on top
+//of a surfaceless EGL context (Mesa llvmpipe works, no display or GPU
+//needed). Without ZZXOTO_HEADLESS it is empty and freeglut is used as usual,
+//so init/display/reshape run unchanged in both modes.
+//
+//glutCreateWindow makes a window sized color + depth/stencil framebuffer
+//object and leaves it bound; it stands in for the default framebuffer.
+//glutMainLoop calls reshape once, then for every frame: the idle func, the
+//timers that are due, display, and optionally a PNG dump of the FBO. Frames
+//are not paced: timers fire on the next frame whatever their delay, and
+//every frame is displayed whether or not it was posted.
+//
+//Options, taken out of argv by glutInit:
+//  --frames N        frames to render, default 60
+//  --dump prefix     write every frame to prefix_0000.png, prefix_0001.png...
+//
+//Linux only. Instead of freeglut, link EGL:
+//  g++ -O2 -DZZXOTO_HEADLESS -Ishared/include -pthread <sample>/main.cpp -o main -lGLEW -lEGL -lGL
+//GLEW built for GLX fails the GLX part of glewInit without an X display; the
+//samples only print that error, the GL entry points are loaded by then.
+//
+//NOTE: expects GL/glew.h and GL/freeglut.h to be included before this file.
+
+#ifdef ZZXOTO_HEADLESS
+
+#ifdef _WIN32
+#error "the headless backend needs EGL; build the windowed version on Windows"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include "zzxoto/png_file.h"
+
+typedef struct HeadlessTimer
+{
+  void (*callback)(int);
+  int value;
+} HeadlessTimer;
+
+typedef struct HeadlessState
+{
+  int frameCount;
+  const char *dumpPrefix;
+  int width, height;
+  int contextMajor, contextMinor, contextProfile;
+  bool running;
+  std::chrono::steady_clock::time_point startTime;
+  
+  EGLDisplay display;
+  EGLContext context;
+  GLuint framebuffer;
+  GLuint colorRenderbuffer;
+  GLuint depthRenderbuffer;
+  
+  void (*displayFunc)(void);
+  void (*reshapeFunc)(int, int);
+  void (*idleFunc)(void);
+  std::vector<HeadlessTimer> timers;
+} HeadlessState;
+
+//defaults, everything else zero
+static HeadlessState makeHeadlessState()
+{
+  HeadlessState state = HeadlessState();
+  state.frameCount = 60;
+  state.width = 300;
+  state.height = 300;
+  return state;
+}
+
+static HeadlessState g_headless = makeHeadlessState();
+
+static void headlessFail(const char *what)
+{
+  fprintf(stderr, "headless: %s failed (EGL error 0x%x)\n", what, eglGetError());
+  exit(1);
+}
+
+static void headlessDumpFrame(int frame)
+{
+  std::vector<unsigned char> pixels((size_t) g_headless.width * g_headless.height * 4);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, g_headless.framebuffer);
+  glReadPixels(0, 0, g_headless.width, g_headless.height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+  
+  char path[1024];
+  snprintf(path, sizeof(path), "%s_%04d.png", g_headless.dumpPrefix, frame);
+  if (!writePng(path, g_headless.width, g_headless.height, &pixels[0], true))
+  {
+    fprintf(stderr, "headless: could not write %s\n", path);
+  }
+}
+
+extern "C"
+{
+
+void glutInit(int *pargc, char **argv)
+{
+  g_headless.startTime = std::chrono::steady_clock::now();
+  
+  //consume our options so the sample's own parsing never sees them
+  int kept = 1;
+  for (int i = 1; i < *pargc; i++)
+  {
+    if (strcmp(argv[i], "--frames") == 0 && i + 1 < *pargc)
+    {
+      g_headless.frameCount = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--dump") == 0 && i + 1 < *pargc)
+    {
+      g_headless.dumpPrefix = argv[++i];
+    }
+    else
+    {
+      argv[kept++] = argv[i];
+    }
+  }
+  argv[kept] = NULL;
+  *pargc = kept;
+}
+
+void glutInitContextVersion(int majorVersion, int minorVersion)
+{
+  g_headless.contextMajor = majorVersion;
+  g_headless.contextMinor = minorVersion;
+}
+
+void glutInitContextProfile(int profile)
+{
+  g_headless.contextProfile = profile;
+}
+
+void glutInitDisplayMode(unsigned int)
+{
+  //the FBO always has color, depth and stencil
+}
+
+void glutInitWindowSize(int width, int height)
+{
+  g_headless.width = width;
+  g_headless.height = height;
+}
+
+int glutCreateWindow(const char *)
+{
+  //the surfaceless platform needs neither a display server nor a config
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+  g_headless.display = getPlatformDisplay
+    ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL)
+    : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  
+  EGLint major, minor;
+  if (!eglInitialize(g_headless.display, &major, &minor))
+  {
+    headlessFail("eglInitialize");
+  }
+  eglBindAPI(EGL_OPENGL_API);
+  
+  EGLint attributes[7] = {EGL_NONE};
+  if (g_headless.contextMajor > 0)
+  {
+    attributes[0] = EGL_CONTEXT_MAJOR_VERSION;
+    attributes[1] = g_headless.contextMajor;
+    attributes[2] = EGL_CONTEXT_MINOR_VERSION;
+    attributes[3] = g_headless.contextMinor;
+    attributes[4] = EGL_CONTEXT_OPENGL_PROFILE_MASK;
+    attributes[5] = g_headless.contextProfile == GLUT_CORE_PROFILE
+      ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT
+      : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT;
+    attributes[6] = EGL_NONE;
+  }
+  
+  g_headless.context = eglCreateContext(g_headless.display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+  if (g_headless.context == EGL_NO_CONTEXT)
+  {
+    headlessFail("eglCreateContext");
+  }
+  if (!eglMakeCurrent(g_headless.display, EGL_NO_SURFACE, EGL_NO_SURFACE, g_headless.context))
+  {
+    headlessFail("eglMakeCurrent");
+  }
+  
+  //glew isn't initialized yet, these come straight from libGL
+  PFNGLGENFRAMEBUFFERSPROC genFramebuffers = (PFNGLGENFRAMEBUFFERSPROC) eglGetProcAddress("glGenFramebuffers");
+  PFNGLBINDFRAMEBUFFERPROC bindFramebuffer = (PFNGLBINDFRAMEBUFFERPROC) eglGetProcAddress("glBindFramebuffer");
+  PFNGLGENRENDERBUFFERSPROC genRenderbuffers = (PFNGLGENRENDERBUFFERSPROC) eglGetProcAddress("glGenRenderbuffers");
+  PFNGLBINDRENDERBUFFERPROC bindRenderbuffer = (PFNGLBINDRENDERBUFFERPROC) eglGetProcAddress("glBindRenderbuffer");
+  PFNGLRENDERBUFFERSTORAGEPROC renderbufferStorage =
+    (PFNGLRENDERBUFFERSTORAGEPROC) eglGetProcAddress("glRenderbufferStorage");
+  PFNGLFRAMEBUFFERRENDERBUFFERPROC framebufferRenderbuffer =
+    (PFNGLFRAMEBUFFERRENDERBUFFERPROC) eglGetProcAddress("glFramebufferRenderbuffer");
+  PFNGLCHECKFRAMEBUFFERSTATUSPROC checkFramebufferStatus =
+    (PFNGLCHECKFRAMEBUFFERSTATUSPROC) eglGetProcAddress("glCheckFramebufferStatus");
+  
+  genRenderbuffers(1, &g_headless.colorRenderbuffer);
+  bindRenderbuffer(GL_RENDERBUFFER, g_headless.colorRenderbuffer);
+  renderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, g_headless.width, g_headless.height);
+  genRenderbuffers(1, &g_headless.depthRenderbuffer);
+  bindRenderbuffer(GL_RENDERBUFFER, g_headless.depthRenderbuffer);
+  renderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, g_headless.width, g_headless.height);
+  bindRenderbuffer(GL_RENDERBUFFER, 0);
+  
+  genFramebuffers(1, &g_headless.framebuffer);
+  bindFramebuffer(GL_FRAMEBUFFER, g_headless.framebuffer);
+  framebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, g_headless.colorRenderbuffer);
+  framebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, g_headless.depthRenderbuffer);
+  if (checkFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+  {
+    headlessFail("framebuffer setup");
+  }
+  
+  printf("headless: %s, %dx%d, %d frames\n", (const char *) glGetString(GL_RENDERER),
+         g_headless.width, g_headless.height, g_headless.frameCount);
+  
+  return 1;
+}
+
+void glutDisplayFunc(void (*callback)(void))
+{
+  g_headless.displayFunc = callback;
+}
+
+void glutReshapeFunc(void (*callback)(int, int))
+{
+  g_headless.reshapeFunc = callback;
+}
+
+void glutIdleFunc(void (*callback)(void))
+{
+  g_headless.idleFunc = callback;
+}
+
+//no input without a window
+void glutKeyboardFunc(void (*)(unsigned char, int, int))
+{
+}
+
+void glutMouseFunc(void (*)(int, int, int, int))
+{
+}
+
+void glutTimerFunc(unsigned int, void (*callback)(int), int value)
+{
+  HeadlessTimer timer = {callback, value};
+  g_headless.timers.push_back(timer);
+}
+
+void glutPostRedisplay(void)
+{
+}
+
+void glutSwapBuffers(void)
+{
+  glFlush();
+}
+
+void glutLeaveMainLoop(void)
+{
+  g_headless.running = false;
+}
+
+int glutGet(GLenum query)
+{
+  switch(query)
+  {
+    case GLUT_ELAPSED_TIME:
+    {
+      return (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - g_headless.startTime).count();
+    }
+    case GLUT_WINDOW_WIDTH:
+    {
+      return g_headless.width;
+    }
+    case GLUT_WINDOW_HEIGHT:
+    {
+      return g_headless.height;
+    }
+  }
+  
+  return 0;
+}
+
+void glutMainLoop(void)
+{
+  //what GLUT's default reshape does, then the sample's
+  glViewport(0, 0, g_headless.width, g_headless.height);
+  if (g_headless.reshapeFunc)
+  {
+    g_headless.reshapeFunc(g_headless.width, g_headless.height);
+  }
+  
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  
+  int frame = 0;
+  std::vector<HeadlessTimer> dueTimers;
+  g_headless.running = true;
+  for (; frame < g_headless.frameCount && g_headless.running; frame++)
+  {
+    if (g_headless.idleFunc)
+    {
+      g_headless.idleFunc();
+    }
+    
+    //timers registered from a timer callback wait for the next frame
+    dueTimers.swap(g_headless.timers);
+    for (size_t i = 0; i < dueTimers.size(); i++)
+    {
+      dueTimers[i].callback(dueTimers[i].value);
+    }
+    dueTimers.clear();
+    
+    if (g_headless.displayFunc)
+    {
+      g_headless.displayFunc();
+    }
+    
+    if (g_headless.dumpPrefix)
+    {
+      headlessDumpFrame(frame);
+    }
+  }
+  glFinish();
+  
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  printf("headless: %d frames in %.1f ms, %.3f ms/frame\n", frame, ms, frame > 0 ? ms / frame : 0.0);
+}
+
+}
+
+#endif
+
+#endif
@@ -1,14 +1,18 @@
 #ifndef H_ZZXOTO_HELPER
 #define H_ZZXOTO_HELPER
 
+#include <assert.h>
 #include <stdio.h>
+#include <string.h>
 #include <stack>
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <math.h>
+#include "zzxoto/matrix_simd.h"
 
-#define PI 3.14159
+#define PI 3.14159265358979f
 
 void printMatrix(const glm::mat4 &matrix)
 {
@@ -74,45 +78,21 @@ glm::vec3 normalize(const glm::vec3 &vec)
   return result;
 }
 
-class MatrixStack
+//the current matrix and the operations on it; MatrixStack and
+//FixedMatrixStack add the saved matrices
+class MatrixStackBase
 {
   public:
-  MatrixStack()
-    :m_currMatrix(1)
-  {
-  }
-  
-  MatrixStack(const glm::mat4 &initialMatrix)
-    :m_currMatrix(initialMatrix)
-  {
-  }
-  
-  void Push()
-  {
-    m_stack.push(m_currMatrix);
-  }
-  
-  void Pop()
-  {
-    m_currMatrix = m_stack.top();
-    m_stack.pop();
-  }
-  
   const glm::mat4 &Top() const
   {
     return m_currMatrix;
   }
   
+  //scale, translate and rotate about Z update the affected columns in place,
+  //see matrix_simd.h
   void Scale(const glm::vec3 &scaleVec)
   {
-    glm::mat4 scale(1);
-    float *columnMajor = glm::value_ptr(scale);
-    
-    columnMajor[0]  = scaleVec.x;
-    columnMajor[5]  = scaleVec.y;
-    columnMajor[10] = scaleVec.z;
-    
-    this->m_currMatrix = this->m_currMatrix * scale;
+    mat4Scale(glm::value_ptr(m_currMatrix), scaleVec.x, scaleVec.y, scaleVec.z);
   }
   
   void Scale(float uniformScale) 
@@ -122,15 +102,7 @@ class MatrixStack
   
   void Translate(float tx, float ty, float tz)
   {
-    glm::mat4 translate(1);
-    float *columnMajor = glm::value_ptr(translate);
-    
-    
-    columnMajor[12] = tx;
-    columnMajor[13] = ty;
-    columnMajor[14] = tz;
-    
-    this->m_currMatrix = this->m_currMatrix * translate;
+    mat4Translate(glm::value_ptr(m_currMatrix), tx, ty, tz);
   }
   
   void Translate(const glm::vec3 &offsetVec)
@@ -171,8 +143,9 @@ class MatrixStack
     glm::mat4 rotation(1);
     float *columnMajor = glm::value_ptr(rotation);
     
-    float s = sin(toRadians(degrees));
-    float c = cos(toRadians(degrees));
+    float radians = toRadians(degrees);
+    float s = sinf(radians);
+    float c = cosf(radians);
     float c_ = 1.0f - c;
     
     columnMajor[0] = (axis.x * axis.x * c_) + c;
@@ -187,17 +160,15 @@ class MatrixStack
     columnMajor[9] = (axis.z * axis.y * c_) - (axis.x * s);
     columnMajor[10] = (axis.z * axis.z * c_) + c;
     
-    this->m_currMatrix = this->m_currMatrix * rotation;
+    mat4Multiply(glm::value_ptr(m_currMatrix), columnMajor, glm::value_ptr(m_currMatrix));
   }
   
   
   void RotateZ(float degrees)
   {
-    glm::mat4 rotation(1);
-    float *columnMajor = glm::value_ptr(rotation);
-    
-    float s = sin(toRadians(degrees));
-    float c = cos(toRadians(degrees));
+    float radians = toRadians(degrees);
+    float s = sinf(radians);
+    float c = cosf(radians);
     
     //[
     //  cos, -sin, 0, 0
@@ -205,35 +176,168 @@ class MatrixStack
     //  0,   0,   1, 0
     //  0,   0,   0, 1
     //]
-    columnMajor[0] = c;
-    columnMajor[1] = s;
-    columnMajor[4] = -s;
-    columnMajor[5] = c;
+    mat4RotateZ(glm::value_ptr(m_currMatrix), c, s);
+  }
+  
+  //Rotation by a unit quaternion: its 3x3 is a few products, no sin/cos and
+  //no axis normalization, and only columns 0-2 are updated
+  void Rotate(const glm::quat &rotation)
+  {
+    float r[9];
+    rotationScaleColumns(rotation, glm::vec3(1), r);
+    mat4Multiply3x3(glm::value_ptr(m_currMatrix), r);
+  }
+  
+  //Translate(translation), Rotate(rotation), Scale(scale) in two in place
+  //updates, the way a hierarchy node is usually placed
+  void Transform(const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale)
+  {
+    float r[9];
+    rotationScaleColumns(rotation, scale, r);
+    float *columnMajor = glm::value_ptr(m_currMatrix);
+    mat4Translate(columnMajor, translation.x, translation.y, translation.z);
+    mat4Multiply3x3(columnMajor, r);
+  }
+  
+  protected:
+  MatrixStackBase(const glm::mat4 &initialMatrix)
+    :m_currMatrix(initialMatrix)
+  {
+  }
+  
+  glm::mat4 m_currMatrix;
+  
+  private:
+  //column major rotation(q) * scale(s)
+  static void rotationScaleColumns(const glm::quat &q, const glm::vec3 &s, float *r)
+  {
+    float x = q.x, y = q.y, z = q.z, w = q.w;
     
-    this->m_currMatrix = this->m_currMatrix * rotation;
+    r[0] = (1.0f - 2.0f * (y * y + z * z)) * s.x;
+    r[1] = 2.0f * (x * y + w * z) * s.x;
+    r[2] = 2.0f * (x * z - w * y) * s.x;
+    
+    r[3] = 2.0f * (x * y - w * z) * s.y;
+    r[4] = (1.0f - 2.0f * (x * x + z * z)) * s.y;
+    r[5] = 2.0f * (y * z + w * x) * s.y;
+    
+    r[6] = 2.0f * (x * z + w * y) * s.z;
+    r[7] = 2.0f * (y * z - w * x) * s.z;
+    r[8] = (1.0f - 2.0f * (x * x + y * y)) * s.z;
+  }
+};
+
+class MatrixStack : public MatrixStackBase
+{
+  public:
+  MatrixStack()
+    :MatrixStackBase(glm::mat4(1))
+  {
+  }
+  
+  MatrixStack(const glm::mat4 &initialMatrix)
+    :MatrixStackBase(initialMatrix)
+  {
+  }
+  
+  void Push()
+  {
+    m_stack.push(m_currMatrix);
+  }
+  
+  void Pop()
+  {
+    m_currMatrix = m_stack.top();
+    m_stack.pop();
   }
   
   private:
   std::stack<glm::mat4, std::vector<glm::mat4>> m_stack;
-  glm::mat4 m_currMatrix;
 };
 
+//Same operations, but at most Depth pushes kept inline: building one per
+//frame never touches the allocator. Over- and underflow assert in debug
+//builds. The saved matrices are glm::mat4 even though their constructors set
+//Depth identities: copied as raw floats with memcpy, the compiler has to
+//assume every Push/Pop may overwrite m_count and keeps it in memory, which
+//made the stack slower than MatrixStack's heap allocations.
+template <int Depth>
+class FixedMatrixStack : public MatrixStackBase
+{
+  public:
+  FixedMatrixStack()
+    :MatrixStackBase(glm::mat4(1)), m_count(0)
+  {
+  }
+  
+  FixedMatrixStack(const glm::mat4 &initialMatrix)
+    :MatrixStackBase(initialMatrix), m_count(0)
+  {
+  }
+  
+  void Push()
+  {
+    assert(m_count < Depth && "FixedMatrixStack overflow, raise Depth");
+    m_saved[m_count++] = m_currMatrix;
+  }
+  
+  void Pop()
+  {
+    assert(m_count > 0 && "FixedMatrixStack underflow");
+    m_currMatrix = m_saved[--m_count];
+  }
+  
+  int Size() const
+  {
+    return m_count;
+  }
+  
+  private:
+  glm::mat4 m_saved[Depth];
+  int m_count;
+};
+
+//Push on construction, Pop on destruction, for either kind of stack
 class PushStack
 {
   public:
   PushStack(MatrixStack &stack)
-    : m_stack(stack)
+    :m_stack(&stack), m_pop(pop<MatrixStack>)
+  {
+    stack.Push();
+  }
+  
+  template <int Depth>
+  PushStack(FixedMatrixStack<Depth> &stack)
+    :m_stack(&stack), m_pop(pop<FixedMatrixStack<Depth> >)
   {
-    m_stack.Push();
+    stack.Push();
+  }
+  
+  //Push, then place the child: Transform(translation, rotation, scale)
+  template <typename Stack>
+  PushStack(Stack &stack, const glm::vec3 &translation, const glm::quat &rotation,
+            const glm::vec3 &scale = glm::vec3(1))
+    :m_stack(&stack), m_pop(pop<Stack>)
+  {
+    stack.Push();
+    stack.Transform(translation, rotation, scale);
   }
   
   ~PushStack()
   {
-    m_stack.Pop();
+    m_pop(m_stack);
   }
   
   private:
-  MatrixStack &m_stack;
+  template <typename Stack>
+  static void pop(void *stack)
+  {
+    ((Stack *) stack)->Pop();
+  }
+  
+  void *m_stack;
+  void (*m_pop)(void *);
 };
 
 #endif
\ No newline at end of file
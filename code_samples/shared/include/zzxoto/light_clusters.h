@@ -0,0 +1,271 @@
+#ifndef H_ZZXOTO_LIGHT_CLUSTERS
+#define H_ZZXOTO_LIGHT_CLUSTERS
+
+//Clustered light culling (Olsson, Billeter, Assarsson - "Clustered Deferred
+//and Forward Shading", 2012).
+//
+//The view frustum is cut into tilesX * tilesY screen tiles and `slices` depth
+//slices, spaced exponentially between near and far so clusters stay roughly
+//cube shaped. Every frame the light spheres, in camera space, are binned into
+//the clusters they touch, and the result is two flat arrays ready to upload:
+//
+//  ClusterRanges()   per cluster (offset, count) into LightIndices()
+//  LightIndices()    light indices, grouped by cluster
+//
+//cluster index = (slice * tilesY + tileY) * tilesX + tileX, with tile 0 at the
+//left/bottom of the screen like NDC. A fragment finds its cluster with
+//
+//  tile  = gl_FragCoord.xy / viewportSize * tiles
+//  slice = log(depth) * SliceScale() + SliceBias()
+//
+//Binning is split over depth slices, so every task owns a contiguous run of
+//clusters and writes without any synchronization.
+//
+//No GL dependency.
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include "zzxoto/thread_pool.h"
+
+class LightClusters
+{
+  public:
+  LightClusters(int tilesX = 16, int tilesY = 16, int slices = 24)
+    :m_tilesX(tilesX), m_tilesY(tilesY), m_slices(slices),
+     m_projX(1.0f), m_projY(1.0f), m_zNear(.1f), m_zFar(100.0f),
+     m_lights(NULL), m_lightCount(0), m_indexCount(0)
+  {
+    m_ranges.assign(ClusterCount() * 2, 0);
+    m_indices.assign(1, 0);
+  }
+  
+  //projX/projY are cameraToClipMatrix[0][0] and [1][1]
+  void SetProjection(float projX, float projY, float zNear, float zFar)
+  {
+    m_projX = projX;
+    m_projY = projY;
+    m_zNear = zNear;
+    m_zFar = zFar;
+  }
+  
+  //lights_cameraSpace: xyz position, w radius. With a pool the depth slices
+  //are spread over its threads.
+  void Bin(const glm::vec4 *lights_cameraSpace, int lightCount, ThreadPool *pool = NULL)
+  {
+    m_lights = lights_cameraSpace;
+    m_lightCount = lightCount;
+    
+    int taskCount = pool ? glm::min(pool->ThreadCount(), m_slices) : 1;
+    m_tasks.resize(taskCount);
+    
+    if (pool && taskCount > 1)
+    {
+      pool->Run(BinSlices, this, taskCount);
+    }
+    else
+    {
+      BinSlices(0, 1, this);
+    }
+    
+    //stitch the per task lists into one array
+    int total = 0;
+    for (int t = 0; t < taskCount; t++)
+    {
+      total += (int) m_tasks[t].indices.size();
+    }
+    m_indices.resize(glm::max(total, 1));
+    
+    unsigned base = 0;
+    for (int t = 0; t < taskCount; t++)
+    {
+      BinTask &task = m_tasks[t];
+      if (!task.indices.empty())
+      {
+        memcpy(&m_indices[base], &task.indices[0], task.indices.size() * sizeof(unsigned));
+      }
+      for (int cluster = task.firstCluster; cluster < task.endCluster; cluster++)
+      {
+        m_ranges[cluster * 2] += base;
+      }
+      base += (unsigned) task.indices.size();
+    }
+    m_indexCount = total;
+  }
+  
+  int ClusterCount() const
+  {
+    return m_tilesX * m_tilesY * m_slices;
+  }
+  
+  glm::ivec3 Dimensions() const
+  {
+    return glm::ivec3(m_tilesX, m_tilesY, m_slices);
+  }
+  
+  //slice = log(depth) * SliceScale() + SliceBias()
+  float SliceScale() const
+  {
+    return m_slices / logf(m_zFar / m_zNear);
+  }
+  
+  float SliceBias() const
+  {
+    return -logf(m_zNear) * SliceScale();
+  }
+  
+  //2 per cluster: offset, count
+  const unsigned *ClusterRanges() const
+  {
+    return &m_ranges[0];
+  }
+  
+  //never empty, so it can always be uploaded; LightIndexCount is the real size
+  const unsigned *LightIndices() const
+  {
+    return &m_indices[0];
+  }
+  
+  int LightIndexCount() const
+  {
+    return m_indexCount;
+  }
+  
+  private:
+  typedef struct BinTask
+  {
+    int firstCluster;
+    int endCluster;
+    std::vector<unsigned> indices;
+    std::vector<glm::ivec4> rects;    //per candidate light: x0, y0, x1, y1 tiles, inclusive
+    std::vector<unsigned> candidates;
+  } BinTask;
+  
+  static void BinSlices(int taskIndex, int taskCount, void *userData)
+  {
+    LightClusters *clusters = (LightClusters *) userData;
+    
+    int begin, end;
+    taskRange(clusters->m_slices, taskIndex, taskCount, &begin, &end);
+    clusters->BinSliceRange(clusters->m_tasks[taskIndex], begin, end);
+  }
+  
+  void BinSliceRange(BinTask &task, int sliceBegin, int sliceEnd)
+  {
+    int tileCount = m_tilesX * m_tilesY;
+    task.firstCluster = sliceBegin * tileCount;
+    task.endCluster = sliceEnd * tileCount;
+    task.indices.clear();
+    
+    float depthRatio = m_zFar / m_zNear;
+    
+    for (int slice = sliceBegin; slice < sliceEnd; slice++)
+    {
+      float sliceNear = m_zNear * powf(depthRatio, (float) slice / m_slices);
+      float sliceFar = m_zNear * powf(depthRatio, (float) (slice + 1) / m_slices);
+      
+      //lights reaching into the slice, with their tile rectangle
+      task.candidates.clear();
+      task.rects.clear();
+      for (int i = 0; i < m_lightCount; i++)
+      {
+        const glm::vec4 &light = m_lights[i];
+        float depth = -light.z;
+        float nearest = glm::max(depth - light.w, sliceNear);
+        float farthest = glm::min(depth + light.w, sliceFar);
+        if (nearest > farthest)
+        {
+          continue;
+        }
+        
+        glm::ivec4 rect;
+        if (TileRect(light, nearest, farthest, &rect))
+        {
+          task.candidates.push_back(i);
+          task.rects.push_back(rect);
+        }
+      }
+      
+      //counting sort of (cluster, light) pairs; the light order within a
+      //cluster stays ascending
+      unsigned *ranges = &m_ranges[slice * tileCount * 2];
+      for (int tile = 0; tile < tileCount; tile++)
+      {
+        ranges[tile * 2 + 1] = 0;
+      }
+      for (size_t c = 0; c < task.candidates.size(); c++)
+      {
+        const glm::ivec4 &rect = task.rects[c];
+        for (int y = rect.y; y <= rect.w; y++)
+        {
+          for (int x = rect.x; x <= rect.z; x++)
+          {
+            ranges[(y * m_tilesX + x) * 2 + 1]++;
+          }
+        }
+      }
+      
+      unsigned offset = (unsigned) task.indices.size();
+      for (int tile = 0; tile < tileCount; tile++)
+      {
+        ranges[tile * 2] = offset;
+        offset += ranges[tile * 2 + 1];
+        ranges[tile * 2 + 1] = 0;
+      }
+      task.indices.resize(offset);
+      
+      for (size_t c = 0; c < task.candidates.size(); c++)
+      {
+        const glm::ivec4 &rect = task.rects[c];
+        for (int y = rect.y; y <= rect.w; y++)
+        {
+          for (int x = rect.x; x <= rect.z; x++)
+          {
+            unsigned *range = &ranges[(y * m_tilesX + x) * 2];
+            task.indices[range[0] + range[1]++] = task.candidates[c];
+          }
+        }
+      }
+    }
+  }
+  
+  //conservative screen rectangle of the sphere's box clipped to depth
+  //[nearest, farthest]: x / depth is largest at the nearest depth when x is
+  //positive and at the farthest when it is negative. false when off screen
+  bool TileRect(const glm::vec4 &light, float nearest, float farthest, glm::ivec4 *rect) const
+  {
+    float x0 = light.x - light.w, x1 = light.x + light.w;
+    float y0 = light.y - light.w, y1 = light.y + light.w;
+    
+    float ndcX0 = m_projX * x0 / (x0 < 0 ? nearest : farthest);
+    float ndcX1 = m_projX * x1 / (x1 > 0 ? nearest : farthest);
+    float ndcY0 = m_projY * y0 / (y0 < 0 ? nearest : farthest);
+    float ndcY1 = m_projY * y1 / (y1 > 0 ? nearest : farthest);
+    
+    if (ndcX1 < -1.0f || ndcX0 > 1.0f || ndcY1 < -1.0f || ndcY0 > 1.0f)
+    {
+      return false;
+    }
+    
+    rect->x = glm::clamp((int) floorf((ndcX0 * .5f + .5f) * m_tilesX), 0, m_tilesX - 1);
+    rect->y = glm::clamp((int) floorf((ndcY0 * .5f + .5f) * m_tilesY), 0, m_tilesY - 1);
+    rect->z = glm::clamp((int) floorf((ndcX1 * .5f + .5f) * m_tilesX), 0, m_tilesX - 1);
+    rect->w = glm::clamp((int) floorf((ndcY1 * .5f + .5f) * m_tilesY), 0, m_tilesY - 1);
+    
+    return true;
+  }
+  
+  int m_tilesX, m_tilesY, m_slices;
+  float m_projX, m_projY, m_zNear, m_zFar;
+  
+  const glm::vec4 *m_lights;
+  int m_lightCount;
+  
+  std::vector<BinTask> m_tasks;
+  std::vector<unsigned> m_ranges;
+  std::vector<unsigned> m_indices;
+  int m_indexCount;
+};
+
+#endif
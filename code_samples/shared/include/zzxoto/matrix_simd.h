@@ -0,0 +1,215 @@
+#ifndef H_ZZXOTO_MATRIX_SIMD
+#define H_ZZXOTO_MATRIX_SIMD
+
+//4x4 matrix kernels behind MatrixStack, on the column major floats of a
+//glm::mat4 (glm::value_ptr), so the stack keeps handing out plain glm::mat4.
+//
+//Every kernel comes as a scalar and a SIMD version. The SIMD multiply does one
+//output column per SSE register, or two per AVX register when the compiler
+//targets AVX (/arch:AVX, -mavx). Translate, scale and rotate about Z only
+//touch the columns they change instead of multiplying by a full matrix:
+//
+//  M * translate(t): column3 = column0 * t.x + column1 * t.y + column2 * t.z + column3
+//  M * scale(s):     columnI *= s[i]
+//  M * rotateZ(a):   column0, column1 = column0 * c + column1 * s, column1 * c - column0 * s
+//  M * [r 0; 0 1]:   columnJ = column0 * r[3j] + column1 * r[3j + 1] + column2 * r[3j + 2]
+//
+//The last one takes any 3x3 (rotation from a quaternion, rotation * scale),
+//column major, 9 floats.
+//
+//mat4Multiply & co. pick the SIMD kernels when ZZXOTO_SIMD_MATRIX is defined
+//before this file (or helper.h) is included, the scalar ones otherwise. glm
+//only aligns mat4 to 4 bytes, so all loads and stores are unaligned.
+//
+//No GL dependency.
+
+#include <xmmintrin.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+//out = a * b; out may be a or b
+void mat4MultiplyScalar(const float *a, const float *b, float *out)
+{
+  float result[16];
+  for (int column = 0; column < 4; column++)
+  {
+    for (int row = 0; row < 4; row++)
+    {
+      result[column * 4 + row] = a[row] * b[column * 4] + a[4 + row] * b[column * 4 + 1] +
+                                 a[8 + row] * b[column * 4 + 2] + a[12 + row] * b[column * 4 + 3];
+    }
+  }
+  for (int i = 0; i < 16; i++)
+  {
+    out[i] = result[i];
+  }
+}
+
+void mat4MultiplySimd(const float *a, const float *b, float *out)
+{
+#if defined(__AVX__)
+  //both 128 bit halves hold the same column of a, each half makes one column of out
+  __m256 a0 = _mm256_broadcast_ps((const __m128 *) (a + 0));
+  __m256 a1 = _mm256_broadcast_ps((const __m128 *) (a + 4));
+  __m256 a2 = _mm256_broadcast_ps((const __m128 *) (a + 8));
+  __m256 a3 = _mm256_broadcast_ps((const __m128 *) (a + 12));
+  for (int column = 0; column < 4; column += 2)
+  {
+    __m256 bColumns = _mm256_loadu_ps(b + column * 4);
+    __m256 result = _mm256_mul_ps(a0, _mm256_shuffle_ps(bColumns, bColumns, 0x00));
+    result = _mm256_add_ps(result, _mm256_mul_ps(a1, _mm256_shuffle_ps(bColumns, bColumns, 0x55)));
+    result = _mm256_add_ps(result, _mm256_mul_ps(a2, _mm256_shuffle_ps(bColumns, bColumns, 0xaa)));
+    result = _mm256_add_ps(result, _mm256_mul_ps(a3, _mm256_shuffle_ps(bColumns, bColumns, 0xff)));
+    _mm256_storeu_ps(out + column * 4, result);
+  }
+#else
+  __m128 a0 = _mm_loadu_ps(a + 0);
+  __m128 a1 = _mm_loadu_ps(a + 4);
+  __m128 a2 = _mm_loadu_ps(a + 8);
+  __m128 a3 = _mm_loadu_ps(a + 12);
+  for (int column = 0; column < 4; column++)
+  {
+    __m128 bColumn = _mm_loadu_ps(b + column * 4);
+    __m128 result = _mm_mul_ps(a0, _mm_shuffle_ps(bColumn, bColumn, 0x00));
+    result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_shuffle_ps(bColumn, bColumn, 0x55)));
+    result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_shuffle_ps(bColumn, bColumn, 0xaa)));
+    result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_shuffle_ps(bColumn, bColumn, 0xff)));
+    _mm_storeu_ps(out + column * 4, result);
+  }
+#endif
+}
+
+void mat4TranslateScalar(float *m, float tx, float ty, float tz)
+{
+  for (int row = 0; row < 4; row++)
+  {
+    m[12 + row] += m[row] * tx + m[4 + row] * ty + m[8 + row] * tz;
+  }
+}
+
+void mat4TranslateSimd(float *m, float tx, float ty, float tz)
+{
+  __m128 column3 = _mm_loadu_ps(m + 12);
+  column3 = _mm_add_ps(column3, _mm_mul_ps(_mm_loadu_ps(m + 0), _mm_set1_ps(tx)));
+  column3 = _mm_add_ps(column3, _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_set1_ps(ty)));
+  column3 = _mm_add_ps(column3, _mm_mul_ps(_mm_loadu_ps(m + 8), _mm_set1_ps(tz)));
+  _mm_storeu_ps(m + 12, column3);
+}
+
+void mat4ScaleScalar(float *m, float sx, float sy, float sz)
+{
+  for (int row = 0; row < 4; row++)
+  {
+    m[row] *= sx;
+    m[4 + row] *= sy;
+    m[8 + row] *= sz;
+  }
+}
+
+void mat4ScaleSimd(float *m, float sx, float sy, float sz)
+{
+  _mm_storeu_ps(m + 0, _mm_mul_ps(_mm_loadu_ps(m + 0), _mm_set1_ps(sx)));
+  _mm_storeu_ps(m + 4, _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_set1_ps(sy)));
+  _mm_storeu_ps(m + 8, _mm_mul_ps(_mm_loadu_ps(m + 8), _mm_set1_ps(sz)));
+}
+
+//c, s: cosine and sine of the angle
+void mat4RotateZScalar(float *m, float c, float s)
+{
+  for (int row = 0; row < 4; row++)
+  {
+    float column0 = m[row];
+    float column1 = m[4 + row];
+    m[row] = column0 * c + column1 * s;
+    m[4 + row] = column1 * c - column0 * s;
+  }
+}
+
+void mat4RotateZSimd(float *m, float c, float s)
+{
+  __m128 column0 = _mm_loadu_ps(m + 0);
+  __m128 column1 = _mm_loadu_ps(m + 4);
+  __m128 cosine = _mm_set1_ps(c);
+  __m128 sine = _mm_set1_ps(s);
+  _mm_storeu_ps(m + 0, _mm_add_ps(_mm_mul_ps(column0, cosine), _mm_mul_ps(column1, sine)));
+  _mm_storeu_ps(m + 4, _mm_sub_ps(_mm_mul_ps(column1, cosine), _mm_mul_ps(column0, sine)));
+}
+
+//r: column major 3x3, applied to the upper left of m
+void mat4Multiply3x3Scalar(float *m, const float *r)
+{
+  float result[12];
+  for (int column = 0; column < 3; column++)
+  {
+    for (int row = 0; row < 4; row++)
+    {
+      result[column * 4 + row] = m[row] * r[column * 3] + m[4 + row] * r[column * 3 + 1] + m[8 + row] * r[column * 3 + 2];
+    }
+  }
+  for (int i = 0; i < 12; i++)
+  {
+    m[i] = result[i];
+  }
+}
+
+void mat4Multiply3x3Simd(float *m, const float *r)
+{
+  __m128 column0 = _mm_loadu_ps(m + 0);
+  __m128 column1 = _mm_loadu_ps(m + 4);
+  __m128 column2 = _mm_loadu_ps(m + 8);
+  for (int column = 0; column < 3; column++)
+  {
+    __m128 result = _mm_mul_ps(column0, _mm_set1_ps(r[column * 3]));
+    result = _mm_add_ps(result, _mm_mul_ps(column1, _mm_set1_ps(r[column * 3 + 1])));
+    result = _mm_add_ps(result, _mm_mul_ps(column2, _mm_set1_ps(r[column * 3 + 2])));
+    _mm_storeu_ps(m + column * 4, result);
+  }
+}
+
+void mat4Multiply(const float *a, const float *b, float *out)
+{
+#ifdef ZZXOTO_SIMD_MATRIX
+  mat4MultiplySimd(a, b, out);
+#else
+  mat4MultiplyScalar(a, b, out);
+#endif
+}
+
+void mat4Translate(float *m, float tx, float ty, float tz)
+{
+#ifdef ZZXOTO_SIMD_MATRIX
+  mat4TranslateSimd(m, tx, ty, tz);
+#else
+  mat4TranslateScalar(m, tx, ty, tz);
+#endif
+}
+
+void mat4Scale(float *m, float sx, float sy, float sz)
+{
+#ifdef ZZXOTO_SIMD_MATRIX
+  mat4ScaleSimd(m, sx, sy, sz);
+#else
+  mat4ScaleScalar(m, sx, sy, sz);
+#endif
+}
+
+void mat4RotateZ(float *m, float c, float s)
+{
+#ifdef ZZXOTO_SIMD_MATRIX
+  mat4RotateZSimd(m, c, s);
+#else
+  mat4RotateZScalar(m, c, s);
+#endif
+}
+
+void mat4Multiply3x3(float *m, const float *r)
+{
+#ifdef ZZXOTO_SIMD_MATRIX
+  mat4Multiply3x3Simd(m, r);
+#else
+  mat4Multiply3x3Scalar(m, r);
+#endif
+}
+
+#endif
@@ -0,0 +1,281 @@
+#ifndef H_ZZXOTO_MESH_FILE
+#define H_ZZXOTO_MESH_FILE
+
+//Binary mesh container, written by obj_to_mesh and read by memory mapping the
+//file. Everything is little endian and laid out so the vertex and index blobs
+//can go straight from the mapping into glBufferData.
+//
+//  MeshFileHeader
+//  MeshFileAttribute[attributeCount]   vertex layout descriptor
+//  vertex blob                         vertexCount * stride, at vertexOffset
+//  index blob                          indexCount * indexSize, at indexOffset
+//
+//blob offsets are 16 byte aligned. openMeshFile checks the header and the
+//attribute table against the file before anything points into it.
+//
+//No GL dependency; meshFileIndexType is in vertex_layout_gl.h.
+
+#include <stdio.h>
+#include <string.h>
+#include "zzxoto/vertex_layout.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const char MESH_FILE_MAGIC[4] = {'Z', 'M', 'S', 'H'};
+static const unsigned MESH_FILE_VERSION = 1;
+static const int MESH_FILE_ATTRIBUTE_NAME_LENGTH = 24;
+
+typedef struct MeshFileHeader
+{
+  char magic[4];
+  unsigned version;
+  unsigned vertexCount;
+  unsigned indexCount;
+  unsigned indexSize;       //2 or 4
+  unsigned stride;
+  unsigned attributeCount;
+  unsigned vertexOffset;
+  unsigned indexOffset;
+  float boundsMin[3];
+  float boundsMax[3];
+} MeshFileHeader;
+
+typedef struct MeshFileAttribute
+{
+  char name[MESH_FILE_ATTRIBUTE_NAME_LENGTH];   //null terminated
+  unsigned format;                              //VertexFormat
+  unsigned offset;
+} MeshFileAttribute;
+
+typedef struct MappedFile
+{
+  const unsigned char *data;
+  size_t size;
+#ifdef _WIN32
+  HANDLE file;
+  HANDLE mapping;
+#endif
+} MappedFile;
+
+bool mapFile(const char *path, MappedFile *mapped)
+{
+  mapped->data = NULL;
+  mapped->size = 0;
+
+#ifdef _WIN32
+  mapped->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                             FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (mapped->file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+  
+  LARGE_INTEGER size;
+  GetFileSizeEx(mapped->file, &size);
+  mapped->size = (size_t) size.QuadPart;
+  
+  mapped->mapping = CreateFileMappingA(mapped->file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapped->mapping == NULL)
+  {
+    CloseHandle(mapped->file);
+    return false;
+  }
+  
+  mapped->data = (const unsigned char *) MapViewOfFile(mapped->mapping, FILE_MAP_READ, 0, 0, 0);
+  if (mapped->data == NULL)
+  {
+    CloseHandle(mapped->mapping);
+    CloseHandle(mapped->file);
+    return false;
+  }
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+  
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0)
+  {
+    close(fd);
+    return false;
+  }
+  mapped->size = (size_t) st.st_size;
+  
+  void *data = mmap(NULL, mapped->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+  {
+    return false;
+  }
+  
+  //the upload reads the blobs front to back exactly once
+  madvise(data, mapped->size, MADV_SEQUENTIAL);
+  madvise(data, mapped->size, MADV_WILLNEED);
+  mapped->data = (const unsigned char *) data;
+#endif
+  
+  return true;
+}
+
+void unmapFile(MappedFile *mapped)
+{
+  if (mapped->data)
+  {
+#ifdef _WIN32
+    UnmapViewOfFile(mapped->data);
+    CloseHandle(mapped->mapping);
+    CloseHandle(mapped->file);
+#else
+    munmap((void *) mapped->data, mapped->size);
+#endif
+  }
+  mapped->data = NULL;
+  mapped->size = 0;
+}
+
+//a mapped mesh file; every pointer points into the mapping and stays valid
+//until closeMeshFile
+typedef struct MeshFile
+{
+  MappedFile mapped;
+  const MeshFileHeader *header;
+  VertexLayout layout;
+  const void *vertices;
+  const void *indices;
+} MeshFile;
+
+bool openMeshFile(const char *path, MeshFile *mesh)
+{
+  if (!mapFile(path, &mesh->mapped))
+  {
+    printf("Failed to open mesh file %s\n", path);
+    return false;
+  }
+  
+  const unsigned char *data = mesh->mapped.data;
+  size_t size = mesh->mapped.size;
+  const MeshFileHeader *header = (const MeshFileHeader *) data;
+  
+  bool valid = size >= sizeof(MeshFileHeader)
+    && memcmp(header->magic, MESH_FILE_MAGIC, 4) == 0
+    && header->version == MESH_FILE_VERSION
+    && (header->indexSize == 2 || header->indexSize == 4)
+    && header->attributeCount <= (unsigned) VERTEX_LAYOUT_MAX_ATTRIBUTES
+    && sizeof(MeshFileHeader) + header->attributeCount * sizeof(MeshFileAttribute) <= size
+    && (size_t) header->vertexOffset + (size_t) header->vertexCount * header->stride <= size
+    && (size_t) header->indexOffset + (size_t) header->indexCount * header->indexSize <= size;
+  
+  //every attribute a known format inside the stride, with its name
+  //terminated inside the name field
+  const MeshFileAttribute *attributes = (const MeshFileAttribute *) (header + 1);
+  for (unsigned i = 0; valid && i < header->attributeCount; i++)
+  {
+    const MeshFileAttribute &attribute = attributes[i];
+    valid = attribute.format < (unsigned) VERTEX_FORMAT_COUNT
+      && (size_t) attribute.offset + g_vertexFormatInfo[attribute.format].size <= header->stride
+      && memchr(attribute.name, '\0', MESH_FILE_ATTRIBUTE_NAME_LENGTH) != NULL;
+  }
+  
+  if (!valid)
+  {
+    printf("Invalid mesh file %s\n", path);
+    unmapFile(&mesh->mapped);
+    return false;
+  }
+  
+  mesh->layout = makeVertexLayout();
+  for (unsigned i = 0; i < header->attributeCount; i++)
+  {
+    VertexAttribute &attribute = mesh->layout.attributes[i];
+    attribute.name = attributes[i].name;
+    attribute.format = (VertexFormat) attributes[i].format;
+    attribute.offset = attributes[i].offset;
+  }
+  mesh->layout.attributeCount = header->attributeCount;
+  mesh->layout.stride = header->stride;
+  
+  mesh->header = header;
+  mesh->vertices = data + header->vertexOffset;
+  mesh->indices = data + header->indexOffset;
+  
+  return true;
+}
+
+void closeMeshFile(MeshFile *mesh)
+{
+  unmapFile(&mesh->mapped);
+  mesh->header = NULL;
+  mesh->vertices = NULL;
+  mesh->indices = NULL;
+}
+
+static unsigned alignMeshFileOffset(size_t offset)
+{
+  return (unsigned) ((offset + 15) & ~(size_t) 15);
+}
+
+bool writeMeshFile(const char *path, const VertexLayout &layout,
+                   const void *vertices, int vertexCount,
+                   const void *indices, int indexCount, int indexSize,
+                   const float boundsMin[3], const float boundsMax[3])
+{
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL)
+  {
+    printf("Failed to write mesh file %s\n", path);
+    return false;
+  }
+  
+  MeshFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MESH_FILE_MAGIC, 4);
+  header.version = MESH_FILE_VERSION;
+  header.vertexCount = vertexCount;
+  header.indexCount = indexCount;
+  header.indexSize = indexSize;
+  header.stride = layout.stride;
+  header.attributeCount = layout.attributeCount;
+  header.vertexOffset = alignMeshFileOffset(sizeof(MeshFileHeader) + layout.attributeCount * sizeof(MeshFileAttribute));
+  header.indexOffset = alignMeshFileOffset(header.vertexOffset + (size_t) vertexCount * layout.stride);
+  memcpy(header.boundsMin, boundsMin, sizeof(header.boundsMin));
+  memcpy(header.boundsMax, boundsMax, sizeof(header.boundsMax));
+  
+  fwrite(&header, sizeof(header), 1, fp);
+  for (int i = 0; i < layout.attributeCount; i++)
+  {
+    MeshFileAttribute attribute;
+    memset(&attribute, 0, sizeof(attribute));
+    strncpy(attribute.name, layout.attributes[i].name, MESH_FILE_ATTRIBUTE_NAME_LENGTH - 1);
+    attribute.format = layout.attributes[i].format;
+    attribute.offset = layout.attributes[i].offset;
+    fwrite(&attribute, sizeof(attribute), 1, fp);
+  }
+  
+  static const char zeros[16] = {};
+  long at = ftell(fp);
+  fwrite(zeros, 1, header.vertexOffset - at, fp);
+  fwrite(vertices, layout.stride, vertexCount, fp);
+  
+  at = ftell(fp);
+  fwrite(zeros, 1, header.indexOffset - at, fp);
+  fwrite(indices, indexSize, indexCount, fp);
+  
+  bool result = ferror(fp) == 0;
+  fclose(fp);
+  
+  return result;
+}
+
+#endif
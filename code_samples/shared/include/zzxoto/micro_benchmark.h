@@ -0,0 +1,210 @@
+#ifndef H_ZZXOTO_MICRO_BENCHMARK
+#define H_ZZXOTO_MICRO_BENCHMARK
+
+//Timing for operations of a few nanoseconds, e.g. one matrix multiply:
+//
+//  MicroBenchmarkReport report;
+//  report.Add("math", "glm mat4 * vec4", runMicroBenchmark([&](int i)
+//  {
+//    microBenchmarkKeep(m * v[i & 1023]);
+//  }));
+//  report.Print();
+//  report.WriteJson("build/math.json");
+//
+//One sample calls the operation opsPerSample times in a loop and times the
+//whole loop. opsPerSample is doubled until a sample takes ~200 us, so clock
+//resolution and the loop are noise; a few warmup samples then fill caches
+//and wake the CPU from idle clocks. The result of 31 samples is the median
+//time per operation, and the median absolute deviation (MAD) of the samples
+//from it as the spread: both ignore the odd sample hit by an interrupt,
+//unlike mean and standard deviation.
+//
+//Cycles per operation come from the time stamp counter on x86 (__rdtsc).
+//It ticks at a fixed rate, not the core clock, so with turbo they are
+//reference cycles; -1 where there is no TSC.
+//
+//The operation gets the loop index to pick its input, so the compiler can't
+//hoist it out of the loop; pass every result through microBenchmarkKeep so
+//it isn't removed as dead code.
+//
+//No GL dependency.
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ZZXOTO_HAS_RDTSC
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define ZZXOTO_HAS_RDTSC
+#endif
+
+typedef struct MicroBenchmarkStats
+{
+  double medianNs;      //per operation
+  double madNs;         //median absolute deviation of the samples, per operation
+  double minNs;
+  double cyclesPerOp;   //median, -1 without a TSC
+  int samples;
+  int opsPerSample;
+} MicroBenchmarkStats;
+
+static const void *volatile g_microBenchmarkEscape;
+
+//makes all of value look used: its address escapes, so every byte of it has
+//to be computed and in memory here
+template <typename T>
+void microBenchmarkKeep(const T &value)
+{
+#if defined(__GNUC__)
+  __asm__ __volatile__("" : : "r"(&value) : "memory");
+#else
+  g_microBenchmarkEscape = &value;
+  _ReadWriteBarrier();
+#endif
+}
+
+unsigned long long microBenchmarkTicks(void)
+{
+#ifdef ZZXOTO_HAS_RDTSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+double microBenchmarkMedian(std::vector<double> values)
+{
+  std::sort(values.begin(), values.end());
+  size_t n = values.size();
+  
+  return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) * .5;
+}
+
+template <typename Op>
+MicroBenchmarkStats runMicroBenchmark(Op op, int samples = 31, int warmupSamples = 5)
+{
+  typedef std::chrono::steady_clock Clock;
+  const double minSampleNs = 200000;
+  
+  //calibrate: double the ops until one sample is long enough
+  int opsPerSample = 1;
+  for (;;)
+  {
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < opsPerSample; i++)
+    {
+      op(i);
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    if (ns >= minSampleNs || opsPerSample >= (1 << 30))
+    {
+      break;
+    }
+    opsPerSample *= 2;
+  }
+  
+  std::vector<double> nsPerOp, cyclesPerOp;
+  for (int sample = -warmupSamples; sample < samples; sample++)
+  {
+    unsigned long long startTicks = microBenchmarkTicks();
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < opsPerSample; i++)
+    {
+      op(i);
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    unsigned long long ticks = microBenchmarkTicks() - startTicks;
+    
+    if (sample >= 0)
+    {
+      nsPerOp.push_back(ns / opsPerSample);
+      cyclesPerOp.push_back((double) ticks / opsPerSample);
+    }
+  }
+  
+  MicroBenchmarkStats stats;
+  stats.medianNs = microBenchmarkMedian(nsPerOp);
+  std::vector<double> deviations(nsPerOp.size());
+  for (size_t i = 0; i < nsPerOp.size(); i++)
+  {
+    deviations[i] = nsPerOp[i] > stats.medianNs ? nsPerOp[i] - stats.medianNs : stats.medianNs - nsPerOp[i];
+  }
+  stats.madNs = microBenchmarkMedian(deviations);
+  stats.minNs = *std::min_element(nsPerOp.begin(), nsPerOp.end());
+#ifdef ZZXOTO_HAS_RDTSC
+  stats.cyclesPerOp = microBenchmarkMedian(cyclesPerOp);
+#else
+  stats.cyclesPerOp = -1;
+#endif
+  stats.samples = samples;
+  stats.opsPerSample = opsPerSample;
+  
+  return stats;
+}
+
+//collects results, prints them as a table or writes them as JSON
+class MicroBenchmarkReport
+{
+  public:
+  void Add(const char *group, const char *name, const MicroBenchmarkStats &stats)
+  {
+    Entry entry = {group, name, stats};
+    m_entries.push_back(entry);
+  }
+  
+  void Print() const
+  {
+    printf("%-10s %-36s %10s %10s %10s %10s\n", "group", "operation", "median ns", "mad ns", "min ns", "cycles");
+    for (size_t i = 0; i < m_entries.size(); i++)
+    {
+      const Entry &e = m_entries[i];
+      printf("%-10s %-36s %10.2f %10.3f %10.2f %10.1f\n", e.group.c_str(), e.name.c_str(), e.stats.medianNs,
+             e.stats.madNs, e.stats.minNs, e.stats.cyclesPerOp);
+    }
+  }
+  
+  //false if path can't be written
+  bool WriteJson(const char *path) const
+  {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+    {
+      return false;
+    }
+    
+    fprintf(fp, "{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < m_entries.size(); i++)
+    {
+      const Entry &e = m_entries[i];
+      fprintf(fp, "    {\"group\": \"%s\", \"name\": \"%s\", \"medianNs\": %.4f, \"madNs\": %.4f, \"minNs\": %.4f, "
+              "\"cyclesPerOp\": %.2f, \"samples\": %d, \"opsPerSample\": %d}%s\n", e.group.c_str(), e.name.c_str(),
+              e.stats.medianNs, e.stats.madNs, e.stats.minNs, e.stats.cyclesPerOp, e.stats.samples,
+              e.stats.opsPerSample, i + 1 < m_entries.size() ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    fclose(fp);
+    
+    return true;
+  }
+  
+  bool Empty() const
+  {
+    return m_entries.empty();
+  }
+  
+  private:
+  typedef struct Entry
+  {
+    std::string group;
+    std::string name;
+    MicroBenchmarkStats stats;
+  } Entry;
+  
+  std::vector<Entry> m_entries;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef H_ZZXOTO_PNG_FILE
+#define H_ZZXOTO_PNG_FILE
+
+//Minimal PNG writer for frame dumps: 8 bit RGBA, no filtering, and the zlib
+//stream uses stored (uncompressed) deflate blocks. Files are about as big as
+//the raw pixels, but every PNG reader takes them and there is nothing to
+//link.
+//
+//No GL dependency.
+
+#include <stdio.h>
+#include <vector>
+
+//CRC-32 as used by PNG chunks (ISO 3309, reflected 0xEDB88320)
+unsigned pngCrc(const unsigned char *data, size_t size, unsigned crc = 0xFFFFFFFFu)
+{
+  static unsigned table[256];
+  static bool tableReady = false;
+  if (!tableReady)
+  {
+    for (unsigned n = 0; n < 256; n++)
+    {
+      unsigned c = n;
+      for (int k = 0; k < 8; k++)
+      {
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      table[n] = c;
+    }
+    tableReady = true;
+  }
+  
+  for (size_t i = 0; i < size; i++)
+  {
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  
+  return crc;
+}
+
+static void pngPutU32(std::vector<unsigned char> &out, unsigned value)
+{
+  out.push_back((unsigned char) (value >> 24));
+  out.push_back((unsigned char) (value >> 16));
+  out.push_back((unsigned char) (value >> 8));
+  out.push_back((unsigned char) value);
+}
+
+static void pngWriteChunk(FILE *fp, const char *type, const std::vector<unsigned char> &data)
+{
+  std::vector<unsigned char> chunk;
+  pngPutU32(chunk, (unsigned) data.size());
+  chunk.insert(chunk.end(), type, type + 4);
+  chunk.insert(chunk.end(), data.begin(), data.end());
+  
+  //the CRC covers type and data, not the length
+  pngPutU32(chunk, pngCrc(&chunk[4], chunk.size() - 4) ^ 0xFFFFFFFFu);
+  fwrite(&chunk[0], 1, chunk.size(), fp);
+}
+
+//rgba: width * height pixels, rows bottom to top when flipY (glReadPixels
+//order), top to bottom otherwise
+bool writePng(const char *path, int width, int height, const unsigned char *rgba, bool flipY)
+{
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL)
+  {
+    return false;
+  }
+  
+  static const unsigned char signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+  fwrite(signature, 1, 8, fp);
+  
+  std::vector<unsigned char> header;
+  pngPutU32(header, width);
+  pngPutU32(header, height);
+  header.push_back(8);   //bit depth
+  header.push_back(6);   //color type RGBA
+  header.push_back(0);   //deflate
+  header.push_back(0);   //adaptive filtering
+  header.push_back(0);   //no interlace
+  pngWriteChunk(fp, "IHDR", header);
+  
+  //scanlines, each prefixed with filter type 0
+  size_t rowSize = (size_t) width * 4;
+  std::vector<unsigned char> raw;
+  raw.reserve((rowSize + 1) * height);
+  for (int y = 0; y < height; y++)
+  {
+    const unsigned char *row = rgba + rowSize * (flipY ? height - 1 - y : y);
+    raw.push_back(0);
+    raw.insert(raw.end(), row, row + rowSize);
+  }
+  
+  //zlib header, stored blocks of at most 65535 bytes, adler-32
+  std::vector<unsigned char> zlib;
+  zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+  zlib.push_back(0x78);
+  zlib.push_back(0x01);
+  size_t offset = 0;
+  do
+  {
+    size_t blockSize = raw.size() - offset < 65535 ? raw.size() - offset : 65535;
+    bool last = offset + blockSize == raw.size();
+    zlib.push_back(last ? 1 : 0);
+    zlib.push_back((unsigned char) blockSize);
+    zlib.push_back((unsigned char) (blockSize >> 8));
+    zlib.push_back((unsigned char) ~blockSize);
+    zlib.push_back((unsigned char) (~blockSize >> 8));
+    zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+    offset += blockSize;
+  } while (offset < raw.size());
+  
+  unsigned a = 1, b = 0;
+  for (size_t i = 0; i < raw.size(); i++)
+  {
+    a = (a + raw[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  pngPutU32(zlib, (b << 16) | a);
+  pngWriteChunk(fp, "IDAT", zlib);
+  
+  pngWriteChunk(fp, "IEND", std::vector<unsigned char>());
+  
+  bool success = ferror(fp) == 0;
+  fclose(fp);
+  
+  return success;
+}
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef H_ZZXOTO_PROFILER
+#define H_ZZXOTO_PROFILER
+
+//Scoped CPU profiler, the same RAII idea as PushStack: a scope object takes
+//a timestamp when it is created and records (name, begin, end) when it goes
+//out of scope.
+//
+//  void display()
+//  {
+//    PROFILE_FUNCTION();
+//    {
+//      PROFILE_SCOPE("record");
+//      ...
+//    }
+//  }
+//  PROFILE_WRITE_TRACE("build/trace.json");   //open in chrome://tracing
+//
+//Every thread records into its own ring buffer, so recording takes no lock:
+//one timestamp at each end and a few stores. On x86 the timestamp is the
+//TSC (a steady_clock read costs about as much as the whole scope budget);
+//it is calibrated against steady_clock when the trace is written, which
+//assumes an invariant TSC, true on any recent x86 CPU.
+//
+//When a ring is full the oldest events are overwritten. The buffer is
+//registered (under a mutex) the first time a thread records.
+//
+//Only compiled in with ZZXOTO_PROFILE defined; otherwise the macros expand
+//to nothing and cost nothing. Names must be string literals (or live as long
+//as the program). Write the trace while the other threads are idle.
+//
+//No GL dependency.
+
+#ifdef ZZXOTO_PROFILE
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ZZXOTO_THREAD_LOCAL __declspec(thread)
+#define ZZXOTO_PROFILER_TSC
+#else
+#define ZZXOTO_THREAD_LOCAL __thread
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ZZXOTO_PROFILER_TSC
+#endif
+#endif
+
+static const unsigned PROFILER_RING_SIZE = 1 << 16;   //events per thread, power of 2
+
+typedef struct ProfileEvent
+{
+  const char *name;
+  long long begin;    //profilerNow ticks
+  long long end;
+} ProfileEvent;
+
+typedef struct ProfilerThreadBuffer
+{
+  ProfileEvent events[PROFILER_RING_SIZE];
+  std::atomic<unsigned> head;   //events ever written; only the owning thread writes
+  int threadIndex;
+} ProfilerThreadBuffer;
+
+typedef struct Profiler
+{
+  std::mutex mutex;
+  std::vector<ProfilerThreadBuffer *> threads;
+} Profiler;
+
+static Profiler g_profiler;
+static ZZXOTO_THREAD_LOCAL ProfilerThreadBuffer *g_profilerThreadBuffer;
+
+static long long profilerNow()
+{
+#ifdef ZZXOTO_PROFILER_TSC
+  return (long long) __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+//profilerNow ticks per microsecond; the TSC rate is measured over 20 ms
+static double profilerTicksPerUs()
+{
+#ifdef ZZXOTO_PROFILER_TSC
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  long long startTicks = profilerNow();
+  double us = 0;
+  while (us < 20000.0)
+  {
+    us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  }
+  
+  return (profilerNow() - startTicks) / us;
+#else
+  return 1e-6 * std::chrono::steady_clock::period::den / std::chrono::steady_clock::period::num;
+#endif
+}
+
+//slow path, once per thread
+static ProfilerThreadBuffer *profilerRegisterThread()
+{
+  ProfilerThreadBuffer *buffer = new ProfilerThreadBuffer;
+  buffer->head.store(0);
+  
+  std::lock_guard<std::mutex> lock(g_profiler.mutex);
+  buffer->threadIndex = (int) g_profiler.threads.size();
+  g_profiler.threads.push_back(buffer);
+  g_profilerThreadBuffer = buffer;
+  
+  return buffer;
+}
+
+class ProfileScope
+{
+  public:
+  ProfileScope(const char *name)
+    :m_name(name), m_begin(profilerNow())
+  {
+  }
+  
+  ~ProfileScope()
+  {
+    long long end = profilerNow();
+    ProfilerThreadBuffer *buffer = g_profilerThreadBuffer;
+    if (buffer == NULL)
+    {
+      buffer = profilerRegisterThread();
+    }
+    
+    unsigned head = buffer->head.load(std::memory_order_relaxed);
+    ProfileEvent &event = buffer->events[head & (PROFILER_RING_SIZE - 1)];
+    event.name = m_name;
+    event.begin = m_begin;
+    event.end = end;
+    
+    //publishes the event to the thread writing the trace
+    buffer->head.store(head + 1, std::memory_order_release);
+  }
+  
+  private:
+  const char *m_name;
+  long long m_begin;
+};
+
+//Chrome trace event format, complete ("X") events in microseconds
+bool profilerWriteChromeTrace(const char *path)
+{
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL)
+  {
+    printf("profiler: could not write %s\n", path);
+    return false;
+  }
+  
+  double toUs = 1.0 / profilerTicksPerUs();
+  
+  std::lock_guard<std::mutex> lock(g_profiler.mutex);
+  
+  //timestamps start at the earliest event
+  long long epoch = 0;
+  bool haveEpoch = false;
+  for (size_t t = 0; t < g_profiler.threads.size(); t++)
+  {
+    ProfilerThreadBuffer *buffer = g_profiler.threads[t];
+    unsigned head = buffer->head.load(std::memory_order_acquire);
+    unsigned count = head < PROFILER_RING_SIZE ? head : PROFILER_RING_SIZE;
+    for (unsigned i = head - count; i != head; i++)
+    {
+      long long begin = buffer->events[i & (PROFILER_RING_SIZE - 1)].begin;
+      epoch = haveEpoch && epoch < begin ? epoch : begin;
+      haveEpoch = true;
+    }
+  }
+  
+  fprintf(fp, "{\"traceEvents\":[\n");
+  bool first = true;
+  int eventCount = 0;
+  for (size_t t = 0; t < g_profiler.threads.size(); t++)
+  {
+    ProfilerThreadBuffer *buffer = g_profiler.threads[t];
+    unsigned head = buffer->head.load(std::memory_order_acquire);
+    unsigned count = head < PROFILER_RING_SIZE ? head : PROFILER_RING_SIZE;
+    
+    for (unsigned i = head - count; i != head; i++)
+    {
+      const ProfileEvent &event = buffer->events[i & (PROFILER_RING_SIZE - 1)];
+      fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+              first ? "" : ",\n", event.name, buffer->threadIndex,
+              (event.begin - epoch) * toUs, (event.end - event.begin) * toUs);
+      first = false;
+      eventCount++;
+    }
+  }
+  fprintf(fp, "\n]}\n");
+  fclose(fp);
+  printf("profiler: %d events from %d threads written to %s\n", eventCount, (int) g_profiler.threads.size(), path);
+  
+  return true;
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_WRITE_TRACE(path) profilerWriteChromeTrace(path)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_WRITE_TRACE(path)
+
+#endif
+
+#endif
@@ -0,0 +1,553 @@
+#ifndef H_ZZXOTO_PROGRAM_REFLECTION
+#define H_ZZXOTO_PROGRAM_REFLECTION
+
+//Everything a linked program exposes - active uniforms, uniform blocks and
+//attributes - enumerated once, right after linking, into perfect hash tables.
+//A lookup is two hashes (bucket, then slot), one table slot and one strcmp;
+//no GL call.
+//
+//Uniform setters keep a shadow copy of each uniform's last value and skip the
+//glUniform call when the new value is identical. Like glUniform itself they
+//write to the program in use, so the caller binds it first.
+//
+//Reflect also registers the reflection so findProgramReflection can map a
+//program name back to it (CommandBuffer replay does this).
+//
+//NOTE: expects GL/glew.h to be included before this file.
+
+#include <assert.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+//FNV-1a with a seed, for the perfect hash. The low bits of plain FNV only
+//depend on the low bits of the seed, so the murmur3 finalizer mixes the high
+//bits down before the table masks them off
+unsigned hashName(const char *name, unsigned seed)
+{
+  unsigned hash = 2166136261u ^ (seed * 16777619u);
+  for (const char *c = name; *c; c++)
+  {
+    hash ^= (unsigned char) *c;
+    hash *= 16777619u;
+  }
+  
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bu;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35u;
+  hash ^= hash >> 16;
+  
+  return hash;
+}
+
+//hash and displace (Belazzougui, Botelho, Dietzfelbinger - "Hash, displace,
+//and compress", 2009): names are grouped into buckets by hashName(name, 0);
+//per bucket, biggest first, search the seed that drops all of its names into
+//free slots. Lookup: slot = hashName(name, seed[bucket]) & mask
+class PerfectHashTable
+{
+  public:
+  PerfectHashTable()
+    :m_mask(0)
+  {
+  }
+  
+  //`names` must outlive the table and be unique: equal names hash to the
+  //same slot for every seed, so they could never both be placed. A
+  //duplicate asserts, and in release builds only its first occurrence is
+  //found
+  void Build(const std::vector<const char *> &names)
+  {
+    m_names = names;
+    
+    int slotCount = 1;
+    while (slotCount < (int) names.size())
+    {
+      slotCount *= 2;
+    }
+    m_mask = slotCount - 1;
+    m_slots.assign(slotCount, -1);
+    m_seeds.assign(slotCount, 0);
+    
+    std::vector<std::vector<int> > buckets(slotCount);
+    for (int i = 0; i < (int) names.size(); i++)
+    {
+      //equal names share a bucket, so that is the only place to look
+      std::vector<int> &bucket = buckets[hashName(names[i], 0) & m_mask];
+      bool duplicate = false;
+      for (size_t k = 0; k < bucket.size() && !duplicate; k++)
+      {
+        duplicate = strcmp(names[bucket[k]], names[i]) == 0;
+      }
+      assert(!duplicate && "PerfectHashTable names must be unique");
+      if (!duplicate)
+      {
+        bucket.push_back(i);
+      }
+    }
+    
+    std::vector<int> order;
+    for (int b = 0; b < slotCount; b++)
+    {
+      order.push_back(b);
+    }
+    for (int i = 1; i < slotCount; i++)
+    {
+      //insertion sort by bucket size, descending; tables are small
+      for (int j = i; j > 0 && buckets[order[j]].size() > buckets[order[j - 1]].size(); j--)
+      {
+        int swap = order[j];
+        order[j] = order[j - 1];
+        order[j - 1] = swap;
+      }
+    }
+    
+    std::vector<int> placed;
+    for (int o = 0; o < slotCount; o++)
+    {
+      const std::vector<int> &bucket = buckets[order[o]];
+      if (bucket.empty())
+      {
+        break;
+      }
+      
+      for (unsigned seed = 1;; seed++)
+      {
+        placed.clear();
+        bool fits = true;
+        for (size_t k = 0; k < bucket.size() && fits; k++)
+        {
+          int slot = hashName(names[bucket[k]], seed) & m_mask;
+          fits = m_slots[slot] == -1;
+          for (size_t p = 0; p < placed.size() && fits; p++)
+          {
+            fits = placed[p] != slot;
+          }
+          placed.push_back(slot);
+        }
+        
+        if (fits)
+        {
+          for (size_t k = 0; k < bucket.size(); k++)
+          {
+            m_slots[placed[k]] = bucket[k];
+          }
+          m_seeds[order[o]] = seed;
+          break;
+        }
+      }
+    }
+  }
+  
+  //index into the names given to Build, or -1
+  int Find(const char *name) const
+  {
+    if (m_names.empty())
+    {
+      return -1;
+    }
+    
+    unsigned seed = m_seeds[hashName(name, 0) & m_mask];
+    int index = m_slots[hashName(name, seed) & m_mask];
+    
+    return index >= 0 && strcmp(m_names[index], name) == 0 ? index : -1;
+  }
+  
+  private:
+  std::vector<const char *> m_names;
+  std::vector<int> m_slots;
+  std::vector<unsigned> m_seeds;
+  unsigned m_mask;
+};
+
+//bytes of one element of a uniform of this type; samplers and ints are 4
+unsigned uniformTypeSize(GLenum type)
+{
+  switch(type)
+  {
+    case GL_FLOAT_VEC2:
+    case GL_INT_VEC2:
+    case GL_UNSIGNED_INT_VEC2:
+    case GL_BOOL_VEC2:
+    {
+      return 8;
+    }
+    case GL_FLOAT_VEC3:
+    case GL_INT_VEC3:
+    case GL_UNSIGNED_INT_VEC3:
+    case GL_BOOL_VEC3:
+    {
+      return 12;
+    }
+    case GL_FLOAT_VEC4:
+    case GL_INT_VEC4:
+    case GL_UNSIGNED_INT_VEC4:
+    case GL_BOOL_VEC4:
+    case GL_FLOAT_MAT2:
+    {
+      return 16;
+    }
+    case GL_FLOAT_MAT3:
+    {
+      return 36;
+    }
+    case GL_FLOAT_MAT4:
+    {
+      return 64;
+    }
+  }
+  
+  return 4;
+}
+
+typedef struct ReflectedUniform
+{
+  std::string name;       //array uniforms without the "[0]"
+  GLint location;
+  GLenum type;
+  GLint arraySize;
+  unsigned shadowOffset;  //into the shadow copy, shadowSize bytes
+  unsigned shadowSize;
+  bool shadowValid;       //false until the first upload
+} ReflectedUniform;
+
+typedef struct ReflectedBlock
+{
+  std::string name;
+  GLuint index;
+  GLint dataSize;
+} ReflectedBlock;
+
+typedef struct ReflectedAttribute
+{
+  std::string name;
+  GLint location;
+  GLenum type;
+} ReflectedAttribute;
+
+class ProgramReflection;
+static std::vector<ProgramReflection *> g_programReflections;
+
+class ProgramReflection
+{
+  public:
+  ProgramReflection()
+    :m_program(0), m_uploadCount(0), m_skippedCount(0)
+  {
+  }
+  
+  ~ProgramReflection()
+  {
+    Unregister();
+  }
+  
+  void Reflect(GLuint program)
+  {
+    m_program = program;
+    m_uniforms.clear();
+    m_blocks.clear();
+    m_attributes.clear();
+    
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    std::vector<char> name(glm::max(maxLength, 1));
+    unsigned shadowSize = 0;
+    for (GLint i = 0; i < count; i++)
+    {
+      ReflectedUniform uniform;
+      glGetActiveUniform(program, i, (GLsizei) name.size(), NULL, &uniform.arraySize, &uniform.type, &name[0]);
+      uniform.location = glGetUniformLocation(program, &name[0]);
+      if (uniform.location < 0)
+      {
+        //block members are set through their buffer
+        continue;
+      }
+      
+      //only the trailing "[0]" GL gives arrays of basic types; members of
+      //struct arrays (lights[0].color, lights[1].color) keep their indices
+      uniform.name = &name[0];
+      size_t length = uniform.name.size();
+      if (length > 3 && uniform.name.compare(length - 3, 3, "[0]") == 0)
+      {
+        uniform.name.resize(length - 3);
+      }
+      uniform.shadowOffset = shadowSize;
+      uniform.shadowSize = uniformTypeSize(uniform.type) * uniform.arraySize;
+      uniform.shadowValid = false;
+      shadowSize += (uniform.shadowSize + 3) & ~3u;
+      m_uniforms.push_back(uniform);
+    }
+    m_shadow.assign(glm::max(shadowSize, 4u), 0);
+    
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    name.resize(glm::max(maxLength, 1));
+    for (GLint i = 0; i < count; i++)
+    {
+      ReflectedBlock block;
+      glGetActiveUniformBlockName(program, i, (GLsizei) name.size(), NULL, &name[0]);
+      glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.dataSize);
+      block.name = &name[0];
+      block.index = i;
+      m_blocks.push_back(block);
+    }
+    
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+    name.resize(glm::max(maxLength, 1));
+    for (GLint i = 0; i < count; i++)
+    {
+      ReflectedAttribute attribute;
+      GLint size;
+      glGetActiveAttrib(program, i, (GLsizei) name.size(), NULL, &size, &attribute.type, &name[0]);
+      attribute.name = &name[0];
+      attribute.location = glGetAttribLocation(program, &name[0]);
+      m_attributes.push_back(attribute);
+    }
+    
+    //names point into the vectors above, which no longer change
+    std::vector<const char *> names;
+    for (size_t i = 0; i < m_uniforms.size(); i++)
+    {
+      names.push_back(m_uniforms[i].name.c_str());
+    }
+    m_uniformTable.Build(names);
+    
+    names.clear();
+    for (size_t i = 0; i < m_blocks.size(); i++)
+    {
+      names.push_back(m_blocks[i].name.c_str());
+    }
+    m_blockTable.Build(names);
+    
+    names.clear();
+    for (size_t i = 0; i < m_attributes.size(); i++)
+    {
+      names.push_back(m_attributes[i].name.c_str());
+    }
+    m_attributeTable.Build(names);
+    
+    //locations are small, a flat array maps them back to uniforms
+    m_uniformAtLocation.clear();
+    for (size_t i = 0; i < m_uniforms.size(); i++)
+    {
+      GLint location = m_uniforms[i].location;
+      if (location >= (GLint) m_uniformAtLocation.size())
+      {
+        m_uniformAtLocation.resize(location + 1, -1);
+      }
+      m_uniformAtLocation[location] = (int) i;
+    }
+    
+    Unregister();
+    g_programReflections.push_back(this);
+  }
+  
+  GLuint Program() const
+  {
+    return m_program;
+  }
+  
+  //uniform index for the setters, -1 if the program has no such uniform
+  int FindUniform(const char *name) const
+  {
+    return m_uniformTable.Find(name);
+  }
+  
+  //-1 for unknown names, like glGetUniformLocation
+  GLint UniformLocation(const char *name) const
+  {
+    int uniform = m_uniformTable.Find(name);
+    return uniform >= 0 ? m_uniforms[uniform].location : -1;
+  }
+  
+  //GL_INVALID_INDEX for unknown names, like glGetUniformBlockIndex
+  GLuint UniformBlockIndex(const char *name) const
+  {
+    int block = m_blockTable.Find(name);
+    return block >= 0 ? m_blocks[block].index : GL_INVALID_INDEX;
+  }
+  
+  GLint AttributeLocation(const char *name) const
+  {
+    int attribute = m_attributeTable.Find(name);
+    return attribute >= 0 ? m_attributes[attribute].location : -1;
+  }
+  
+  int UniformAtLocation(GLint location) const
+  {
+    return location >= 0 && location < (GLint) m_uniformAtLocation.size() ? m_uniformAtLocation[location] : -1;
+  }
+  
+  const ReflectedUniform &Uniform(int uniform) const
+  {
+    return m_uniforms[uniform];
+  }
+  
+  int UniformCount() const
+  {
+    return (int) m_uniforms.size();
+  }
+  
+  void Set(int uniform, GLint value)
+  {
+    if (Changed(uniform, &value, sizeof(value)))
+    {
+      glUniform1i(m_uniforms[uniform].location, value);
+    }
+  }
+  
+  void Set(int uniform, float value)
+  {
+    if (Changed(uniform, &value, sizeof(value)))
+    {
+      glUniform1f(m_uniforms[uniform].location, value);
+    }
+  }
+  
+  void Set(int uniform, const glm::vec2 &value)
+  {
+    if (Changed(uniform, glm::value_ptr(value), sizeof(value)))
+    {
+      glUniform2fv(m_uniforms[uniform].location, 1, glm::value_ptr(value));
+    }
+  }
+  
+  void Set(int uniform, const glm::vec3 &value)
+  {
+    if (Changed(uniform, glm::value_ptr(value), sizeof(value)))
+    {
+      glUniform3fv(m_uniforms[uniform].location, 1, glm::value_ptr(value));
+    }
+  }
+  
+  void Set(int uniform, const glm::vec4 &value)
+  {
+    if (Changed(uniform, glm::value_ptr(value), sizeof(value)))
+    {
+      glUniform4fv(m_uniforms[uniform].location, 1, glm::value_ptr(value));
+    }
+  }
+  
+  void Set(int uniform, const glm::ivec3 &value)
+  {
+    if (Changed(uniform, glm::value_ptr(value), sizeof(value)))
+    {
+      glUniform3iv(m_uniforms[uniform].location, 1, glm::value_ptr(value));
+    }
+  }
+  
+  void Set(int uniform, const glm::mat3 &value)
+  {
+    if (Changed(uniform, glm::value_ptr(value), sizeof(value)))
+    {
+      glUniformMatrix3fv(m_uniforms[uniform].location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+  }
+  
+  void Set(int uniform, const glm::mat4 &value)
+  {
+    if (Changed(uniform, glm::value_ptr(value), sizeof(value)))
+    {
+      glUniformMatrix4fv(m_uniforms[uniform].location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+  }
+  
+  //after the uniforms were changed behind the reflection's back
+  void InvalidateShadow()
+  {
+    for (size_t i = 0; i < m_uniforms.size(); i++)
+    {
+      m_uniforms[i].shadowValid = false;
+    }
+  }
+  
+  int UploadCount() const
+  {
+    return m_uploadCount;
+  }
+  
+  int SkippedCount() const
+  {
+    return m_skippedCount;
+  }
+  
+  private:
+  ProgramReflection(const ProgramReflection &);
+  ProgramReflection &operator=(const ProgramReflection &);
+  
+  //compares against the shadow copy and updates it; false means the upload
+  //can be skipped. Unknown uniforms (-1) are ignored like location -1 in GL
+  bool Changed(int uniform, const void *value, unsigned size)
+  {
+    if (uniform < 0)
+    {
+      return false;
+    }
+    
+    ReflectedUniform &u = m_uniforms[uniform];
+    if (size > u.shadowSize)
+    {
+      //a setter that doesn't match the declared type; let GL report it
+      m_uploadCount++;
+      return true;
+    }
+    
+    unsigned char *shadow = &m_shadow[u.shadowOffset];
+    if (u.shadowValid && memcmp(shadow, value, size) == 0)
+    {
+      m_skippedCount++;
+      return false;
+    }
+    
+    memcpy(shadow, value, size);
+    u.shadowValid = true;
+    m_uploadCount++;
+    
+    return true;
+  }
+  
+  void Unregister()
+  {
+    for (size_t i = 0; i < g_programReflections.size(); i++)
+    {
+      if (g_programReflections[i] == this)
+      {
+        g_programReflections.erase(g_programReflections.begin() + i);
+        break;
+      }
+    }
+  }
+  
+  GLuint m_program;
+  std::vector<ReflectedUniform> m_uniforms;
+  std::vector<ReflectedBlock> m_blocks;
+  std::vector<ReflectedAttribute> m_attributes;
+  PerfectHashTable m_uniformTable;
+  PerfectHashTable m_blockTable;
+  PerfectHashTable m_attributeTable;
+  std::vector<int> m_uniformAtLocation;
+  std::vector<unsigned char> m_shadow;
+  int m_uploadCount;
+  int m_skippedCount;
+};
+
+//the reflection registered for `program`, or NULL
+ProgramReflection *findProgramReflection(GLuint program)
+{
+  for (size_t i = 0; i < g_programReflections.size(); i++)
+  {
+    if (g_programReflections[i]->Program() == program)
+    {
+      return g_programReflections[i];
+    }
+  }
+  
+  return NULL;
+}
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef H_ZZXOTO_QUATERNION_BATCH
+#define H_ZZXOTO_QUATERNION_BATCH
+
+//Interpolating many rotations at once, e.g. every object between its two
+//nearest keyframes. Quaternions are kept as structure of arrays so 4 objects
+//fill one SSE register with no shuffling:
+//
+//  QuaternionArrays from = {fromX, fromY, fromZ, fromW};
+//  QuaternionArrays to = {toX, toY, toZ, toW};
+//  QuaternionArrays out = {outX, outY, outZ, outW};
+//  nlerpQuaternions(from, to, t, count, out);     //t[i] per object
+//  slerpQuaternions(from, to, t, count, out);
+//
+//Both take the shortest path (b is negated when dot(a, b) < 0) and return unit
+//quaternions; out may alias either input. nlerp is a lerp plus a normalize:
+//exact at the keyframes but it speeds up mid way, which is invisible for
+//small steps like one update apart. slerpQuaternions keeps the speed
+//constant without acos/sin by warping t with a polynomial fitted to slerp
+//(Arseny Kapoulkine, "Approximating slerp", 2015) before the nlerp; its angle
+//error is small against glm::slerp, cpu_benchmark's quaternion section
+//prints it. slerpQuaternionsExact is the acos/sin reference.
+//
+//quaternionsFromAxisAngles makes the keyframes out of angles, with all the
+//sines and cosines in one sincosBatch (fast_trig.h).
+//
+//Feed the result to MatrixStackBase::Rotate(glm::quat), which skips the
+//trig too.
+//
+//No GL dependency.
+
+#include <math.h>
+#include <xmmintrin.h>
+#include "zzxoto/fast_trig.h"
+#include "zzxoto/helper.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+typedef struct QuaternionArrays
+{
+  float *x;
+  float *y;
+  float *z;
+  float *w;
+} QuaternionArrays;
+
+//glm::angleAxis(degrees[i], axis i) for every i, axes normalized. out must
+//not alias the axes, out.x holds the half angles on the way
+void quaternionsFromAxisAngles(const float *axisX, const float *axisY, const float *axisZ, const float *degrees,
+                               int count, const QuaternionArrays &out, SincosAccuracy accuracy = SINCOS_PRECISE)
+{
+  for (int i = 0; i < count; i++)
+  {
+    out.x[i] = degrees[i] * (PI / 360.0f);
+  }
+  sincosBatch(out.x, count, out.x, out.w, accuracy);
+  
+  for (int i = 0; i < count; i++)
+  {
+    float halfSine = out.x[i];
+    out.x[i] = axisX[i] * halfSine;
+    out.y[i] = axisY[i] * halfSine;
+    out.z[i] = axisZ[i] * halfSine;
+  }
+}
+
+//shortest path nlerp of two quaternions
+glm::quat nlerp(const glm::quat &a, const glm::quat &b, float t)
+{
+  float sign = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w < 0 ? -1.0f : 1.0f;
+  glm::quat result(a.w + (b.w * sign - a.w) * t, a.x + (b.x * sign - a.x) * t, a.y + (b.y * sign - a.y) * t,
+                   a.z + (b.z * sign - a.z) * t);
+  
+  return glm::normalize(result);
+}
+
+//t remapped so that nlerp follows slerp, d = |dot(a, b)|
+static float slerpCorrectedT(float t, float d)
+{
+  float a = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+  float b = 0.848013f + d * (-1.06021f + d * 0.215638f);
+  float k = a * (t - 0.5f) * (t - 0.5f) + b;
+  
+  return t + t * (t - 0.5f) * (t - 1.0f) * k;
+}
+
+static void lerpQuaternionsScalar(const QuaternionArrays &a, const QuaternionArrays &b, const float *t, int count,
+                                  const QuaternionArrays &out, bool correctT)
+{
+  for (int i = 0; i < count; i++)
+  {
+    float dot = a.x[i] * b.x[i] + a.y[i] * b.y[i] + a.z[i] * b.z[i] + a.w[i] * b.w[i];
+    float sign = dot < 0 ? -1.0f : 1.0f;
+    float ti = correctT ? slerpCorrectedT(t[i], dot * sign) : t[i];
+    
+    float x = a.x[i] + (b.x[i] * sign - a.x[i]) * ti;
+    float y = a.y[i] + (b.y[i] * sign - a.y[i]) * ti;
+    float z = a.z[i] + (b.z[i] * sign - a.z[i]) * ti;
+    float w = a.w[i] + (b.w[i] * sign - a.w[i]) * ti;
+    float inverseLength = 1.0f / sqrtf(x * x + y * y + z * z + w * w);
+    out.x[i] = x * inverseLength;
+    out.y[i] = y * inverseLength;
+    out.z[i] = z * inverseLength;
+    out.w[i] = w * inverseLength;
+  }
+}
+
+//4 quaternions per iteration, the same math as lerpQuaternionsScalar
+static void lerpQuaternionsSse(const QuaternionArrays &a, const QuaternionArrays &b, const float *t, int count,
+                               const QuaternionArrays &out, bool correctT)
+{
+  __m128 signBit = _mm_set1_ps(-.0f);
+  __m128 one = _mm_set1_ps(1.0f);
+  __m128 half = _mm_set1_ps(.5f);
+  
+  int i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 ax = _mm_loadu_ps(a.x + i), ay = _mm_loadu_ps(a.y + i);
+    __m128 az = _mm_loadu_ps(a.z + i), aw = _mm_loadu_ps(a.w + i);
+    __m128 bx = _mm_loadu_ps(b.x + i), by = _mm_loadu_ps(b.y + i);
+    __m128 bz = _mm_loadu_ps(b.z + i), bw = _mm_loadu_ps(b.w + i);
+    __m128 ti = _mm_loadu_ps(t + i);
+    
+    __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+                            _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+    
+    //shortest path: flip b's sign bits by dot's sign bit
+    __m128 sign = _mm_and_ps(dot, signBit);
+    bx = _mm_xor_ps(bx, sign);
+    by = _mm_xor_ps(by, sign);
+    bz = _mm_xor_ps(bz, sign);
+    bw = _mm_xor_ps(bw, sign);
+    
+    if (correctT)
+    {
+      __m128 d = _mm_andnot_ps(signBit, dot);
+      __m128 ka = _mm_add_ps(_mm_set1_ps(3.55645f), _mm_mul_ps(d, _mm_set1_ps(-1.43519f)));
+      ka = _mm_add_ps(_mm_set1_ps(-3.2452f), _mm_mul_ps(d, ka));
+      ka = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(d, ka));
+      __m128 kb = _mm_add_ps(_mm_set1_ps(-1.06021f), _mm_mul_ps(d, _mm_set1_ps(.215638f)));
+      kb = _mm_add_ps(_mm_set1_ps(.848013f), _mm_mul_ps(d, kb));
+      __m128 centered = _mm_sub_ps(ti, half);
+      __m128 k = _mm_add_ps(_mm_mul_ps(ka, _mm_mul_ps(centered, centered)), kb);
+      ti = _mm_add_ps(ti, _mm_mul_ps(_mm_mul_ps(ti, centered), _mm_mul_ps(_mm_sub_ps(ti, one), k)));
+    }
+    
+    __m128 x = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), ti));
+    __m128 y = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), ti));
+    __m128 z = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), ti));
+    __m128 w = _mm_add_ps(aw, _mm_mul_ps(_mm_sub_ps(bw, aw), ti));
+    __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                                      _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+    __m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
+    _mm_storeu_ps(out.x + i, _mm_mul_ps(x, inverseLength));
+    _mm_storeu_ps(out.y + i, _mm_mul_ps(y, inverseLength));
+    _mm_storeu_ps(out.z + i, _mm_mul_ps(z, inverseLength));
+    _mm_storeu_ps(out.w + i, _mm_mul_ps(w, inverseLength));
+  }
+  
+  QuaternionArrays aTail = {a.x + i, a.y + i, a.z + i, a.w + i};
+  QuaternionArrays bTail = {b.x + i, b.y + i, b.z + i, b.w + i};
+  QuaternionArrays outTail = {out.x + i, out.y + i, out.z + i, out.w + i};
+  lerpQuaternionsScalar(aTail, bTail, t + i, count - i, outTail, correctT);
+}
+
+void nlerpQuaternions(const QuaternionArrays &a, const QuaternionArrays &b, const float *t, int count,
+                      const QuaternionArrays &out)
+{
+  lerpQuaternionsSse(a, b, t, count, out, false);
+}
+
+void slerpQuaternions(const QuaternionArrays &a, const QuaternionArrays &b, const float *t, int count,
+                      const QuaternionArrays &out)
+{
+  lerpQuaternionsSse(a, b, t, count, out, true);
+}
+
+//acos/sin slerp, one quaternion at a time
+void slerpQuaternionsExact(const QuaternionArrays &a, const QuaternionArrays &b, const float *t, int count,
+                           const QuaternionArrays &out)
+{
+  for (int i = 0; i < count; i++)
+  {
+    float dot = a.x[i] * b.x[i] + a.y[i] * b.y[i] + a.z[i] * b.z[i] + a.w[i] * b.w[i];
+    float sign = dot < 0 ? -1.0f : 1.0f;
+    float cosine = dot * sign;
+    
+    //nearly equal: sin(angle) ~ 0, lerp is exact enough
+    float weightA = 1.0f - t[i], weightB = t[i];
+    if (cosine < .9995f)
+    {
+      float angle = acosf(cosine);
+      float inverseSine = 1.0f / sinf(angle);
+      weightA = sinf((1.0f - t[i]) * angle) * inverseSine;
+      weightB = sinf(t[i] * angle) * inverseSine;
+    }
+    weightB *= sign;
+    
+    float x = a.x[i] * weightA + b.x[i] * weightB;
+    float y = a.y[i] * weightA + b.y[i] * weightB;
+    float z = a.z[i] * weightA + b.z[i] * weightB;
+    float w = a.w[i] * weightA + b.w[i] * weightB;
+    float inverseLength = 1.0f / sqrtf(x * x + y * y + z * z + w * w);
+    out.x[i] = x * inverseLength;
+    out.y[i] = y * inverseLength;
+    out.z[i] = z * inverseLength;
+    out.w[i] = w * inverseLength;
+  }
+}
+
+#endif
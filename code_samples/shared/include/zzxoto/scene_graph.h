@@ -0,0 +1,299 @@
+#ifndef H_ZZXOTO_SCENE_GRAPH
+#define H_ZZXOTO_SCENE_GRAPH
+
+//Transform hierarchy as structure of arrays.
+//
+//Every node has a parent index, a local translation/rotation/scale, a world
+//transform and a dirty bit. World transforms are kept as 3x4 Affine, which
+//makes every parent * local product 36 multiply-adds instead of 64.
+//
+//Nodes can only be parented to nodes that already exist, so the arrays are
+//topologically sorted: a parent always comes before its children, and one
+//front-to-back pass updates every world matrix.
+//
+//Setters only mark the node dirty. UpdateWorldTransforms pushes the dirty
+//bits down to the children as it goes and recomputes just the dirty
+//subtrees; everything else keeps last frame's world matrix.
+//
+//For big scenes the pool overload walks the hierarchy level by level. Nodes
+//of the same depth don't depend on each other, so every level is split into
+//chunks across the pool.
+
+#include <assert.h>
+#include <string.h>
+#include <vector>
+#include <atomic>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "zzxoto/thread_pool.h"
+#include "zzxoto/affine.h"
+
+class SceneGraph
+{
+  public:
+  SceneGraph()
+    :m_levelsDirty(false), m_lastUpdatedCount(0)
+  {
+  }
+  
+  //parent is -1 for a root. returns the node index
+  int AddNode(int parent,
+              const glm::vec3 &translation = glm::vec3(0.0f),
+              const glm::quat &rotation = glm::quat(),
+              const glm::vec3 &scale = glm::vec3(1.0f))
+  {
+    assert(parent >= -1 && parent < NodeCount() && "SceneGraph parent must be -1 or an existing node");
+    int node = NodeCount();
+    
+    m_parent.push_back(parent);
+    m_depth.push_back(parent >= 0 ? m_depth[parent] + 1 : 0);
+    m_tx.push_back(translation.x);
+    m_ty.push_back(translation.y);
+    m_tz.push_back(translation.z);
+    m_qx.push_back(rotation.x);
+    m_qy.push_back(rotation.y);
+    m_qz.push_back(rotation.z);
+    m_qw.push_back(rotation.w);
+    m_sx.push_back(scale.x);
+    m_sy.push_back(scale.y);
+    m_sz.push_back(scale.z);
+    m_world.push_back(makeAffineIdentity());
+    m_dirty.push_back(1);
+    
+    m_levelsDirty = true;
+    
+    return node;
+  }
+  
+  void Reserve(int nodeCount)
+  {
+    m_parent.reserve(nodeCount);
+    m_depth.reserve(nodeCount);
+    m_tx.reserve(nodeCount);
+    m_ty.reserve(nodeCount);
+    m_tz.reserve(nodeCount);
+    m_qx.reserve(nodeCount);
+    m_qy.reserve(nodeCount);
+    m_qz.reserve(nodeCount);
+    m_qw.reserve(nodeCount);
+    m_sx.reserve(nodeCount);
+    m_sy.reserve(nodeCount);
+    m_sz.reserve(nodeCount);
+    m_world.reserve(nodeCount);
+    m_dirty.reserve(nodeCount);
+  }
+  
+  void SetTranslation(int node, const glm::vec3 &translation)
+  {
+    m_tx[node] = translation.x;
+    m_ty[node] = translation.y;
+    m_tz[node] = translation.z;
+    m_dirty[node] = 1;
+  }
+  
+  void SetRotation(int node, const glm::quat &rotation)
+  {
+    m_qx[node] = rotation.x;
+    m_qy[node] = rotation.y;
+    m_qz[node] = rotation.z;
+    m_qw[node] = rotation.w;
+    m_dirty[node] = 1;
+  }
+  
+  void SetScale(int node, const glm::vec3 &scale)
+  {
+    m_sx[node] = scale.x;
+    m_sy[node] = scale.y;
+    m_sz[node] = scale.z;
+    m_dirty[node] = 1;
+  }
+  
+  glm::vec3 Translation(int node) const
+  {
+    return glm::vec3(m_tx[node], m_ty[node], m_tz[node]);
+  }
+  
+  glm::quat Rotation(int node) const
+  {
+    return glm::quat(m_qw[node], m_qx[node], m_qy[node], m_qz[node]);
+  }
+  
+  glm::vec3 Scale(int node) const
+  {
+    return glm::vec3(m_sx[node], m_sy[node], m_sz[node]);
+  }
+  
+  int Parent(int node) const
+  {
+    return m_parent[node];
+  }
+  
+  //valid after UpdateWorldTransforms
+  const Affine &WorldAffine(int node) const
+  {
+    return m_world[node];
+  }
+  
+  //for upload
+  glm::mat4 World(int node) const
+  {
+    return affineToMat4(m_world[node]);
+  }
+  
+  int NodeCount() const
+  {
+    return (int) m_parent.size();
+  }
+  
+  //world matrices recomputed by the last update
+  int LastUpdatedCount() const
+  {
+    return m_lastUpdatedCount;
+  }
+  
+  void UpdateWorldTransforms()
+  {
+    m_lastUpdatedCount = UpdateRange(0, NodeCount(), NULL);
+    ClearDirty();
+  }
+  
+  void UpdateWorldTransforms(ThreadPool &pool)
+  {
+    //below this a level is not worth waking the pool for
+    const int minParallelLevelSize = 4096;
+    
+    if (m_levelsDirty)
+    {
+      BuildLevels();
+    }
+    
+    std::atomic<int> updatedCount(0);
+    for (size_t level = 0; level + 1 < m_levelStart.size(); level++)
+    {
+      int begin = m_levelStart[level];
+      int end = m_levelStart[level + 1];
+      
+      if (end - begin < minParallelLevelSize || pool.ThreadCount() == 1)
+      {
+        updatedCount += UpdateRange(begin, end, &m_levelOrder[0]);
+      }
+      else
+      {
+        LevelTask task;
+        task.graph = this;
+        task.begin = begin;
+        task.end = end;
+        task.updatedCount = &updatedCount;
+        pool.Run(UpdateLevelSlice, &task);
+      }
+    }
+    
+    m_lastUpdatedCount = updatedCount;
+    ClearDirty();
+  }
+  
+  private:
+  typedef struct LevelTask
+  {
+    SceneGraph *graph;
+    int begin;
+    int end;
+    std::atomic<int> *updatedCount;
+  } LevelTask;
+  
+  static void UpdateLevelSlice(int taskIndex, int taskCount, void *userData)
+  {
+    LevelTask *task = (LevelTask *) userData;
+    
+    int begin, end;
+    taskRange(task->end - task->begin, taskIndex, taskCount, &begin, &end);
+    *task->updatedCount += task->graph->UpdateRange(task->begin + begin, task->begin + end,
+                                                    &task->graph->m_levelOrder[0]);
+  }
+  
+  //updates nodes [begin, end) of `order`, or of the node arrays themselves
+  //when order is NULL. returns the number of recomputed world matrices
+  int UpdateRange(int begin, int end, const int *order)
+  {
+    int updated = 0;
+    
+    for (int k = begin; k < end; k++)
+    {
+      int i = order ? order[k] : k;
+      int parent = m_parent[i];
+      
+      //the parent was handled earlier in this pass, its bit is final
+      unsigned char dirty = m_dirty[i] | (parent >= 0 ? m_dirty[parent] : 0);
+      if (!dirty)
+      {
+        continue;
+      }
+      m_dirty[i] = 1;
+      
+      Affine local = LocalTransform(i);
+      m_world[i] = parent >= 0 ? affineMultiply(m_world[parent], local) : local;
+      updated++;
+    }
+    
+    return updated;
+  }
+  
+  //T * R * S without building the three matrices
+  Affine LocalTransform(int i) const
+  {
+    return makeAffine(Translation(i), Rotation(i), Scale(i));
+  }
+  
+  void ClearDirty()
+  {
+    if (!m_dirty.empty())
+    {
+      memset(&m_dirty[0], 0, m_dirty.size());
+    }
+  }
+  
+  //counting sort of the node indices by depth; within a level nodes keep
+  //their array order so the walk stays mostly front to back
+  void BuildLevels()
+  {
+    int maxDepth = 0;
+    for (int i = 0; i < NodeCount(); i++)
+    {
+      maxDepth = glm::max(maxDepth, m_depth[i]);
+    }
+    
+    m_levelStart.assign(maxDepth + 2, 0);
+    for (int i = 0; i < NodeCount(); i++)
+    {
+      m_levelStart[m_depth[i] + 1]++;
+    }
+    for (int level = 0; level <= maxDepth; level++)
+    {
+      m_levelStart[level + 1] += m_levelStart[level];
+    }
+    
+    std::vector<int> fill(m_levelStart.begin(), m_levelStart.end() - 1);
+    m_levelOrder.resize(NodeCount());
+    for (int i = 0; i < NodeCount(); i++)
+    {
+      m_levelOrder[fill[m_depth[i]]++] = i;
+    }
+    
+    m_levelsDirty = false;
+  }
+  
+  std::vector<int> m_parent;
+  std::vector<int> m_depth;
+  std::vector<float> m_tx, m_ty, m_tz;
+  std::vector<float> m_qx, m_qy, m_qz, m_qw;
+  std::vector<float> m_sx, m_sy, m_sz;
+  std::vector<Affine> m_world;
+  std::vector<unsigned char> m_dirty;
+  
+  std::vector<int> m_levelOrder;
+  std::vector<int> m_levelStart;
+  bool m_levelsDirty;
+  int m_lastUpdatedCount;
+};
+
+#endif
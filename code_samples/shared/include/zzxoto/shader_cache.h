@@ -0,0 +1,346 @@
+#ifndef H_ZZXOTO_SHADER_CACHE
+#define H_ZZXOTO_SHADER_CACHE
+
+//Program cache: programs are keyed by a hash of their sources, defines and
+//the driver, and linked programs are written to disk with glGetProgramBinary.
+//The next start loads them with glProgramBinary instead of compiling. If a
+//binary is missing or the driver rejects it (driver update, other GPU), the
+//program is compiled from source and the binary rewritten.
+//
+//Add only starts the work and Finish waits for all of it, so everything
+//added in between compiles together. With KHR_parallel_shader_compile the
+//driver spreads that over its own threads.
+//
+//  ShaderCache cache;
+//  int lit = cache.Add(litVertexSource, litFragmentSource, "#define MAX_LIGHTS 4\n");
+//  int flat = cache.Add(flatVertexSource, flatFragmentSource);
+//  cache.Finish();
+//  GLuint program = cache.Program(lit);
+//
+//NOTE: expects GL/glew.h to be included before this file.
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "zzxoto/gl_helper.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+static const char SHADER_CACHE_MAGIC[4] = {'Z', 'P', 'R', 'G'};
+
+//FNV-1a, 64 bit
+unsigned long long hashBytes(const void *data, size_t size, unsigned long long hash = 14695981039346656037ull)
+{
+  const unsigned char *bytes = (const unsigned char *) data;
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  
+  return hash;
+}
+
+//strings hash with their terminator so ("ab", "c") and ("a", "bc") differ
+unsigned long long hashString(const char *s, unsigned long long hash = 14695981039346656037ull)
+{
+  return s ? hashBytes(s, strlen(s) + 1, hash) : hashBytes("", 1, hash);
+}
+
+//mkdir -p: creates `path` and any missing parents. false if one of them
+//could not be created
+bool makeDirectories(const char *path)
+{
+  std::string prefix;
+  for (const char *at = path; ; at++)
+  {
+    //"C:" of a drive letter path is not a directory to make
+    if ((*at == '/' || *at == '\\' || *at == 0) && !prefix.empty() && prefix[prefix.size() - 1] != ':')
+    {
+#ifdef _WIN32
+      int result = _mkdir(prefix.c_str());
+#else
+      int result = mkdir(prefix.c_str(), 0755);
+#endif
+      if (result != 0 && errno != EEXIST)
+      {
+        return false;
+      }
+    }
+    if (*at == 0)
+    {
+      return true;
+    }
+    prefix += *at;
+  }
+}
+
+typedef struct ShaderCacheFileHeader
+{
+  char magic[4];
+  GLenum binaryFormat;
+  unsigned long long key;
+  unsigned binarySize;
+} ShaderCacheFileHeader;
+
+class ShaderCache
+{
+  public:
+  //`directory` and its parents are created if missing; without it programs
+  //are compiled from source every time
+  ShaderCache(const char *directory = "build/shader_cache")
+    :m_directory(directory), m_useBinaries(true), m_loadedCount(0), m_compiledCount(0), m_milliseconds(0)
+  {
+    bool haveDirectory = makeDirectories(directory);
+    if (!haveDirectory)
+    {
+      printf("ShaderCache: could not create %s (%s), binaries are not saved\n", directory, strerror(errno));
+    }
+    
+    m_canSaveBinaries = haveDirectory && (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary);
+    if (m_canSaveBinaries)
+    {
+      GLint formatCount = 0;
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+      m_canSaveBinaries = formatCount > 0;
+    }
+    
+    m_parallelCompile = GLEW_KHR_parallel_shader_compile != 0;
+    if (m_parallelCompile)
+    {
+      //0xFFFFFFFF: as many threads as the driver likes
+      glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+    
+    //a new driver or GPU may not take the old binaries, key them on both
+    m_driverHash = hashString((const char *) glGetString(GL_VENDOR));
+    m_driverHash = hashString((const char *) glGetString(GL_RENDERER), m_driverHash);
+    m_driverHash = hashString((const char *) glGetString(GL_VERSION), m_driverHash);
+  }
+  
+  //false always compiles from source and leaves the disk alone, for timing
+  //a cold start
+  void SetUseBinaries(bool useBinaries)
+  {
+    m_useBinaries = useBinaries;
+  }
+  
+  //returns the entry index for Program. The program is usable after Finish
+  int Add(const char *vertexSource, const char *fragmentSource, const char *defines = NULL)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    
+    Entry entry;
+    entry.key = hashString(vertexSource, m_driverHash);
+    entry.key = hashString(fragmentSource, entry.key);
+    entry.key = hashString(defines, entry.key);
+    entry.program = glCreateProgram();
+    entry.vertexShader = 0;
+    entry.fragmentShader = 0;
+    entry.pending = true;
+    
+    if (!(m_useBinaries && LoadBinary(entry)))
+    {
+      if (m_canSaveBinaries && m_useBinaries)
+      {
+        glProgramParameteri(entry.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+      }
+      
+      entry.vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource, defines);
+      entry.fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource, defines);
+      glAttachShader(entry.program, entry.vertexShader);
+      glAttachShader(entry.program, entry.fragmentShader);
+      glLinkProgram(entry.program);
+    }
+    
+    m_entries.push_back(entry);
+    m_milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    
+    return (int) m_entries.size() - 1;
+  }
+  
+  //waits for every pending program, reports errors and saves new binaries
+  void Finish()
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    
+    if (m_parallelCompile)
+    {
+      //poll instead of blocking on the first program so the driver threads
+      //keep working on all of them
+      bool done = false;
+      while (!done)
+      {
+        done = true;
+        for (size_t i = 0; i < m_entries.size(); i++)
+        {
+          if (m_entries[i].pending && m_entries[i].vertexShader)
+          {
+            GLint complete = GL_FALSE;
+            glGetProgramiv(m_entries[i].program, GL_COMPLETION_STATUS_KHR, &complete);
+            done = done && complete;
+          }
+        }
+      }
+    }
+    
+    for (size_t i = 0; i < m_entries.size(); i++)
+    {
+      Entry &entry = m_entries[i];
+      if (!entry.pending)
+      {
+        continue;
+      }
+      entry.pending = false;
+      
+      if (entry.vertexShader == 0)
+      {
+        m_loadedCount++;
+        continue;
+      }
+      
+      checkShaderCompile(entry.vertexShader);
+      checkShaderCompile(entry.fragmentShader);
+      if (checkProgramLink(entry.program) && m_useBinaries)
+      {
+        SaveBinary(entry);
+      }
+      
+      glDetachShader(entry.program, entry.vertexShader);
+      glDetachShader(entry.program, entry.fragmentShader);
+      glDeleteShader(entry.vertexShader);
+      glDeleteShader(entry.fragmentShader);
+      m_compiledCount++;
+    }
+    
+    m_milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+  
+  GLuint Program(int entry) const
+  {
+    return m_entries[entry].program;
+  }
+  
+  //time spent in Add and Finish so far
+  double Milliseconds() const
+  {
+    return m_milliseconds;
+  }
+  
+  void PrintStats(const char *label) const
+  {
+    printf("%s: %d programs, %d from binaries, %d compiled%s, %.1f ms\n",
+           label, m_loadedCount + m_compiledCount, m_loadedCount, m_compiledCount,
+           m_parallelCompile ? " in parallel" : "", m_milliseconds);
+  }
+  
+  private:
+  typedef struct Entry
+  {
+    unsigned long long key;
+    GLuint program;
+    GLuint vertexShader;    //0 when loaded from a binary
+    GLuint fragmentShader;
+    bool pending;
+  } Entry;
+  
+  std::string BinaryPath(unsigned long long key) const
+  {
+    char name[32];
+    sprintf(name, "/%016llx.bin", key);
+    
+    return m_directory + name;
+  }
+  
+  bool LoadBinary(const Entry &entry)
+  {
+    if (!m_canSaveBinaries)
+    {
+      return false;
+    }
+    
+    FILE *fp = fopen(BinaryPath(entry.key).c_str(), "rb");
+    if (fp == NULL)
+    {
+      return false;
+    }
+    
+    ShaderCacheFileHeader header;
+    bool valid = fread(&header, sizeof(header), 1, fp) == 1
+      && memcmp(header.magic, SHADER_CACHE_MAGIC, 4) == 0
+      && header.key == entry.key;
+    
+    std::vector<char> binary;
+    if (valid)
+    {
+      binary.resize(header.binarySize);
+      valid = header.binarySize > 0 && fread(&binary[0], 1, header.binarySize, fp) == header.binarySize;
+    }
+    fclose(fp);
+    
+    if (!valid)
+    {
+      return false;
+    }
+    
+    glProgramBinary(entry.program, header.binaryFormat, &binary[0], header.binarySize);
+    
+    GLint success = GL_FALSE;
+    glGetProgramiv(entry.program, GL_LINK_STATUS, &success);
+    
+    return success != 0;
+  }
+  
+  void SaveBinary(const Entry &entry)
+  {
+    if (!m_canSaveBinaries)
+    {
+      return;
+    }
+    
+    GLint length = 0;
+    glGetProgramiv(entry.program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+    {
+      return;
+    }
+    
+    ShaderCacheFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SHADER_CACHE_MAGIC, 4);
+    header.key = entry.key;
+    
+    std::vector<char> binary(length);
+    glGetProgramBinary(entry.program, length, &length, &header.binaryFormat, &binary[0]);
+    header.binarySize = (unsigned) length;
+    
+    FILE *fp = fopen(BinaryPath(entry.key).c_str(), "wb");
+    if (fp == NULL)
+    {
+      return;
+    }
+    fwrite(&header, sizeof(header), 1, fp);
+    fwrite(&binary[0], 1, length, fp);
+    fclose(fp);
+  }
+  
+  std::string m_directory;
+  std::vector<Entry> m_entries;
+  unsigned long long m_driverHash;
+  bool m_canSaveBinaries;
+  bool m_parallelCompile;
+  bool m_useBinaries;
+  int m_loadedCount;
+  int m_compiledCount;
+  double m_milliseconds;
+};
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef H_ZZXOTO_THREAD_POOL
+#define H_ZZXOTO_THREAD_POOL
+
+//Persistent worker threads for per-frame parallel work.
+//
+//Run(func, userData, taskCount) calls func(taskIndex, taskCount, userData) for
+//every task index once, one task per thread, and returns when all are done.
+//The calling thread runs task 0 itself. Nothing is allocated per Run.
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+typedef void (*TaskFunc)(int taskIndex, int taskCount, void *userData);
+
+class ThreadPool
+{
+  public:
+  //threadCount includes the calling thread; 0 picks the hardware thread count
+  ThreadPool(int threadCount = 0)
+    :m_generation(0), m_pending(0), m_taskCount(1), m_quit(false), m_func(NULL), m_userData(NULL)
+  {
+    if (threadCount <= 0)
+    {
+      threadCount = (int) std::thread::hardware_concurrency();
+    }
+    if (threadCount < 1)
+    {
+      threadCount = 1;
+    }
+    m_threadCount = threadCount;
+    
+    for (int i = 1; i < threadCount; i++)
+    {
+      m_threads.push_back(std::thread(&ThreadPool::WorkerMain, this, i));
+    }
+  }
+  
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_quit = true;
+      m_generation++;
+    }
+    m_wake.notify_all();
+    
+    for (size_t i = 0; i < m_threads.size(); i++)
+    {
+      m_threads[i].join();
+    }
+  }
+  
+  int ThreadCount() const
+  {
+    return m_threadCount;
+  }
+  
+  //taskCount 0 means one task per thread
+  void Run(TaskFunc func, void *userData, int taskCount = 0)
+  {
+    if (taskCount <= 0 || taskCount > m_threadCount)
+    {
+      taskCount = m_threadCount;
+    }
+    
+    if (taskCount > 1)
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_func = func;
+        m_userData = userData;
+        m_taskCount = taskCount;
+        m_pending = taskCount - 1;
+        m_generation++;
+      }
+      m_wake.notify_all();
+    }
+    
+    func(0, taskCount, userData);
+    
+    if (taskCount > 1)
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      while (m_pending > 0)
+      {
+        m_done.wait(lock);
+      }
+    }
+  }
+  
+  private:
+  ThreadPool(const ThreadPool &);
+  ThreadPool &operator=(const ThreadPool &);
+  
+  void WorkerMain(int taskIndex)
+  {
+    unsigned seenGeneration = 0;
+    for (;;)
+    {
+      TaskFunc func;
+      void *userData;
+      int taskCount;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_generation == seenGeneration)
+        {
+          m_wake.wait(lock);
+        }
+        seenGeneration = m_generation;
+        if (m_quit)
+        {
+          return;
+        }
+        
+        func = m_func;
+        userData = m_userData;
+        taskCount = m_taskCount;
+      }
+      
+      if (taskIndex < taskCount)
+      {
+        func(taskIndex, taskCount, userData);
+        
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_pending == 0)
+        {
+          m_done.notify_one();
+        }
+      }
+    }
+  }
+  
+  std::vector<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+  int m_threadCount;
+  unsigned m_generation;
+  int m_pending;
+  int m_taskCount;
+  bool m_quit;
+  TaskFunc m_func;
+  void *m_userData;
+};
+
+//[begin, end) of the `taskIndex`-th of `taskCount` even slices of `count` items
+void taskRange(int count, int taskIndex, int taskCount, int *begin, int *end)
+{
+  *begin = (int) ((long long) count * taskIndex / taskCount);
+  *end = (int) ((long long) count * (taskIndex + 1) / taskCount);
+}
+
+#endif
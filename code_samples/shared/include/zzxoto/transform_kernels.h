@@ -0,0 +1,246 @@
+#ifndef H_ZZXOTO_TRANSFORM_KERNELS
+#define H_ZZXOTO_TRANSFORM_KERNELS
+
+//Transforms many points or directions by one glm::mat4, for picking,
+//culling and skinning on the CPU.
+//
+//  transformPoints(m, x, y, z, count, outX, outY, outZ, true);  //SoA, divided by w
+//  transformPoints(m, points, count, outPoints, false);          //AoS glm::vec3
+//  transformDirections(m, x, y, z, count, outX, outY, outZ);     //w = 0, no translation
+//
+//Points are (x, y, z, 1). With perspectiveDivide the result is xyz / w, e.g.
+//NDC out of a world to clip matrix; without it w is dropped, which is exact
+//for affine matrices. Output may alias input.
+//
+//Every kernel has a scalar version and an AVX2 + FMA version doing 8 points
+//per iteration. The AVX2 version is compiled in regardless of the compiler's
+//target flags and picked at startup when cpuid (and the OS, through xgetbv)
+//report AVX2 and FMA; transformKernelName() tells which one runs. AoS input
+//is transposed to SoA in registers, 8 points (24 floats) at a time.
+//
+//No GL dependency.
+
+#include <glm/glm.hpp>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ZZXOTO_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define ZZXOTO_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+typedef void (*TransformSoAFunc)(const glm::mat4 &m, const float *x, const float *y, const float *z, int count,
+                                 float *outX, float *outY, float *outZ, float w, bool perspectiveDivide);
+typedef void (*TransformAoSFunc)(const glm::mat4 &m, const glm::vec3 *points, int count, glm::vec3 *out, float w,
+                                 bool perspectiveDivide);
+
+//w is 1 for points and 0 for directions
+void transformSoAScalar(const glm::mat4 &m, const float *x, const float *y, const float *z, int count,
+                        float *outX, float *outY, float *outZ, float w, bool perspectiveDivide)
+{
+  glm::vec4 translation = m[3] * w;
+  for (int i = 0; i < count; i++)
+  {
+    glm::vec4 p = m[0] * x[i] + m[1] * y[i] + m[2] * z[i] + translation;
+    float scale = perspectiveDivide ? 1.0f / p.w : 1.0f;
+    outX[i] = p.x * scale;
+    outY[i] = p.y * scale;
+    outZ[i] = p.z * scale;
+  }
+}
+
+void transformAoSScalar(const glm::mat4 &m, const glm::vec3 *points, int count, glm::vec3 *out, float w,
+                        bool perspectiveDivide)
+{
+  glm::vec4 translation = m[3] * w;
+  for (int i = 0; i < count; i++)
+  {
+    glm::vec4 p = m[0] * points[i].x + m[1] * points[i].y + m[2] * points[i].z + translation;
+    float scale = perspectiveDivide ? 1.0f / p.w : 1.0f;
+    out[i] = glm::vec3(p) * scale;
+  }
+}
+
+//8 points: out = column0 * x + column1 * y + column2 * z + column3 * w
+ZZXOTO_TARGET_AVX2
+static void transform8Avx2(const __m256 *columns, __m256 x, __m256 y, __m256 z, bool perspectiveDivide,
+                           __m256 *outX, __m256 *outY, __m256 *outZ)
+{
+  //columns[4 * column + row], the translation column is already scaled by w
+  __m256 rx = _mm256_fmadd_ps(columns[0], x, _mm256_fmadd_ps(columns[4], y, _mm256_fmadd_ps(columns[8], z, columns[12])));
+  __m256 ry = _mm256_fmadd_ps(columns[1], x, _mm256_fmadd_ps(columns[5], y, _mm256_fmadd_ps(columns[9], z, columns[13])));
+  __m256 rz = _mm256_fmadd_ps(columns[2], x, _mm256_fmadd_ps(columns[6], y, _mm256_fmadd_ps(columns[10], z, columns[14])));
+  if (perspectiveDivide)
+  {
+    __m256 rw = _mm256_fmadd_ps(columns[3], x, _mm256_fmadd_ps(columns[7], y, _mm256_fmadd_ps(columns[11], z, columns[15])));
+    __m256 scale = _mm256_div_ps(_mm256_set1_ps(1.0f), rw);
+    rx = _mm256_mul_ps(rx, scale);
+    ry = _mm256_mul_ps(ry, scale);
+    rz = _mm256_mul_ps(rz, scale);
+  }
+  *outX = rx;
+  *outY = ry;
+  *outZ = rz;
+}
+
+ZZXOTO_TARGET_AVX2
+static void broadcastColumnsAvx2(const glm::mat4 &m, float w, __m256 *columns)
+{
+  for (int column = 0; column < 4; column++)
+  {
+    for (int row = 0; row < 4; row++)
+    {
+      columns[4 * column + row] = _mm256_set1_ps(column == 3 ? m[column][row] * w : m[column][row]);
+    }
+  }
+}
+
+ZZXOTO_TARGET_AVX2
+void transformSoAAvx2(const glm::mat4 &m, const float *x, const float *y, const float *z, int count,
+                      float *outX, float *outY, float *outZ, float w, bool perspectiveDivide)
+{
+  __m256 columns[16];
+  broadcastColumnsAvx2(m, w, columns);
+  
+  int i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    __m256 rx, ry, rz;
+    transform8Avx2(columns, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), _mm256_loadu_ps(z + i), perspectiveDivide,
+                   &rx, &ry, &rz);
+    _mm256_storeu_ps(outX + i, rx);
+    _mm256_storeu_ps(outY + i, ry);
+    _mm256_storeu_ps(outZ + i, rz);
+  }
+  
+  transformSoAScalar(m, x + i, y + i, z + i, count - i, outX + i, outY + i, outZ + i, w, perspectiveDivide);
+}
+
+ZZXOTO_TARGET_AVX2
+void transformAoSAvx2(const glm::mat4 &m, const glm::vec3 *points, int count, glm::vec3 *out, float w,
+                      bool perspectiveDivide)
+{
+  __m256 columns[16];
+  broadcastColumnsAvx2(m, w, columns);
+  
+  int i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    //xyz xyz ... -> 8 x, 8 y, 8 z: each register gets 4 floats from the first
+    //half of the block in its low lane and 4 from the second half in its high lane
+    const float *p = &points[i].x;
+    __m256 m03 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 0)), _mm_loadu_ps(p + 12), 1);
+    __m256 m14 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 4)), _mm_loadu_ps(p + 16), 1);
+    __m256 m25 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 8)), _mm_loadu_ps(p + 20), 1);
+    __m256 xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+    __m256 yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+    __m256 x = _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+    __m256 y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+    __m256 z = _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+    
+    __m256 rx, ry, rz;
+    transform8Avx2(columns, x, y, z, perspectiveDivide, &rx, &ry, &rz);
+    
+    //and back
+    __m256 rxy = _mm256_shuffle_ps(rx, ry, _MM_SHUFFLE(2, 0, 2, 0));
+    __m256 ryz = _mm256_shuffle_ps(ry, rz, _MM_SHUFFLE(3, 1, 3, 1));
+    __m256 rzx = _mm256_shuffle_ps(rz, rx, _MM_SHUFFLE(3, 1, 2, 0));
+    __m256 r03 = _mm256_shuffle_ps(rxy, rzx, _MM_SHUFFLE(2, 0, 2, 0));
+    __m256 r14 = _mm256_shuffle_ps(ryz, rxy, _MM_SHUFFLE(3, 1, 2, 0));
+    __m256 r25 = _mm256_shuffle_ps(rzx, ryz, _MM_SHUFFLE(3, 1, 3, 1));
+    float *o = &out[i].x;
+    _mm_storeu_ps(o + 0, _mm256_castps256_ps128(r03));
+    _mm_storeu_ps(o + 4, _mm256_castps256_ps128(r14));
+    _mm_storeu_ps(o + 8, _mm256_castps256_ps128(r25));
+    _mm_storeu_ps(o + 12, _mm256_extractf128_ps(r03, 1));
+    _mm_storeu_ps(o + 16, _mm256_extractf128_ps(r14, 1));
+    _mm_storeu_ps(o + 20, _mm256_extractf128_ps(r25, 1));
+  }
+  
+  transformAoSScalar(m, points + i, count - i, out + i, w, perspectiveDivide);
+}
+
+//AVX2 and FMA in the CPU, and AVX state saved by the OS
+bool cpuHasAvx2Fma(void)
+{
+  unsigned leaf1[4] = {0, 0, 0, 0};
+  unsigned leaf7[4] = {0, 0, 0, 0};
+#ifdef _MSC_VER
+  __cpuid((int *) leaf1, 1);
+  __cpuidex((int *) leaf7, 7, 0);
+#else
+  __get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+  __get_cpuid_count(7, 0, &leaf7[0], &leaf7[1], &leaf7[2], &leaf7[3]);
+#endif
+  
+  bool osxsave = (leaf1[2] & (1u << 27)) != 0;
+  bool fma = (leaf1[2] & (1u << 12)) != 0;
+  bool avx2 = (leaf7[1] & (1u << 5)) != 0;
+  if (!osxsave || !fma || !avx2)
+  {
+    return false;
+  }
+  
+  //XCR0 bits 1 and 2: SSE and AVX registers are saved on context switches
+#ifdef _MSC_VER
+  unsigned long long xcr0 = _xgetbv(0);
+#else
+  unsigned eax, edx;
+  __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  unsigned long long xcr0 = ((unsigned long long) edx << 32) | eax;
+#endif
+  
+  return (xcr0 & 6) == 6;
+}
+
+typedef struct TransformKernels
+{
+  TransformSoAFunc soa;
+  TransformAoSFunc aos;
+  const char *name;
+} TransformKernels;
+
+static TransformKernels selectTransformKernels(void)
+{
+  TransformKernels kernels = {transformSoAScalar, transformAoSScalar, "scalar"};
+  if (cpuHasAvx2Fma())
+  {
+    kernels.soa = transformSoAAvx2;
+    kernels.aos = transformAoSAvx2;
+    kernels.name = "avx2+fma";
+  }
+  
+  return kernels;
+}
+
+static const TransformKernels g_transformKernels = selectTransformKernels();
+
+const char *transformKernelName(void)
+{
+  return g_transformKernels.name;
+}
+
+void transformPoints(const glm::mat4 &m, const float *x, const float *y, const float *z, int count,
+                     float *outX, float *outY, float *outZ, bool perspectiveDivide)
+{
+  g_transformKernels.soa(m, x, y, z, count, outX, outY, outZ, 1.0f, perspectiveDivide);
+}
+
+void transformPoints(const glm::mat4 &m, const glm::vec3 *points, int count, glm::vec3 *out, bool perspectiveDivide)
+{
+  g_transformKernels.aos(m, points, count, out, 1.0f, perspectiveDivide);
+}
+
+void transformDirections(const glm::mat4 &m, const float *x, const float *y, const float *z, int count,
+                         float *outX, float *outY, float *outZ)
+{
+  g_transformKernels.soa(m, x, y, z, count, outX, outY, outZ, .0f, false);
+}
+
+void transformDirections(const glm::mat4 &m, const glm::vec3 *directions, int count, glm::vec3 *out)
+{
+  g_transformKernels.aos(m, directions, count, out, .0f, false);
+}
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef H_ZZXOTO_VERTEX_LAYOUT
+#define H_ZZXOTO_VERTEX_LAYOUT
+
+//Interleaved vertex layouts with quantized attributes.
+//
+//A VertexLayout lists the attributes of one vertex in order; packVertices
+//interleaves float source arrays into that layout; applyVertexLayout in
+//vertex_layout_gl.h generates the glVertexAttribPointer calls for a program
+//from it.
+//
+//e.g. position as half3 + normal as snorm 2_10_10_10 is 12 bytes per vertex,
+//down from 24 bytes for two float3 blocks.
+//
+//No GL dependency, so offline tools like obj_to_mesh build without GLEW.
+
+#include <string.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/half_float.hpp>
+
+typedef enum VertexFormat
+{
+  vf_float2,
+  vf_float3,
+  vf_half3,       //3 half floats padded to 8 bytes
+  vf_snorm10x3,   //GL_INT_2_10_10_10_REV, w is 0
+  vf_unorm16x2,
+  VERTEX_FORMAT_COUNT
+} VertexFormat;
+
+typedef struct VertexFormatInfo
+{
+  unsigned size;          //bytes in the vertex, including padding
+  int sourceComponents;   //floats read from the source array per vertex
+} VertexFormatInfo;
+
+static const VertexFormatInfo g_vertexFormatInfo[VERTEX_FORMAT_COUNT] =
+{
+  {8,  2}, //vf_float2
+  {12, 3}, //vf_float3
+  {8,  3}, //vf_half3
+  {4,  3}, //vf_snorm10x3
+  {4,  2}  //vf_unorm16x2
+};
+
+static const int VERTEX_LAYOUT_MAX_ATTRIBUTES = 8;
+
+typedef struct VertexAttribute
+{
+  const char *name;   //attribute name in the shader
+  VertexFormat format;
+  unsigned offset;
+} VertexAttribute;
+
+typedef struct VertexLayout
+{
+  VertexAttribute attributes[VERTEX_LAYOUT_MAX_ATTRIBUTES];
+  int attributeCount;
+  unsigned stride;
+} VertexLayout;
+
+VertexLayout makeVertexLayout()
+{
+  VertexLayout layout;
+  layout.attributeCount = 0;
+  layout.stride = 0;
+  
+  return layout;
+}
+
+void addVertexAttribute(VertexLayout *layout, const char *name, VertexFormat format)
+{
+  if (layout->attributeCount < VERTEX_LAYOUT_MAX_ATTRIBUTES)
+  {
+    VertexAttribute &attribute = layout->attributes[layout->attributeCount++];
+    attribute.name = name;
+    attribute.format = format;
+    attribute.offset = layout->stride;
+    
+    //all format sizes are multiples of 4, so every attribute stays 4 byte aligned
+    layout->stride += g_vertexFormatInfo[format].size;
+  }
+}
+
+//signed normalized 10:10:10:2, x in the low bits. glm's gtx/int_10_10_10_2
+//only has an unsigned cast, which is of no use for normals.
+unsigned packSnorm10_10_10_2(const glm::vec3 &v)
+{
+  glm::vec3 c = glm::clamp(v, -1.0f, 1.0f) * 511.0f;
+  int x = (int) floorf(c.x + .5f);
+  int y = (int) floorf(c.y + .5f);
+  int z = (int) floorf(c.z + .5f);
+  
+  return ((unsigned) x & 0x3ff) | (((unsigned) y & 0x3ff) << 10) | (((unsigned) z & 0x3ff) << 20);
+}
+
+glm::vec3 unpackSnorm10_10_10_2(unsigned packed)
+{
+  //shift the sign bit of each 10 bit field up to bit 31 and back
+  int x = ((int) (packed << 22)) >> 22;
+  int y = ((int) (packed << 12)) >> 22;
+  int z = ((int) (packed << 2)) >> 22;
+  
+  return glm::clamp(glm::vec3((float) x, (float) y, (float) z) / 511.0f, -1.0f, 1.0f);
+}
+
+void packVertexAttribute(VertexFormat format, const float *src, unsigned char *dst)
+{
+  switch(format)
+  {
+    case vf_float2:
+    {
+      memcpy(dst, src, sizeof(float) * 2);
+      break;
+    }
+    case vf_float3:
+    {
+      memcpy(dst, src, sizeof(float) * 3);
+      break;
+    }
+    case vf_half3:
+    {
+      glm::detail::hdata h[4];
+      h[0] = glm::detail::toFloat16(src[0]);
+      h[1] = glm::detail::toFloat16(src[1]);
+      h[2] = glm::detail::toFloat16(src[2]);
+      h[3] = 0;
+      memcpy(dst, h, sizeof(h));
+      break;
+    }
+    case vf_snorm10x3:
+    {
+      unsigned packed = packSnorm10_10_10_2(glm::vec3(src[0], src[1], src[2]));
+      memcpy(dst, &packed, sizeof(packed));
+      break;
+    }
+    case vf_unorm16x2:
+    {
+      unsigned short u[2];
+      u[0] = (unsigned short) (glm::clamp(src[0], 0.0f, 1.0f) * 65535.0f + .5f);
+      u[1] = (unsigned short) (glm::clamp(src[1], 0.0f, 1.0f) * 65535.0f + .5f);
+      memcpy(dst, u, sizeof(u));
+      break;
+    }
+    default:
+    {
+      break;
+    }
+  }
+}
+
+//interleaves `vertexCount` vertices into `out`, which must hold
+//vertexCount * layout.stride bytes. sources[i] is a tightly packed float
+//array for layout.attributes[i].
+//returns bytes written
+size_t packVertices(const VertexLayout &layout, const float *const *sources, int vertexCount, void *out)
+{
+  unsigned char *dst = (unsigned char *) out;
+  
+  for (int v = 0; v < vertexCount; v++)
+  {
+    for (int a = 0; a < layout.attributeCount; a++)
+    {
+      const VertexAttribute &attribute = layout.attributes[a];
+      const float *src = sources[a] + v * g_vertexFormatInfo[attribute.format].sourceComponents;
+      packVertexAttribute(attribute.format, src, dst + attribute.offset);
+    }
+    dst += layout.stride;
+  }
+  
+  return (size_t) vertexCount * layout.stride;
+}
+
+#endif
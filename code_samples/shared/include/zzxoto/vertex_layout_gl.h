@@ -0,0 +1,54 @@
+#ifndef H_ZZXOTO_VERTEX_LAYOUT_GL
+#define H_ZZXOTO_VERTEX_LAYOUT_GL
+
+//The GL side of vertex_layout.h and mesh_file.h: the glVertexAttribPointer
+//arguments of every VertexFormat, applyVertexLayout and the GL index type
+//of a mapped mesh file.
+//
+//NOTE: expects GL/glew.h to be included before this file.
+
+#include "zzxoto/vertex_layout.h"
+#include "zzxoto/mesh_file.h"
+
+typedef struct VertexFormatGL
+{
+  GLint components;
+  GLenum type;
+  GLboolean normalized;
+} VertexFormatGL;
+
+static const VertexFormatGL g_vertexFormatGL[VERTEX_FORMAT_COUNT] =
+{
+  {2, GL_FLOAT,                   GL_FALSE}, //vf_float2
+  {3, GL_FLOAT,                   GL_FALSE}, //vf_float3
+  {3, GL_HALF_FLOAT,              GL_FALSE}, //vf_half3
+  {4, GL_INT_2_10_10_10_REV,      GL_TRUE},  //vf_snorm10x3
+  {2, GL_UNSIGNED_SHORT,          GL_TRUE}   //vf_unorm16x2
+};
+
+//sets up the attribute pointers of `program` from the layout; expects the VAO
+//and the vertex buffer to be bound. Attributes the program does not use are
+//skipped.
+void applyVertexLayout(const VertexLayout &layout, GLuint program, size_t baseOffset = 0)
+{
+  for (int a = 0; a < layout.attributeCount; a++)
+  {
+    const VertexAttribute &attribute = layout.attributes[a];
+    const VertexFormatGL &gl = g_vertexFormatGL[attribute.format];
+    
+    GLint location = glGetAttribLocation(program, attribute.name);
+    if (location >= 0)
+    {
+      glVertexAttribPointer(location, gl.components, gl.type, gl.normalized,
+                            layout.stride, (void *) (baseOffset + attribute.offset));
+      glEnableVertexAttribArray(location);
+    }
+  }
+}
+
+GLenum meshFileIndexType(const MeshFile &mesh)
+{
+  return mesh.header->indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+#endif